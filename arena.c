@@ -0,0 +1,160 @@
+/*arena.c*/
+
+//
+// Arena allocator for the program graph, see arena.h.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "arena.h"
+
+
+//
+// the first block, and the limit on the doubling; a request of
+// more than a quarter of a block gets a block of its own:
+//
+#define FIRST_BLOCK_SIZE  (64 * 1024)
+#define MAX_BLOCK_SIZE    (4 * 1024 * 1024)
+
+#define ALIGNMENT  8
+
+
+//
+// Private functions:
+//
+
+//
+// new_block
+//
+// Mallocs a block with the given amount of memory.
+//
+static struct ARENA_BLOCK* new_block(struct ARENA* arena, long size)
+{
+  struct ARENA_BLOCK* block = (struct ARENA_BLOCK*)malloc(sizeof(struct ARENA_BLOCK) + size);
+
+  if (block == NULL) {
+    printf("**INTERNAL ERROR: out of memory (arena)\n");
+    exit(-1);
+  }
+
+  block->size = size;
+
+  arena->bytes_reserved += size;
+  arena->num_blocks++;
+
+  return block;
+}
+
+
+//
+// Public functions:
+//
+
+//
+// arena_init
+//
+// Returns a new arena with one block.
+//
+struct ARENA* arena_init(void)
+{
+  struct ARENA* arena = (struct ARENA*)malloc(sizeof(struct ARENA));
+
+  arena->bytes_used = 0;
+  arena->bytes_reserved = 0;
+  arena->num_blocks = 0;
+
+  arena->blocks = new_block(arena, FIRST_BLOCK_SIZE);
+  arena->blocks->next = NULL;
+
+  arena->next = (char*)(arena->blocks + 1);
+  arena->end = arena->next + FIRST_BLOCK_SIZE;
+  arena->block_size = FIRST_BLOCK_SIZE * 2;
+
+  return arena;
+}
+
+
+//
+// arena_alloc
+//
+// Bumps the pointer into the current block; when the block is
+// full, starts a new one, twice as big.
+//
+void* arena_alloc(struct ARENA* arena, long size)
+{
+  assert(size >= 0);
+
+  size = (size + ALIGNMENT - 1) & ~(long)(ALIGNMENT - 1);
+
+  arena->bytes_used += size;
+
+  if (size <= arena->end - arena->next) {
+    void* p = arena->next;
+    arena->next += size;
+    return p;
+  }
+
+  if (size > arena->block_size / 4) {
+    //
+    // a block of its own, behind the current one, which still
+    // has room for the smaller requests:
+    //
+    struct ARENA_BLOCK* block = new_block(arena, size);
+
+    block->next = arena->blocks->next;
+    arena->blocks->next = block;
+
+    return (void*)(block + 1);
+  }
+
+  struct ARENA_BLOCK* block = new_block(arena, arena->block_size);
+
+  block->next = arena->blocks;
+  arena->blocks = block;
+
+  arena->next = (char*)(block + 1) + size;
+  arena->end = (char*)(block + 1) + block->size;
+
+  if (arena->block_size < MAX_BLOCK_SIZE)
+    arena->block_size *= 2;
+
+  return (void*)(block + 1);
+}
+
+
+//
+// arena_strdup
+//
+// Returns a copy of s from the arena.
+//
+char* arena_strdup(struct ARENA* arena, const char* s)
+{
+  long len = (long)strlen(s) + 1;  // including '\0'
+  char* copy = (char*)arena_alloc(arena, len);
+
+  memcpy(copy, s, len);
+
+  return copy;
+}
+
+
+//
+// arena_destroy
+//
+// Frees the blocks, and the arena.
+//
+void arena_destroy(struct ARENA* arena)
+{
+  struct ARENA_BLOCK* block = arena->blocks;
+
+  while (block != NULL) {
+    struct ARENA_BLOCK* next = block->next;
+    free(block);
+    block = next;
+  }
+
+  free(arena);
+}
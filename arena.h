@@ -0,0 +1,66 @@
+/*arena.h*/
+
+//
+// Arena allocator for the nuPython program graph. Nodes and their
+// strings are carved one after another out of a few large blocks,
+// instead of being malloc'd one by one, so the nodes of a program
+// sit together in memory in the order they were allocated -- the
+// order in which the parser meets them, which is the order they
+// execute in. Nothing in an arena is freed on its own; destroying
+// the arena frees all of it, a block at a time.
+//
+
+#pragma once
+
+
+struct ARENA_BLOCK
+{
+  struct ARENA_BLOCK* next;
+  long size;          // bytes of memory, which follows the header
+};
+
+struct ARENA
+{
+  struct ARENA_BLOCK* blocks;  // the current block first
+  char* next;         // next free byte in the current block
+  char* end;          // end of the current block
+  long  block_size;   // size of the next block (doubles, up to a limit)
+
+  long  bytes_used;   // allocated, including alignment
+  long  bytes_reserved;  // in blocks
+  int   num_blocks;
+};
+
+
+//
+// Public functions:
+//
+
+//
+// arena_init
+//
+// Returns a new, empty arena.
+//
+struct ARENA* arena_init(void);
+
+//
+// arena_alloc
+//
+// Returns size bytes of uninitialized memory from the arena,
+// aligned for any node of the program graph.
+//
+void* arena_alloc(struct ARENA* arena, long size);
+
+//
+// arena_strdup
+//
+// Returns a copy of the given string, allocated from the arena.
+//
+char* arena_strdup(struct ARENA* arena, const char* s);
+
+//
+// arena_destroy
+//
+// Frees the arena, and with it everything allocated from it.
+//
+void arena_destroy(struct ARENA* arena);
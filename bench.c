@@ -0,0 +1,1111 @@
+/*bench.c*/
+
+//
+// Micro-benchmarks for the nuPython interpreter. Each benchmark
+// prints a small table to the console; run all of them, or just
+// the ones named on the command line:
+//
+//   ./bench
+//   ./bench ram_lookup parse
+//
+// The dispatch benchmark compares the two builds of the VM loop,
+// so vm.c is linked twice, see "make bench".
+//
+
+// clock_gettime
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <malloc.h>        // mallinfo2
+#include <stdbool.h>  // true, false
+#include <string.h>
+#include <time.h>
+#include <math.h>          // pow
+#include <unistd.h>        // fork, pipe
+#include <sys/wait.h>
+#include <sys/resource.h>  // getrusage
+
+#include "ram.h"
+#include "scanner.h"
+#include "mapscanner.h"
+#include "parser.h"
+#include "programgraph.h"
+#include "arena.h"
+#include "resolve.h"
+#include "infer.h"
+#include "bytecode.h"
+#include "vm.h"
+#include "bytecache.h"
+#include "dtoa.h"
+#include "values.h"
+
+//
+// vm.c compiled with -DVM_SWITCH_DISPATCH:
+//
+long vm_execute_switch(struct BYTECODE* bytecode, struct RAM* memory);
+
+
+//
+// now_seconds
+//
+// Returns the current time of a monotonic clock, in seconds.
+//
+static double now_seconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+//
+// bench_ram_lookup
+//
+// Fills memory with N variables and then times ram_get_addr
+// and ram_write_cell_by_name over all of them. With the hash
+// index the cost per lookup should stay flat as N grows.
+//
+static void bench_ram_lookup(void)
+{
+  int sizes[] = { 10, 100, 1000, 10000, 100000 };
+  int num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+  int num_lookups = 2000000;
+
+  printf("ram_lookup: %d lookups per size\n", num_lookups);
+  printf("  %8s  %14s  %14s\n", "vars", "get_addr ns", "write ns");
+
+  for (int s = 0; s < num_sizes; s++) {
+    int N = sizes[s];
+    struct RAM* memory = ram_init();
+    char** names = (char**)malloc(N * sizeof(char*));
+
+    struct RAM_VALUE value;
+    value.value_type = RAM_TYPE_INT;
+    value.types.i = 0;
+
+    for (int i = 0; i < N; i++) {
+      char name[32];
+      sprintf(name, "var_%d", i);
+      names[i] = (char*)malloc(strlen(name) + 1);
+      strcpy(names[i], name);
+      ram_write_cell_by_name(memory, value, names[i]);
+    }
+
+    //
+    // lookups by name:
+    //
+    long checksum = 0;
+    double start = now_seconds();
+    for (int i = 0; i < num_lookups; i++) {
+      checksum += ram_get_addr(memory, names[i % N]);
+    }
+    double get_ns = (now_seconds() - start) * 1e9 / num_lookups;
+
+    //
+    // overwrites by name:
+    //
+    start = now_seconds();
+    for (int i = 0; i < num_lookups; i++) {
+      value.types.i = i;
+      ram_write_cell_by_name(memory, value, names[i % N]);
+    }
+    double write_ns = (now_seconds() - start) * 1e9 / num_lookups;
+
+    printf("  %8d  %14.1f  %14.1f   (checksum %ld)\n", N, get_ns, write_ns, checksum);
+
+    for (int i = 0; i < N; i++) {
+      free(names[i]);
+    }
+    free(names);
+    ram_destroy(memory);
+  }
+}
+
+
+//
+// bench_parse
+//
+// Times parser_parse (scanning, parsing and returning the tokens)
+// over a generated program of N assignments.
+//
+static void bench_parse(void)
+{
+  int N = 100000;
+  char* line = "total_%d = value_%d * 2.5\n";
+
+  char* source = (char*)malloc(N * 64 + 2);
+  int len = 0;
+
+  for (int i = 0; i < N; i++) {
+    len += sprintf(source + len, line, i, i);
+  }
+  strcpy(source + len, "$");
+  len++;
+
+  printf("parse: %d statements (%d bytes), best of 5\n", N, len);
+  printf("  %10s  %14s\n", "ms", "ns/token");
+
+  double best = 0.0;
+  int num_tokens = N * 6 + 1;  // 5 tokens and EOLN per line, EOS
+
+  for (int run = 0; run < 5; run++) {
+    FILE* input = fmemopen(source, len, "r");
+
+    double start = now_seconds();
+    struct TokenQueue* tokens = parser_parse(input);
+    double elapsed = now_seconds() - start;
+
+    fclose(input);
+
+    if (tokens == NULL) {
+      printf("parse: syntax error in benchmark program\n");
+      break;
+    }
+    tokenqueue_destroy(tokens);
+
+    if (run == 0 || elapsed < best)
+      best = elapsed;
+  }
+
+  printf("  %10.1f  %14.2f\n", best * 1e3, best * 1e9 / num_tokens);
+
+  free(source);
+}
+
+
+//
+// write_script
+//
+// Writes a generated nuPython script of about the given size to a
+// temporary file: indented loops, comments and long identifiers.
+// Returns the name of the file, which the caller removes.
+//
+static char* write_script(long size)
+{
+  static char filename[32];
+  strcpy(filename, "/tmp/bench_scriptXXXXXX");
+
+  int fd = mkstemp(filename);
+  FILE* output = fdopen(fd, "w");
+  long written = 0;
+
+  for (int i = 0; written < size; i++) {
+    written += fprintf(output,
+      "# accumulate the running total for block %d\n"
+      "running_total_for_block_%d = 0\n"
+      "while running_total_for_block_%d < 100:\n"
+      "{\n"
+      "    running_total_for_block_%d = running_total_for_block_%d + 1.5  # step\n"
+      "    print('block %d')\n"
+      "}\n", i, i, i, i, i, i);
+  }
+  fprintf(output, "$\n");
+  fclose(output);
+
+  return filename;
+}
+
+
+//
+// bench_scan
+//
+// Tokenizes a generated script with the stream scanner (fgetc),
+// and with the memory-mapped scanner using each of its kernels
+// the CPU supports.
+//
+static void bench_scan(void)
+{
+  long size = 16 * 1024 * 1024;
+  char* filename = write_script(size);
+
+  char* variants[] = { "stream", "scalar", "sse2", "avx2" };
+  int num_variants = sizeof(variants) / sizeof(variants[0]);
+
+  char* fastest = (char*)mapscanner_kernel();
+
+  printf("scan: %.1f MB script, best of 3\n", size / 1e6);
+  printf("  %-14s  %10s  %10s  %10s\n", "scanner", "tokens", "ms", "MB/s");
+
+  for (int v = 0; v < num_variants; v++) {
+    bool mapped = (v > 0);
+
+    if (mapped && !mapscanner_use_kernel(variants[v]))
+      continue;  // not supported
+
+    double best = 0.0;
+    long num_tokens = 0;
+
+    for (int run = 0; run < 3; run++) {
+      num_tokens = 0;
+      double start = now_seconds();
+
+      if (mapped) {
+        struct MappedSource* source = mapscanner_open(filename);
+        struct TokenView token;
+
+        do {
+          token = mapscanner_nextToken(source);
+          num_tokens++;
+        } while (token.id != nuPy_EOS);
+
+        mapscanner_close(source);
+      }
+      else {
+        FILE* input = fopen(filename, "r");
+        int line, col;
+        char value[256];
+        struct Token token;
+
+        scanner_init(&line, &col, value);
+        do {
+          token = scanner_nextToken(input, &line, &col, value);
+          num_tokens++;
+        } while (token.id != nuPy_EOS);
+
+        fclose(input);
+      }
+
+      double elapsed = now_seconds() - start;
+      if (run == 0 || elapsed < best)
+        best = elapsed;
+    }
+
+    printf("  %-14s  %10ld  %10.1f  %10.1f\n", variants[v], num_tokens, best * 1e3, size / 1e6 / best);
+  }
+
+  mapscanner_use_kernel(fastest);
+
+  remove(filename);
+}
+
+
+//
+// parse_in_child
+//
+// Parses the given file, sequentially or pipelined, in a child
+// process, so the child's peak RSS is that of one parse. Returns the
+// time taken, in seconds, and the peak RSS, in KB.
+//
+static double parse_in_child(char* filename, bool pipelined, long* peak_rss)
+{
+  int fds[2];
+  double result[2] = { 0.0, 0.0 };  // seconds, KB
+
+  if (pipe(fds) < 0)
+    return 0.0;
+
+  fflush(stdout);
+  pid_t pid = fork();
+
+  if (pid == 0) {
+    double start = now_seconds();
+
+    struct MappedSource* source = mapscanner_open(filename);
+    struct TokenQueue* tokens = pipelined ? parser_parse_pipelined(source) : parser_parse_source(source);
+    mapscanner_close(source);
+
+    result[0] = now_seconds() - start;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    result[1] = usage.ru_maxrss;
+
+    if (tokens == NULL)
+      result[0] = 0.0;  // syntax error
+    else
+      tokenqueue_destroy(tokens);
+
+    write(fds[1], result, sizeof(result));
+    fflush(stdout);
+    _exit(0);
+  }
+
+  close(fds[1]);
+  if (read(fds[0], result, sizeof(result)) != sizeof(result))
+    result[0] = 0.0;
+  close(fds[0]);
+  waitpid(pid, NULL, 0);
+
+  *peak_rss = (long)result[1];
+  return result[0];
+}
+
+
+//
+// bench_pipeline
+//
+// Parses a generated script with parser_parse_source, which scans
+// everything before parsing, and with parser_parse_pipelined, which
+// scans on another thread. Reports the wall-clock time and peak RSS.
+//
+static void bench_pipeline(void)
+{
+  long size = 16 * 1024 * 1024;
+  char* filename = write_script(size);
+
+  printf("pipeline: %.1f MB script, %ld CPU(s), best of 3\n", size / 1e6, sysconf(_SC_NPROCESSORS_ONLN));
+  printf("  %-14s  %10s  %14s\n", "parse", "ms", "peak RSS (MB)");
+
+  for (int pipelined = 0; pipelined <= 1; pipelined++) {
+    double best = 0.0;
+    long best_rss = 0;
+
+    for (int run = 0; run < 3; run++) {
+      long rss;
+      double elapsed = parse_in_child(filename, pipelined, &rss);
+
+      if (elapsed == 0.0) {
+        printf("pipeline: syntax error in benchmark program\n");
+        break;
+      }
+
+      if (run == 0 || elapsed < best)
+        best = elapsed;
+      if (run == 0 || rss < best_rss)
+        best_rss = rss;
+    }
+
+    printf("  %-14s  %10.1f  %14.1f\n", pipelined ? "pipelined" : "scan, parse", best * 1e3, best_rss / 1024.0);
+  }
+
+  remove(filename);
+}
+
+
+//
+// graph_walk
+//
+// Walks the program graph in execution order (each loop body once),
+// touching every node, and returns a checksum so the walk isn't
+// optimized away.
+//
+static long graph_walk(struct STMT* stmt, struct STMT* stop)
+{
+  long sum = 0;
+
+  while (stmt != NULL && stmt != stop) {
+    sum += stmt->line;
+
+    if (stmt->stmt_type == STMT_ASSIGNMENT) {
+      struct VALUE* rhs = stmt->types.assignment->rhs;
+
+      sum += stmt->types.assignment->var_name[0];
+      if (rhs->value_type == VALUE_EXPR) {
+        sum += rhs->types.expr->lhs->element->element_value[0];
+        if (rhs->types.expr->isBinaryExpr)
+          sum += rhs->types.expr->rhs->element->element_value[0];
+      }
+      else
+        sum += rhs->types.function_call->function_name[0];
+
+      stmt = stmt->types.assignment->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_FUNCTION_CALL) {
+      sum += stmt->types.function_call->function_name[0];
+      if (stmt->types.function_call->parameter != NULL)
+        sum += stmt->types.function_call->parameter->element_value[0];
+
+      stmt = stmt->types.function_call->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+      sum += stmt->types.while_loop->condition->lhs->element->element_value[0];
+      sum += graph_walk(stmt->types.while_loop->loop_body, stmt);
+
+      stmt = stmt->types.while_loop->next_stmt;
+    }
+    else {
+      stmt = stmt->types.pass->next_stmt;
+    }
+  }
+
+  return sum;
+}
+
+//
+// heap_in_use
+//
+// Bytes currently allocated with malloc, including malloc's own
+// per-chunk overhead.
+//
+static long heap_in_use(void)
+{
+  struct mallinfo2 info = mallinfo2();
+  return (long)(info.uordblks + info.hblkhd);
+}
+
+//
+// bench_build
+//
+// Builds the program graph of a generated script two ways: parsing
+// it into a Token Queue and then building the graph from the queue
+// (parser_parse_source, programgraph_build), which mallocs every
+// node, and building the graph while parsing (parser_build_source),
+// in an arena. Reports the time to build the graph from the source,
+// to walk it and to destroy it, and the memory the nodes take.
+//
+static void bench_build(void)
+{
+  long size = 8 * 1024 * 1024;
+  char* filename = write_script(size);
+
+  printf("build: %.1f MB script, best of 5\n", size / 1e6);
+  printf("  %-22s  %10s  %10s  %10s  %10s\n", "source to graph", "build ms", "walk ms", "destroy ms", "node MB");
+
+  for (int fused = 0; fused <= 1; fused++) {
+    double best = 0.0, best_walk = 0.0, best_destroy = 0.0;
+    long node_bytes = 0;
+    long checksum = 0;
+
+    for (int run = 0; run < 5; run++) {
+      struct STMT* program = NULL;
+      struct TokenQueue* tokens = NULL;
+      struct ARENA* arena = NULL;
+
+      double start = now_seconds();
+
+      struct MappedSource* source = mapscanner_open(filename);
+
+      if (fused) {
+        arena = arena_init();
+        parser_build_source(source, arena, &program, &tokens);
+        node_bytes = arena->bytes_reserved;
+      }
+      else {
+        tokens = parser_parse_source(source);
+        if (tokens != NULL) {
+          long before = heap_in_use();
+          program = programgraph_build(tokens);
+          node_bytes = heap_in_use() - before;
+        }
+      }
+
+      mapscanner_close(source);
+
+      double elapsed = now_seconds() - start;
+
+      if (program == NULL) {
+        printf("build: syntax error in benchmark program\n");
+        break;
+      }
+
+      start = now_seconds();
+      checksum = graph_walk(program, NULL);
+      double walk = now_seconds() - start;
+
+      start = now_seconds();
+      if (fused)
+        arena_destroy(arena);
+      else
+        programgraph_destroy(program);
+      double destroy = now_seconds() - start;
+
+      if (tokens != NULL)
+        tokenqueue_destroy(tokens);
+
+      if (run == 0 || elapsed < best)
+        best = elapsed;
+      if (run == 0 || walk < best_walk)
+        best_walk = walk;
+      if (run == 0 || destroy < best_destroy)
+        best_destroy = destroy;
+    }
+
+    printf("  %-22s  %10.1f  %10.2f  %10.2f  %10.1f   (checksum %ld)\n",
+      fused ? "parse and build, arena" : "parse, then build",
+      best * 1e3, best_walk * 1e3, best_destroy * 1e3, node_bytes / 1e6, checksum);
+  }
+
+  remove(filename);
+}
+
+
+//
+// bench_cache
+//
+// Gets the bytecode of a generated script two ways: compiling it
+// (scan, parse and build, resolve, infer types, compile), and
+// loading it from the bytecode cache (see bytecache.h).
+//
+static void bench_cache(void)
+{
+  long size = 8 * 1024 * 1024;
+  char* filename = write_script(size);
+  char* cachename = bytecache_filename(filename);
+
+  printf("cache: %.1f MB script, best of 5\n", size / 1e6);
+  printf("  %-14s  %10s  %10s\n", "bytecode", "ms", "instrs");
+
+  for (int cached = 0; cached <= 1; cached++) {
+    double best = 0.0;
+    int num_instrs = 0;
+
+    for (int run = 0; run < 5; run++) {
+      struct BYTECODE* bytecode = NULL;
+
+      double start = now_seconds();
+
+      struct MappedSource* source = mapscanner_open(filename);
+
+      if (cached) {
+        bytecode = bytecache_load(cachename, source);
+      }
+      else {
+        struct ARENA* arena = arena_init();
+        struct STMT* program = NULL;
+        struct TokenQueue* tokens = NULL;
+
+        if (parser_build_source(source, arena, &program, &tokens) && program != NULL) {
+          struct SYMTAB* symbols = resolve_program(program);
+          struct TYPEINFO* types = infer_types(program, symbols);
+
+          bytecode = bytecode_compile(program, symbols, types);
+
+          infer_destroy(types);
+          resolve_destroy(symbols);
+        }
+
+        arena_destroy(arena);
+      }
+
+      double elapsed = now_seconds() - start;
+
+      if (bytecode == NULL) {
+        printf("cache: no bytecode for benchmark program\n");
+        mapscanner_close(source);
+        break;
+      }
+
+      if (!cached && run == 0)
+        bytecache_save(cachename, source, bytecode);
+
+      mapscanner_close(source);
+
+      num_instrs = bytecode->num_instrs;
+      bytecode_destroy(bytecode);
+
+      if (run == 0 || elapsed < best)
+        best = elapsed;
+    }
+
+    printf("  %-14s  %10.1f  %10d\n", cached ? "from cache" : "compiled", best * 1e3, num_instrs);
+  }
+
+  remove(cachename);
+  free(cachename);
+  remove(filename);
+}
+
+
+//
+// id_or_keyword_linear
+//
+// Keyword lookup the way the stream scanner does it: strcmp
+// against each keyword in turn.
+//
+static int id_or_keyword_linear(const char* text)
+{
+  static const char* keywords[] = {
+    "and", "break", "continue", "def", "elif", "else", "False", "for", "if",
+    "in", "is", "None", "not", "or", "pass", "return", "True", "while"
+  };
+  int num_keywords = sizeof(keywords) / sizeof(keywords[0]);
+
+  for (int i = 0; i < num_keywords; i++) {
+    if (strcmp(text, keywords[i]) == 0)
+      return nuPy_KEYW_AND + i;
+  }
+
+  return nuPy_IDENTIFIER;
+}
+
+
+//
+// bench_keywords
+//
+// Times telling identifiers from keywords over identifier-heavy
+// input (1 in 5 is a keyword), with a linear search and with the
+// perfect hash of the memory-mapped scanner.
+//
+static void bench_keywords(void)
+{
+  char* samples[] = {
+    "x", "i", "total", "while", "running_total_for_block_17", "print", "True",
+    "counter", "if", "value_2", "None", "n", "index_of_last", "s", "pass",
+    "temperature", "df", "el", "elsewhere", "Falsey", "or_else", "input",
+  };
+  int num_samples = sizeof(samples) / sizeof(samples[0]);
+  int lengths[32];
+  int num_lookups = 20000000;
+
+  for (int i = 0; i < num_samples; i++) {
+    lengths[i] = (int)strlen(samples[i]);
+  }
+
+  printf("keywords: %d lookups, best of 3\n", num_lookups);
+  printf("  %-14s  %10s  %10s\n", "lookup", "ms", "ns/lookup");
+
+  for (int hashed = 0; hashed <= 1; hashed++) {
+    double best = 0.0;
+    long checksum = 0;
+
+    for (int run = 0; run < 3; run++) {
+      checksum = 0;
+      double start = now_seconds();
+
+      for (int i = 0; i < num_lookups; i++) {
+        int s = i % num_samples;
+
+        if (hashed)
+          checksum += mapscanner_id_or_keyword(samples[s], lengths[s]);
+        else
+          checksum += id_or_keyword_linear(samples[s]);
+      }
+
+      double elapsed = now_seconds() - start;
+      if (run == 0 || elapsed < best)
+        best = elapsed;
+    }
+
+    printf("  %-14s  %10.1f  %10.2f   (checksum %ld)\n", hashed ? "perfect hash" : "linear",
+      best * 1e3, best * 1e9 / num_lookups, checksum);
+  }
+}
+
+
+//
+// compile_source
+//
+// Parses and compiles the given nuPython source code, returns
+// the bytecode or NULL if the source has a syntax error. If
+// specialize is true, binary operations whose operand types
+// can be inferred get specialized opcodes.
+//
+static struct BYTECODE* compile_source(char* source, bool specialize)
+{
+  FILE* input = fmemopen(source, strlen(source), "r");
+  struct TokenQueue* tokens = parser_parse(input);
+  fclose(input);
+
+  if (tokens == NULL)
+    return NULL;
+
+  struct STMT* program = programgraph_build(tokens);
+  struct SYMTAB* symbols = resolve_program(program);
+  struct TYPEINFO* types = specialize ? infer_types(program, symbols) : NULL;
+  struct BYTECODE* bytecode = bytecode_compile(program, symbols, types);
+
+  if (types != NULL)
+    infer_destroy(types);
+  programgraph_destroy(program);
+  resolve_destroy(symbols);
+  tokenqueue_destroy(tokens);
+
+  return bytecode;
+}
+
+
+//
+// bench_dispatch
+//
+// Runs a loop of int, real and string operations on the VM with
+// threaded (computed goto) dispatch and with switch dispatch.
+//
+static void bench_dispatch(void)
+{
+  int iterations = 2000000;
+  char source[512];
+
+  sprintf(source,
+    "i = 0\n"
+    "x = 0.0\n"
+    "s = 'abc'\n"
+    "n = 0\n"
+    "while i < %d:\n"
+    "{\n"
+    "  x = x + 0.5\n"
+    "  b = x < 100.0\n"
+    "  c = s == 'abc'\n"
+    "  n = n + 2\n"
+    "  i = i + 1\n"
+    "}\n"
+    "$\n", iterations);
+
+  struct BYTECODE* bytecode = compile_source(source, false);
+  if (bytecode == NULL) {
+    printf("dispatch: syntax error in benchmark program\n");
+    return;
+  }
+
+  struct
+  {
+    char* name;
+    long (*run)(struct BYTECODE*, struct RAM*);
+  } variants[] = {
+#if defined(__GNUC__)
+    { "computed goto", vm_execute },
+#endif
+    { "switch", vm_execute_switch },
+  };
+  int num_variants = sizeof(variants) / sizeof(variants[0]);
+
+  printf("dispatch: %d loop iterations, best of 5\n", iterations);
+  printf("  %-14s  %10s  %14s\n", "dispatch", "ms", "ns/iteration");
+
+  for (int v = 0; v < num_variants; v++) {
+    double best = 0.0;
+
+    for (int run = 0; run < 5; run++) {
+      struct RAM* memory = ram_init();
+
+      double start = now_seconds();
+      variants[v].run(bytecode, memory);
+      double elapsed = now_seconds() - start;
+
+      if (run == 0 || elapsed < best)
+        best = elapsed;
+
+      ram_destroy(memory);
+    }
+
+    printf("  %-14s  %10.1f  %14.2f\n", variants[v].name, best * 1e3, best * 1e9 / iterations);
+  }
+
+  bytecode_destroy(bytecode);
+}
+
+
+//
+// bench_specialize
+//
+// Runs a loop of int and real operations on the VM, compiled with
+// and without the specialized opcodes chosen by type inference.
+//
+static void bench_specialize(void)
+{
+  int iterations = 2000000;
+  char source[512];
+
+  sprintf(source,
+    "i = 0\n"
+    "x = 0.0\n"
+    "n = 0\n"
+    "while i < %d:\n"
+    "{\n"
+    "  x = x + 0.5\n"
+    "  b = x < 100.0\n"
+    "  n = n + i\n"
+    "  m = n * 2\n"
+    "  i = i + 1\n"
+    "}\n"
+    "$\n", iterations);
+
+  printf("specialize: %d loop iterations, best of 5\n", iterations);
+  printf("  %-14s  %10s  %14s\n", "opcodes", "ms", "ns/iteration");
+
+  for (int specialize = 0; specialize <= 1; specialize++) {
+    struct BYTECODE* bytecode = compile_source(source, specialize);
+    if (bytecode == NULL) {
+      printf("specialize: syntax error in benchmark program\n");
+      return;
+    }
+
+    double best = 0.0;
+
+    for (int run = 0; run < 5; run++) {
+      struct RAM* memory = ram_init();
+
+      double start = now_seconds();
+      vm_execute(bytecode, memory);
+      double elapsed = now_seconds() - start;
+
+      if (run == 0 || elapsed < best)
+        best = elapsed;
+
+      ram_destroy(memory);
+    }
+
+    printf("  %-14s  %10.1f  %14.2f\n", specialize ? "specialized" : "generic", best * 1e3, best * 1e9 / iterations);
+
+    bytecode_destroy(bytecode);
+  }
+}
+
+
+//
+// snprintf_lf, snprintf_17g, snprintf_shortest
+//
+// The ways to format a real with printf, for bench_format: as
+// nuPython did, with enough digits to read back, and with the
+// fewest digits that read back (what dtoa_repr gives).
+//
+static int snprintf_lf(double d, char* buffer)
+{
+  return snprintf(buffer, DTOA_BUFFER_SIZE, "%lf", d);
+}
+
+static int snprintf_17g(double d, char* buffer)
+{
+  return snprintf(buffer, DTOA_BUFFER_SIZE, "%.17g", d);
+}
+
+static int snprintf_shortest(double d, char* buffer)
+{
+  int length = 0;
+
+  for (int precision = 1; precision <= 17; precision++) {
+    length = snprintf(buffer, DTOA_BUFFER_SIZE, "%.*g", precision, d);
+    if (strtod(buffer, NULL) == d)
+      break;
+  }
+
+  return length;
+}
+
+
+//
+// bench_format
+//
+// Formats reals with printf and with dtoa.h, in values per second:
+// reals a program computes (sums of tenths, thirds, money), and
+// doubles with random bits, of any magnitude.
+//
+static void bench_format(void)
+{
+  int N = 1000000;
+  double* computed = (double*)malloc(N * sizeof(double));
+  double* random = (double*)malloc(N * sizeof(double));
+
+  srand(211);
+
+  for (int i = 0; i < N; i++) {
+    switch (i % 3) {
+      case 0: computed[i] = i * 0.1; break;
+      case 1: computed[i] = i / 3.0; break;
+      default: computed[i] = (rand() % 1000000) / 100.0; break;
+    }
+
+    unsigned long long bits;
+    do {
+      bits = 0;
+      for (int b = 0; b < 4; b++)
+        bits = (bits << 16) | (rand() & 0xFFFF);
+      memcpy(&random[i], &bits, sizeof(double));
+    } while (random[i] != random[i] || random[i] - random[i] != 0);  // nan, inf
+  }
+
+  struct
+  {
+    char* name;
+    int (*format)(double, char*);
+  } variants[] = {
+    { "printf %lf",    snprintf_lf },
+    { "dtoa_fixed",    dtoa_fixed },
+    { "printf %.17g",  snprintf_17g },
+    { "printf short",  snprintf_shortest },
+    { "dtoa_repr",     dtoa_repr },
+  };
+  int num_variants = sizeof(variants) / sizeof(variants[0]);
+
+  printf("format: %d reals, best of 5\n", N);
+  printf("  %-14s  %16s  %16s\n", "format", "computed M/s", "random bits M/s");
+
+  for (int v = 0; v < num_variants; v++) {
+    double rates[2];
+
+    for (int set = 0; set < 2; set++) {
+      double* values = (set == 0) ? computed : random;
+      double best = 0.0;
+      long total = 0;  // so the formatting isn't optimized away
+
+      for (int run = 0; run < 5; run++) {
+        char buffer[DTOA_BUFFER_SIZE];
+
+        double start = now_seconds();
+        for (int i = 0; i < N; i++)
+          total += variants[v].format(values[i], buffer);
+        double elapsed = now_seconds() - start;
+
+        if (run == 0 || elapsed < best)
+          best = elapsed;
+      }
+
+      rates[set] = (total > 0) ? N / best / 1e6 : 0.0;
+    }
+
+    printf("  %-14s  %16.2f  %16.2f\n", variants[v].name, rates[0], rates[1]);
+  }
+
+  free(computed);
+  free(random);
+}
+
+
+//
+// bench_power
+//
+// Times ** the old way, through pow, and with int_power and
+// real_power, for small bases and exponents 0..12 (powers that
+// fit in an int), for ints and for reals with and without fractions.
+//
+static void bench_power(void)
+{
+  int N = 4000000;
+  int* bases = (int*)malloc(N * sizeof(int));
+  int* exponents = (int*)malloc(N * sizeof(int));
+
+  srand(211);
+
+  for (int i = 0; i < N; i++) {
+    exponents[i] = rand() % 13;
+    bases[i] = (exponents[i] == 0) ? rand() : rand() % 5;
+  }
+
+  printf("power: %d operations, best of 5\n", N);
+  printf("  %-28s  %10s\n", "**", "ns/op");
+
+  for (int variant = 0; variant < 6; variant++) {
+    const char* names[] = { "int, (int)pow", "int, int_power", "int-valued real, pow", "int-valued real, real_power",
+                            "real, pow", "real, real_power" };
+    double best = 0.0;
+    double total = 0.0;  // so the work isn't optimized away
+
+    for (int run = 0; run < 5; run++) {
+      double start = now_seconds();
+
+      for (int i = 0; i < N; i++) {
+        int power;
+        double base = bases[i] + ((variant >= 4) ? 0.25 : 0.0);
+
+        switch (variant) {
+          case 0: total += (int)pow(bases[i], exponents[i]); break;
+          case 1: int_power(bases[i], exponents[i], &power); total += power; break;
+          case 2: case 4: total += pow(base, exponents[i]); break;
+          default: total += real_power(base, exponents[i]); break;
+        }
+      }
+
+      double elapsed = now_seconds() - start;
+
+      if (run == 0 || elapsed < best)
+        best = elapsed;
+    }
+
+    printf("  %-28s  %10.2f%s\n", names[variant], best * 1e9 / N, (total == 0.0) ? " " : "");
+  }
+
+  free(bases);
+  free(exponents);
+}
+
+
+//
+// bench_concat
+//
+// Builds a string of 10 chars at a time in a loop on the VM, up to
+// 10 MB, with s = s + x, which appends in place, and up to 200 KB
+// with t = s + x followed by s = t, which copies s every time.
+//
+static void bench_concat(void)
+{
+  struct
+  {
+    char* name;
+    char* body;
+    long  sizes[2];
+  } variants[] = {
+    { "s = s + x", "  s = s + x\n", { 1000000, 10000000 } },
+    { "t = s + x; s = t", "  t = s + x\n  s = t\n", { 100000, 200000 } },
+  };
+
+  printf("concat: strings built 10 chars at a time, best of 3\n");
+  printf("  %-18s  %10s  %10s  %12s\n", "loop body", "bytes", "ms", "ns/append");
+
+  for (int v = 0; v < 2; v++) {
+    for (int k = 0; k < 2; k++) {
+      long size = variants[v].sizes[k];
+      char source[512];
+
+      sprintf(source,
+        "s = ''\n"
+        "x = '0123456789'\n"
+        "i = 0\n"
+        "while i < %ld:\n"
+        "{\n"
+        "%s"
+        "  i = i + 1\n"
+        "}\n"
+        "$\n", size / 10, variants[v].body);
+
+      struct BYTECODE* bytecode = compile_source(source, false);
+      if (bytecode == NULL) {
+        printf("concat: syntax error in benchmark program\n");
+        return;
+      }
+
+      double best = 0.0;
+
+      for (int run = 0; run < 3; run++) {
+        struct RAM* memory = ram_init();
+
+        double start = now_seconds();
+        vm_execute(bytecode, memory);
+        double elapsed = now_seconds() - start;
+
+        if (run == 0 || elapsed < best)
+          best = elapsed;
+
+        ram_destroy(memory);
+      }
+
+      printf("  %-18s  %10ld  %10.1f  %12.2f\n", variants[v].name, size, best * 1e3, best * 1e9 / (size / 10));
+
+      bytecode_destroy(bytecode);
+    }
+  }
+}
+
+
+//
+// main
+//
+// usage: bench [name ...]
+//
+int main(int argc, char* argv[])
+{
+  struct
+  {
+    char* name;
+    void (*run)(void);
+  } benchmarks[] = {
+    { "ram_lookup", bench_ram_lookup },
+    { "parse",      bench_parse },
+    { "scan",       bench_scan },
+    { "pipeline",   bench_pipeline },
+    { "build",      bench_build },
+    { "cache",      bench_cache },
+    { "keywords",   bench_keywords },
+    { "dispatch",   bench_dispatch },
+    { "specialize", bench_specialize },
+    { "format",     bench_format },
+    { "power",      bench_power },
+    { "concat",     bench_concat },
+  };
+  int num_benchmarks = sizeof(benchmarks) / sizeof(benchmarks[0]);
+
+  for (int b = 0; b < num_benchmarks; b++) {
+    bool selected = (argc < 2);
+
+    for (int a = 1; a < argc; a++) {
+      if (strcmp(argv[a], benchmarks[b].name) == 0)
+        selected = true;
+    }
+
+    if (selected) {
+      benchmarks[b].run();
+      printf("\n");
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,537 @@
+/*bytecache.c*/
+
+//
+// Bytecode cache for nuPython, see bytecache.h.
+//
+
+// mmap, mkstemp, fdopen
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mapscanner.h"
+#include "bytecode.h"
+#include "infer.h"
+#include "bytecache.h"
+
+
+//
+// bump the version whenever the file format changes; what the
+// compiler emits for a program is covered by the build id, a hash
+// of the compiler's sources that the makefile passes in. Built any
+// other way, the time bytecache.c was compiled stands in for it:
+//
+#define BYTECACHE_VERSION  3
+
+#ifndef BYTECACHE_BUILD_ID
+#define BYTECACHE_BUILD_STAMP  __DATE__ " " __TIME__
+#endif
+
+static const char BYTECACHE_MAGIC[8] = { 'n', 'u', 'P', 'y', 'B', 'C', '\r', '\n' };
+
+struct BYTECACHE_HEADER
+{
+  char     magic[8];
+  int32_t  version;
+  int32_t  num_opcodes;    // NUM_OPCODES of the compiler that wrote it
+  uint64_t build_id;       // of the compiler that wrote it
+  uint64_t source_hash;
+  int64_t  source_size;
+  int32_t  num_instrs;
+  int32_t  num_constants;
+  int32_t  num_names;
+  int32_t  strings_size;   // bytes in the string pool
+  uint64_t checksum;       // of everything after the header
+};
+
+//
+// a constant, with a string as its offset in the string pool:
+//
+struct BYTECACHE_CONSTANT
+{
+  int32_t value_type;      // enum RAM_VALUE_TYPES
+  int32_t i;               // INT, PTR, BOOLEAN; STR: offset
+  double  d;               // REAL
+};
+
+//
+// instructions are stored as they are in memory; the header, and
+// the constants that come first after it, keep everything aligned:
+//
+_Static_assert(sizeof(struct INSTR) == 4 * sizeof(int32_t), "struct INSTR is 4 ints");
+_Static_assert(sizeof(struct BYTECACHE_HEADER) % 8 == 0, "header keeps the constants aligned");
+
+
+//
+// Private functions:
+//
+
+//
+// hash_bytes
+//
+// Hash of the given bytes, 8 at a time: each word is mixed into
+// the hash with a multiply, so that any change of a byte changes
+// the hash.
+//
+static uint64_t hash_bytes(const char* bytes, long size, uint64_t hash)
+{
+  long i = 0;
+
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    memcpy(&word, bytes + i, 8);
+
+    hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+    hash ^= hash >> 29;
+  }
+
+  for (; i < size; i++) {
+    hash = (hash ^ (unsigned char)bytes[i]) * 0x100000001B3ull;
+  }
+
+  hash ^= (uint64_t)size;
+  hash *= 0x9E3779B97F4A7C15ull;
+  return hash ^ (hash >> 32);
+}
+
+//
+// build_id
+//
+// Identifies the build of the compiler, see BYTECACHE_VERSION.
+//
+static uint64_t build_id(void)
+{
+#ifdef BYTECACHE_BUILD_ID
+  return (uint64_t)BYTECACHE_BUILD_ID;
+#else
+  return hash_bytes(BYTECACHE_BUILD_STAMP, sizeof(BYTECACHE_BUILD_STAMP) - 1, 0);
+#endif
+}
+
+//
+// payload_size
+//
+// Bytes after the header for the given counts, or -1 if any count
+// is out of range.
+//
+static long payload_size(const struct BYTECACHE_HEADER* header)
+{
+  if (header->num_instrs < 1 || header->num_constants < 0 ||
+      header->num_names < 0 || header->strings_size < 0)
+    return -1;
+
+  return (long)header->num_instrs * (sizeof(struct INSTR) + sizeof(int32_t)) +
+         (long)header->num_constants * sizeof(struct BYTECACHE_CONSTANT) +
+         (long)header->num_names * sizeof(int32_t) +
+         (long)header->strings_size;
+}
+
+//
+// valid_string
+//
+// Returns true if the given offset is that of a '\0'-terminated
+// string in the pool.
+//
+static bool valid_string(const char* strings, int32_t strings_size, int32_t offset)
+{
+  if (offset < 0 || offset >= strings_size)
+    return false;
+
+  return memchr(strings + offset, '\0', strings_size - offset) != NULL;
+}
+
+//
+// valid_operand
+//
+// Returns true if the given operand names an existing variable
+// slot or constant.
+//
+static bool valid_operand(const struct BYTECACHE_HEADER* header, int operand)
+{
+  if (OPERAND_IS_CONST(operand))
+    return OPERAND_CONST_INDEX(operand) < header->num_constants;
+  else
+    return operand < header->num_names;
+}
+
+//
+// valid_instr
+//
+// Returns true if the given instruction's fields are in range for
+// its opcode, so the VM never indexes past the end of an array.
+//
+static bool valid_instr(const struct BYTECACHE_HEADER* header, const struct BYTECACHE_CONSTANT* constants, const struct INSTR* instr)
+{
+  switch (instr->opcode) {
+    case OP_LOAD:
+    case OP_PRINT:
+    case OP_INT:
+    case OP_FLOAT:
+      return valid_operand(header, instr->lhs);
+    case OP_BINARY:
+      return instr->arg >= 0 && instr->arg <= OPERATOR_NO_OP &&
+             valid_operand(header, instr->lhs) && valid_operand(header, instr->rhs);
+    case OP_STORE:
+      return instr->arg >= 0 && instr->arg < header->num_names;
+    case OP_INPUT:
+      return instr->arg >= 0 && instr->arg < header->num_constants &&
+             constants[instr->arg].value_type == RAM_TYPE_STR;
+    case OP_JUMP:
+    case OP_JUMP_IF_TRUE:
+      return instr->arg >= 0 && instr->arg < header->num_instrs;
+    case OP_PRINT_NEWLINE:
+    case OP_BAD_CALL:
+    case OP_STOP:
+    case OP_HALT:
+      return true;
+    default:
+      //
+      // a specialized binary operation; whether its operands have
+      // the types it assumes is checked once all of the code is in:
+      //
+      return instr->opcode > OP_HALT && instr->opcode < NUM_OPCODES &&
+             valid_operand(header, instr->lhs) && valid_operand(header, instr->rhs);
+  }
+}
+
+//
+// dup_string
+//
+// Returns a malloc'd copy of the given string.
+//
+static char* dup_string(const char* s)
+{
+  char* copy = (char*)malloc(strlen(s) + 1);
+  strcpy(copy, s);
+  return copy;
+}
+
+//
+// decode
+//
+// Checks the mapped cache file against the source, and every
+// count, offset and instruction in it, including the operand types
+// of the specialized instructions; if it all holds up, returns the
+// bytecode, copied out of the file. Returns NULL otherwise.
+//
+static struct BYTECODE* decode(const char* file, long file_size, struct MappedSource* source)
+{
+  struct BYTECACHE_HEADER header;
+
+  if (file_size < (long)sizeof(header))
+    return NULL;
+
+  memcpy(&header, file, sizeof(header));
+
+  if (memcmp(header.magic, BYTECACHE_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != BYTECACHE_VERSION ||
+      header.num_opcodes != NUM_OPCODES ||
+      header.build_id != build_id())
+    return NULL;
+
+  //
+  // is it for the source as it is now?
+  //
+  if (header.source_size != source->size ||
+      header.source_hash != hash_bytes(source->text, source->size, 0))
+    return NULL;
+
+  //
+  // is all of it there, and intact?
+  //
+  long size = payload_size(&header);
+
+  if (size < 0 || size != file_size - (long)sizeof(header))
+    return NULL;
+
+  const char* payload = file + sizeof(header);
+
+  if (header.checksum != hash_bytes(payload, size, header.source_hash))
+    return NULL;
+
+  const char* p = payload;
+  const struct BYTECACHE_CONSTANT* constants = (const struct BYTECACHE_CONSTANT*)p;
+  p += header.num_constants * sizeof(struct BYTECACHE_CONSTANT);
+  const struct INSTR* code = (const struct INSTR*)p;
+  p += header.num_instrs * sizeof(struct INSTR);
+  const int32_t* lines = (const int32_t*)p;
+  p += header.num_instrs * sizeof(int32_t);
+  const int32_t* names = (const int32_t*)p;
+  p += header.num_names * sizeof(int32_t);
+  const char* strings = p;
+
+  //
+  // does it make sense?
+  //
+  for (int i = 0; i < header.num_constants; i++) {
+    if (constants[i].value_type < RAM_TYPE_INT || constants[i].value_type > RAM_TYPE_NONE)
+      return NULL;
+    if (constants[i].value_type == RAM_TYPE_STR &&
+        !valid_string(strings, header.strings_size, constants[i].i))
+      return NULL;
+  }
+
+  for (int i = 0; i < header.num_names; i++) {
+    if (!valid_string(strings, header.strings_size, names[i]))
+      return NULL;
+  }
+
+  for (int i = 0; i < header.num_instrs; i++) {
+    if (!valid_instr(&header, constants, &code[i]))
+      return NULL;
+  }
+
+  if (code[header.num_instrs - 1].opcode != OP_HALT)
+    return NULL;
+
+  //
+  // it does, copy it out:
+  //
+  struct BYTECODE* bytecode = (struct BYTECODE*)malloc(sizeof(struct BYTECODE));
+
+  bytecode->num_instrs = header.num_instrs;
+  bytecode->code_capacity = header.num_instrs;
+  bytecode->code = (struct INSTR*)malloc(header.num_instrs * sizeof(struct INSTR));
+  bytecode->lines = (int*)malloc(header.num_instrs * sizeof(int));
+
+  memcpy(bytecode->code, code, header.num_instrs * sizeof(struct INSTR));
+  for (int i = 0; i < header.num_instrs; i++) {
+    bytecode->lines[i] = lines[i];
+  }
+
+  bytecode->num_constants = header.num_constants;
+  bytecode->const_capacity = header.num_constants + 1;
+  bytecode->constants = (struct RAM_VALUE*)malloc((header.num_constants + 1) * sizeof(struct RAM_VALUE));
+
+  for (int i = 0; i < header.num_constants; i++) {
+    struct RAM_VALUE* constant = &bytecode->constants[i];
+
+    constant->value_type = constants[i].value_type;
+
+    if (constant->value_type == RAM_TYPE_STR)
+      constant->types.s = dup_string(strings + constants[i].i);
+    else if (constant->value_type == RAM_TYPE_REAL)
+      constant->types.d = constants[i].d;
+    else
+      constant->types.i = constants[i].i;
+  }
+
+  bytecode->num_names = header.num_names;
+  bytecode->names = (char**)malloc((header.num_names + 1) * sizeof(char*));
+
+  for (int i = 0; i < header.num_names; i++) {
+    bytecode->names[i] = dup_string(strings + names[i]);
+  }
+
+  //
+  // the VM runs a specialized instruction without checking that its
+  // variables are defined and of the right types, so that has to be
+  // proven here, not taken from the file:
+  //
+  if (!infer_check_bytecode(bytecode)) {
+    bytecode_destroy(bytecode);
+    return NULL;
+  }
+
+  return bytecode;
+}
+
+//
+// add_string
+//
+// Appends the given string to the pool, and returns its offset.
+//
+static int32_t add_string(char** pool, int32_t* size, int32_t* capacity, const char* s)
+{
+  int32_t length = (int32_t)strlen(s) + 1;  // including '\0'
+
+  while (*size + length > *capacity) {
+    *capacity *= 2;
+    *pool = (char*)realloc(*pool, *capacity);
+  }
+
+  int32_t offset = *size;
+  memcpy(*pool + offset, s, length);
+  *size += length;
+
+  return offset;
+}
+
+
+//
+// Public functions:
+//
+
+//
+// bytecache_filename
+//
+// Returns the source's name with a "c" appended.
+//
+char* bytecache_filename(const char* filename)
+{
+  char* cachename = (char*)malloc(strlen(filename) + 2);
+
+  strcpy(cachename, filename);
+  strcat(cachename, "c");
+
+  return cachename;
+}
+
+
+//
+// bytecache_load
+//
+// Maps the cache file, and decodes it if it's valid.
+//
+struct BYTECODE* bytecache_load(const char* cachename, struct MappedSource* source)
+{
+  int fd = open(cachename, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+
+  struct stat info;
+  if (fstat(fd, &info) < 0 || info.st_size < (off_t)sizeof(struct BYTECACHE_HEADER)) {
+    close(fd);
+    return NULL;
+  }
+
+  void* mapping = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (mapping == MAP_FAILED)
+    return NULL;
+
+  struct BYTECODE* bytecode = decode((const char*)mapping, (long)info.st_size, source);
+
+  munmap(mapping, info.st_size);
+
+  return bytecode;
+}
+
+
+//
+// bytecache_save
+//
+// Lays the bytecode out as described in bytecache.h, and writes it
+// to a temporary file that is then renamed to the cache file.
+//
+bool bytecache_save(const char* cachename, struct MappedSource* source, struct BYTECODE* bytecode)
+{
+  struct BYTECACHE_HEADER header;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, BYTECACHE_MAGIC, sizeof(header.magic));
+  header.version = BYTECACHE_VERSION;
+  header.num_opcodes = NUM_OPCODES;
+  header.build_id = build_id();
+  header.source_hash = hash_bytes(source->text, source->size, 0);
+  header.source_size = source->size;
+  header.num_instrs = bytecode->num_instrs;
+  header.num_constants = bytecode->num_constants;
+  header.num_names = bytecode->num_names;
+
+  //
+  // the constants and names refer to the string pool by offset:
+  //
+  int32_t strings_size = 0;
+  int32_t strings_capacity = 256;
+  char* strings = (char*)malloc(strings_capacity);
+
+  struct BYTECACHE_CONSTANT* constants = (struct BYTECACHE_CONSTANT*)malloc((bytecode->num_constants + 1) * sizeof(struct BYTECACHE_CONSTANT));
+
+  for (int i = 0; i < bytecode->num_constants; i++) {
+    struct RAM_VALUE* constant = &bytecode->constants[i];
+
+    memset(&constants[i], 0, sizeof(constants[i]));
+    constants[i].value_type = constant->value_type;
+
+    if (constant->value_type == RAM_TYPE_STR)
+      constants[i].i = add_string(&strings, &strings_size, &strings_capacity, constant->types.s);
+    else if (constant->value_type == RAM_TYPE_REAL)
+      constants[i].d = constant->types.d;
+    else
+      constants[i].i = constant->types.i;
+  }
+
+  int32_t* names = (int32_t*)malloc((bytecode->num_names + 1) * sizeof(int32_t));
+
+  for (int i = 0; i < bytecode->num_names; i++) {
+    names[i] = add_string(&strings, &strings_size, &strings_capacity, bytecode->names[i]);
+  }
+
+  header.strings_size = strings_size;
+
+  //
+  // the payload, in one piece for the checksum:
+  //
+  long size = payload_size(&header);
+  char* payload = (char*)malloc(size);
+  char* p = payload;
+
+  memcpy(p, constants, bytecode->num_constants * sizeof(struct BYTECACHE_CONSTANT));
+  p += bytecode->num_constants * sizeof(struct BYTECACHE_CONSTANT);
+  memcpy(p, bytecode->code, bytecode->num_instrs * sizeof(struct INSTR));
+  p += bytecode->num_instrs * sizeof(struct INSTR);
+  for (int i = 0; i < bytecode->num_instrs; i++) {
+    int32_t line = bytecode->lines[i];
+    memcpy(p, &line, sizeof(line));
+    p += sizeof(line);
+  }
+  memcpy(p, names, bytecode->num_names * sizeof(int32_t));
+  p += bytecode->num_names * sizeof(int32_t);
+  memcpy(p, strings, strings_size);
+  p += strings_size;
+
+  assert(p - payload == size);
+
+  header.checksum = hash_bytes(payload, size, header.source_hash);
+
+  free(strings);
+  free(constants);
+  free(names);
+
+  //
+  // write it under a temporary name, then rename:
+  //
+  char* tempname = (char*)malloc(strlen(cachename) + 8);
+  strcpy(tempname, cachename);
+  strcat(tempname, "XXXXXX");
+
+  bool saved = false;
+  int fd = mkstemp(tempname);
+
+  if (fd >= 0) {
+    fchmod(fd, 0644);  // mkstemp makes it 0600
+
+    FILE* output = fdopen(fd, "wb");
+
+    bool written = (output != NULL) &&
+                   fwrite(&header, sizeof(header), 1, output) == 1 &&
+                   fwrite(payload, 1, size, output) == (size_t)size;
+
+    if (output != NULL)
+      written = (fclose(output) == 0) && written;
+    else
+      close(fd);
+
+    if (written)
+      saved = (rename(tempname, cachename) == 0);
+
+    if (!saved)
+      unlink(tempname);
+  }
+
+  free(tempname);
+  free(payload);
+
+  return saved;
+}
@@ -0,0 +1,68 @@
+/*bytecache.h*/
+
+//
+// Bytecode cache for nuPython. The bytecode compiled from a source
+// file is saved next to it ("prog.py" -> "prog.pyc"), keyed by a
+// hash of the source text, so running the same file again skips
+// scanning, parsing, building the program graph and compiling: the
+// cache file is memory-mapped, checked, and copied into bytecode.
+//
+// The file holds no pointers, only counts and offsets, so it can
+// be mapped anywhere. It starts with a header:
+//
+//   magic, format version, # of opcodes, id of the compiler build,
+//   hash and size of the source, # of instructions, constants and
+//   names, size of the string pool, checksum of the rest of the file
+//
+// followed by the constants, the instructions, their line numbers,
+// the offset of each name in the string pool, and the pool of
+// '\0'-terminated strings. A file that is stale, from another
+// version or build, truncated or corrupt is ignored (and then
+// replaced).
+// The checksum guards against corruption, not against a file
+// crafted to pass it, so everything the VM relies on is checked as
+// well: counts, offsets and operands are in range, and the types
+// the specialized instructions assume are inferred again from the
+// bytecode (see infer.h).
+//
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+
+#include "mapscanner.h"
+#include "bytecode.h"
+
+
+//
+// Public functions:
+//
+
+//
+// bytecache_filename
+//
+// Returns the name of the cache file for the given source file,
+// the source's name with a "c" appended. The caller frees it.
+//
+char* bytecache_filename(const char* filename);
+
+//
+// bytecache_load
+//
+// Returns the bytecode in the given cache file, if it was compiled
+// from the given source, as it is now, by this version of nuPython.
+// Returns NULL otherwise, or if the file doesn't exist or fails any
+// check, in which case the source should be compiled as usual.
+//
+struct BYTECODE* bytecache_load(const char* cachename, struct MappedSource* source);
+
+//
+// bytecache_save
+//
+// Saves the given bytecode, compiled from the given source, to the
+// given cache file. The file is written under a temporary name and
+// then renamed, so a concurrent bytecache_load sees either the old
+// file or the new one. Returns false if the file can't be written
+// (e.g. the directory is read-only); that is not an error.
+//
+bool bytecache_save(const char* cachename, struct MappedSource* source, struct BYTECODE* bytecode);
@@ -0,0 +1,426 @@
+/*bytecode.c*/
+
+//
+// Compiles a nuPython program graph into bytecode, see bytecode.h.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+#include <assert.h>
+
+#include "programgraph.h"
+#include "resolve.h"
+#include "infer.h"
+#include "ram.h"
+#include "bytecode.h"
+
+
+//
+// enum SPECIALIZED_OPS => opcode:
+//
+static const int specialized_opcodes[NUM_SPECIALIZED_OPS] = {
+  [SPEC_GENERIC] = OP_BINARY,
+#define SPECIALIZED_OPCODE(type, name, operator, op, result_type) [SPEC_##type##_##name] = OP_##type##_##name,
+  SPECIALIZED_BINARIES(SPECIALIZED_OPCODE)
+#undef SPECIALIZED_OPCODE
+};
+
+
+//
+// Private functions:
+//
+
+//
+// dup_string
+//
+// Returns a malloc'd copy of the given string.
+//
+static char* dup_string(char* s)
+{
+  char* copy = (char*)malloc(strlen(s) + 1);
+  strcpy(copy, s);
+  return copy;
+}
+
+//
+// emit
+//
+// Appends an instruction to the bytecode, returning its index.
+//
+static int emit(struct BYTECODE* bytecode, int opcode, int arg, int lhs, int rhs, int line)
+{
+  if (bytecode->num_instrs == bytecode->code_capacity) {
+    bytecode->code_capacity *= 2;
+    bytecode->code = (struct INSTR*)realloc(bytecode->code, bytecode->code_capacity * sizeof(struct INSTR));
+    bytecode->lines = (int*)realloc(bytecode->lines, bytecode->code_capacity * sizeof(int));
+  }
+
+  int i = bytecode->num_instrs;
+  bytecode->code[i].opcode = opcode;
+  bytecode->code[i].arg = arg;
+  bytecode->code[i].lhs = lhs;
+  bytecode->code[i].rhs = rhs;
+  bytecode->lines[i] = line;
+  bytecode->num_instrs++;
+
+  return i;
+}
+
+//
+// add_constant
+//
+// Appends a value to the constant pool, returning its index. If
+// the value is a string, the constant pool takes ownership.
+//
+static int add_constant(struct BYTECODE* bytecode, struct RAM_VALUE value)
+{
+  if (bytecode->num_constants == bytecode->const_capacity) {
+    bytecode->const_capacity *= 2;
+    bytecode->constants = (struct RAM_VALUE*)realloc(bytecode->constants, bytecode->const_capacity * sizeof(struct RAM_VALUE));
+  }
+
+  bytecode->constants[bytecode->num_constants] = value;
+  bytecode->num_constants++;
+
+  return bytecode->num_constants - 1;
+}
+
+//
+// compile_operand
+//
+// Turns the given element into an operand: the slot of a variable,
+// or a literal (already parsed by resolve_program) which is added
+// to the constant pool. Returns false if the element can't be an
+// operand (None is not supported as a value yet).
+//
+static bool compile_operand(struct BYTECODE* bytecode, struct SYMTAB* symbols, struct ELEMENT* element, int* operand)
+{
+  if (element->element_type == ELEMENT_IDENTIFIER) {
+    *operand = resolve_slot(symbols, element);
+    return true;
+  }
+
+  const struct RAM_VALUE* constant = resolve_constant(symbols, element);
+  if (constant == NULL)
+    return false;
+
+  struct RAM_VALUE value = *constant;
+  if (value.value_type == RAM_TYPE_STR) {
+    value.types.s = dup_string(value.types.s);
+  }
+
+  *operand = OPERAND_CONST(add_constant(bytecode, value));
+  return true;
+}
+
+//
+// compile_expr
+//
+// Emits the instructions that leave the value of the given
+// expression in the accumulator. The unary operators are not
+// supported by the executor yet, so only the underlying element
+// is used. An operand that is None stops the program silently,
+// like the executor does, after any error in the lhs.
+//
+static void compile_expr(struct BYTECODE* bytecode, struct SYMTAB* symbols, struct TYPEINFO* types, struct EXPR* expr, int line)
+{
+  int lhs, rhs;
+
+  if (!compile_operand(bytecode, symbols, expr->lhs->element, &lhs)) {
+    emit(bytecode, OP_STOP, 0, 0, 0, line);
+    return;
+  }
+
+  if (!expr->isBinaryExpr) {
+    emit(bytecode, OP_LOAD, 0, lhs, 0, line);
+    return;
+  }
+
+  assert(expr->operator != OPERATOR_NO_OP);
+
+  if (!compile_operand(bytecode, symbols, expr->rhs->element, &rhs)) {
+    emit(bytecode, OP_LOAD, 0, lhs, 0, line);
+    emit(bytecode, OP_STOP, 0, 0, 0, line);
+    return;
+  }
+
+  int opcode = OP_BINARY;
+  if (types != NULL)
+    opcode = specialized_opcodes[infer_op(types, expr)];
+
+  emit(bytecode, opcode, expr->operator, lhs, rhs, line);
+}
+
+//
+// compile_call
+//
+// Emits an instruction that takes the given element as its single
+// operand, such as print(x) or int(x).
+//
+static void compile_call(struct BYTECODE* bytecode, struct SYMTAB* symbols, int opcode, struct ELEMENT* parameter, int line)
+{
+  int operand;
+
+  if (!compile_operand(bytecode, symbols, parameter, &operand)) {
+    emit(bytecode, OP_STOP, 0, 0, 0, line);
+    return;
+  }
+
+  emit(bytecode, opcode, 0, operand, 0, line);
+}
+
+//
+// compile_function_value
+//
+// Emits the instructions for a function call on the right-hand
+// side of an assignment: input("prompt"), int(x) or float(x).
+//
+static void compile_function_value(struct BYTECODE* bytecode, struct SYMTAB* symbols, struct FUNCTION_CALL* call, int line)
+{
+  if (strcmp(call->function_name, "input") == 0) {
+    struct RAM_VALUE prompt;
+    prompt.value_type = RAM_TYPE_STR;
+    prompt.types.s = dup_string(call->parameter != NULL ? call->parameter->element_value : "");
+
+    emit(bytecode, OP_INPUT, add_constant(bytecode, prompt), 0, 0, line);
+  }
+  else if (strcmp(call->function_name, "int") == 0) {
+    compile_call(bytecode, symbols, OP_INT, call->parameter, line);
+  }
+  else if (strcmp(call->function_name, "float") == 0) {
+    compile_call(bytecode, symbols, OP_FLOAT, call->parameter, line);
+  }
+  else {
+    emit(bytecode, OP_BAD_CALL, 0, 0, 0, line);
+  }
+}
+
+//
+// compile_stmts
+//
+// Compiles the chain of statements starting at stmt, stopping at
+// the end of the program (NULL) or when the chain loops back to
+// the given while loop header (the end of a loop body).
+//
+static void compile_stmts(struct BYTECODE* bytecode, struct SYMTAB* symbols, struct TYPEINFO* types, struct STMT* stmt, struct STMT* loop_header)
+{
+  while (stmt != NULL && stmt != loop_header) {
+
+    if (stmt->stmt_type == STMT_ASSIGNMENT) {
+      struct STMT_ASSIGNMENT* assign = stmt->types.assignment;
+
+      //
+      // no pointers yet:
+      //
+      assert(assign->isPtrDeref == false);
+
+      if (assign->rhs->value_type == VALUE_EXPR) {
+        compile_expr(bytecode, symbols, types, assign->rhs->types.expr, stmt->line);
+      }
+      else {
+        compile_function_value(bytecode, symbols, assign->rhs->types.function_call, stmt->line);
+      }
+      emit(bytecode, OP_STORE, resolve_slot(symbols, stmt), 0, 0, stmt->line);
+
+      stmt = assign->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_FUNCTION_CALL) {
+      //
+      // for now we are assuming it's a call to print:
+      //
+      struct STMT_FUNCTION_CALL* call = stmt->types.function_call;
+
+      if (call->parameter == NULL) {
+        emit(bytecode, OP_PRINT_NEWLINE, 0, 0, 0, stmt->line);
+      }
+      else {
+        compile_call(bytecode, symbols, OP_PRINT, call->parameter, stmt->line);
+      }
+
+      stmt = call->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+      //
+      // the condition goes at the bottom, so that each iteration
+      // takes a single jump:
+      //
+      //       JUMP test
+      // body: <body>
+      // test: <condition>
+      //       JUMP_IF_TRUE body
+      //
+      struct STMT_WHILE_LOOP* loop = stmt->types.while_loop;
+
+      int entry_jump = emit(bytecode, OP_JUMP, -1, 0, 0, stmt->line);
+
+      int body = bytecode->num_instrs;
+      compile_stmts(bytecode, symbols, types, loop->loop_body, stmt);
+
+      bytecode->code[entry_jump].arg = bytecode->num_instrs;
+      compile_expr(bytecode, symbols, types, loop->condition, stmt->line);
+      emit(bytecode, OP_JUMP_IF_TRUE, body, 0, 0, stmt->line);
+
+      stmt = loop->next_stmt;
+    }
+    else {
+      assert(stmt->stmt_type == STMT_PASS);
+
+      //
+      // nothing to do!
+      //
+      stmt = stmt->types.pass->next_stmt;
+    }
+  }
+}
+
+
+//
+// Public functions:
+//
+
+//
+// bytecode_compile
+//
+// Compiles the given program graph into bytecode.
+//
+struct BYTECODE* bytecode_compile(struct STMT* program, struct SYMTAB* symbols, struct TYPEINFO* types)
+{
+  struct BYTECODE* bytecode = (struct BYTECODE*)malloc(sizeof(struct BYTECODE));
+
+  bytecode->code_capacity = 64;
+  bytecode->num_instrs = 0;
+  bytecode->code = (struct INSTR*)malloc(bytecode->code_capacity * sizeof(struct INSTR));
+  bytecode->lines = (int*)malloc(bytecode->code_capacity * sizeof(int));
+
+  bytecode->const_capacity = 16;
+  bytecode->num_constants = 0;
+  bytecode->constants = (struct RAM_VALUE*)malloc(bytecode->const_capacity * sizeof(struct RAM_VALUE));
+
+  bytecode->num_names = symbols->num_symbols;
+  bytecode->names = (char**)malloc((symbols->num_symbols + 1) * sizeof(char*));
+  for (int i = 0; i < symbols->num_symbols; i++) {
+    bytecode->names[i] = dup_string(symbols->symbols[i].name);
+  }
+
+  compile_stmts(bytecode, symbols, types, program, NULL);
+  emit(bytecode, OP_HALT, 0, 0, 0, 0);
+
+  return bytecode;
+}
+
+
+//
+// bytecode_destroy
+//
+// Frees the memory associated with the given bytecode.
+//
+void bytecode_destroy(struct BYTECODE* bytecode)
+{
+  for (int i = 0; i < bytecode->num_constants; i++) {
+    if (bytecode->constants[i].value_type == RAM_TYPE_STR) {
+      free(bytecode->constants[i].types.s);
+    }
+  }
+  for (int i = 0; i < bytecode->num_names; i++) {
+    free(bytecode->names[i]);
+  }
+
+  free(bytecode->code);
+  free(bytecode->lines);
+  free(bytecode->constants);
+  free(bytecode->names);
+  free(bytecode);
+}
+
+
+//
+// print_operand
+//
+// Prints a variable name or a constant, for bytecode_print.
+//
+static void print_operand(struct BYTECODE* bytecode, int operand)
+{
+  if (!OPERAND_IS_CONST(operand)) {
+    printf(" %s", bytecode->names[operand]);
+    return;
+  }
+
+  struct RAM_VALUE* constant = &bytecode->constants[OPERAND_CONST_INDEX(operand)];
+
+  switch (constant->value_type) {
+    case RAM_TYPE_INT:
+      printf(" %d", constant->types.i);
+      break;
+    case RAM_TYPE_REAL:
+      printf(" %lf", constant->types.d);
+      break;
+    case RAM_TYPE_STR:
+      printf(" '%s'", constant->types.s);
+      break;
+    case RAM_TYPE_BOOLEAN:
+      printf(" %s", constant->types.i ? "True" : "False");
+      break;
+  }
+}
+
+
+//
+// bytecode_print
+//
+// Prints the bytecode to the console, for debugging.
+//
+void bytecode_print(struct BYTECODE* bytecode)
+{
+  static char* opnames[NUM_OPCODES] = {
+    "LOAD", "BINARY", "STORE", "PRINT", "PRINT_NEWLINE", "INPUT", "INT", "FLOAT",
+    "JUMP", "JUMP_IF_TRUE", "BAD_CALL", "STOP", "HALT",
+#define SPECIALIZED_OPNAME(type, name, operator, op, result_type) #type "_" #name,
+    SPECIALIZED_BINARIES(SPECIALIZED_OPNAME)
+#undef SPECIALIZED_OPNAME
+  };
+
+  printf("**BYTECODE PRINT**\n");
+
+  for (int i = 0; i < bytecode->num_instrs; i++) {
+    struct INSTR* instr = &bytecode->code[i];
+
+    printf(" %4d (line %3d): %-14s", i, bytecode->lines[i], opnames[instr->opcode]);
+
+    if (instr->opcode > OP_HALT) {
+      //
+      // specialized binary operation:
+      //
+      print_operand(bytecode, instr->lhs);
+      print_operand(bytecode, instr->rhs);
+    }
+
+    switch (instr->opcode) {
+      case OP_BINARY:
+        print_operand(bytecode, instr->lhs);
+        printf(" op%d", instr->arg);
+        print_operand(bytecode, instr->rhs);
+        break;
+      case OP_LOAD:
+      case OP_PRINT:
+      case OP_INT:
+      case OP_FLOAT:
+        print_operand(bytecode, instr->lhs);
+        break;
+      case OP_STORE:
+        printf(" %s", bytecode->names[instr->arg]);
+        break;
+      case OP_INPUT:
+        print_operand(bytecode, OPERAND_CONST(instr->arg));
+        break;
+      case OP_JUMP:
+      case OP_JUMP_IF_TRUE:
+        printf(" %d", instr->arg);
+        break;
+    }
+    printf("\n");
+  }
+
+  printf("**END PRINT**\n");
+}
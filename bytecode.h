@@ -0,0 +1,114 @@
+/*bytecode.h*/
+
+//
+// Bytecode for nuPython. The program graph is compiled into a
+// dense array of instructions for a small accumulator machine
+// (see vm.h), with a constant pool of pre-parsed literals and
+// the variables numbered by slot (see resolve.h).
+//
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+
+#include "programgraph.h"
+#include "resolve.h"
+#include "infer.h"
+#include "ram.h"
+
+
+//
+// Instruction set. This is an accumulator machine: an instruction
+// reads its operands straight from variables or constants and
+// leaves its result in the accumulator, so a statement such as
+// x = y + 1 is just BINARY and STORE.
+//
+// Operands (lhs, rhs) name either a variable or a constant: an
+// operand >= 0 is a variable slot, an operand < 0 is a constant,
+// see OPERAND_CONST below.
+//
+enum OPCODES
+{
+  OP_LOAD = 0,        // acc = lhs
+  OP_BINARY,          // acc = lhs <arg> rhs, arg is an enum OPERATORS
+  OP_STORE,           // variable in slot arg = acc
+  OP_PRINT,           // print(lhs)
+  OP_PRINT_NEWLINE,   // print()
+  OP_INPUT,           // print the prompt constants[arg], acc = the line read
+  OP_INT,             // acc = int(lhs)
+  OP_FLOAT,           // acc = float(lhs)
+  OP_JUMP,            // continue at instruction arg
+  OP_JUMP_IF_TRUE,    // continue at instruction arg if acc is True
+  OP_BAD_CALL,        // call to an unknown function: error, stop
+  OP_STOP,            // stop silently (None is not supported as a value yet)
+  OP_HALT,            // end of program
+
+  //
+  // acc = lhs <op> rhs, with operand types proven by infer_types:
+  // OP_INT_ADD, OP_REAL_LT, ... (see SPECIALIZED_BINARIES)
+  //
+#define SPECIALIZED_OPCODE(type, name, operator, op, result_type) OP_##type##_##name,
+  SPECIALIZED_BINARIES(SPECIALIZED_OPCODE)
+#undef SPECIALIZED_OPCODE
+
+  NUM_OPCODES
+};
+
+#define OPERAND_CONST(index)      (-(index) - 1)
+#define OPERAND_IS_CONST(operand) ((operand) < 0)
+#define OPERAND_CONST_INDEX(operand) (-(operand) - 1)
+
+struct INSTR
+{
+  int opcode;  // enum OPCODES
+  int arg;     // operator, slot or jump target, depends on the opcode
+  int lhs;     // first operand, if any
+  int rhs;     // second operand, if any
+};
+
+struct BYTECODE
+{
+  struct INSTR* code;  // array of instructions, ends with OP_HALT
+  int* lines;          // source line # of each instruction, for errors
+  int num_instrs;
+  int code_capacity;
+
+  struct RAM_VALUE* constants;  // pre-parsed literals, strings owned
+  int num_constants;
+  int const_capacity;
+
+  char** names;   // variable name of each slot, owned
+  int num_names;
+};
+
+
+//
+// Public functions:
+//
+
+//
+// bytecode_compile
+//
+// Compiles the given program graph, whose identifiers were
+// resolved to the given symbol table, into bytecode. Literals
+// are copied into the constant pool. Binary expressions that type
+// inference specialized get specialized opcodes; pass NULL types
+// to compile every binary expression to the generic OP_BINARY.
+// Returns the bytecode, which does not refer to the program graph,
+// the symbol table or the types, so all may be destroyed afterwards.
+//
+struct BYTECODE* bytecode_compile(struct STMT* program, struct SYMTAB* symbols, struct TYPEINFO* types);
+
+//
+// bytecode_destroy
+//
+// Frees the memory associated with the given bytecode.
+//
+void bytecode_destroy(struct BYTECODE* bytecode);
+
+//
+// bytecode_print
+//
+// Prints the bytecode to the console, for debugging.
+//
+void bytecode_print(struct BYTECODE* bytecode);
@@ -0,0 +1,597 @@
+/*dtoa.c*/
+
+//
+// Formatting of nuPython reals, see dtoa.h.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "dtoa.h"
+
+
+//
+// the format of dtoa_format:
+//
+static enum REAL_FORMATS real_format = REAL_FORMAT_FIXED;
+
+//
+// A "do it yourself" floating-point number, f * 2^e, with a
+// 64-bit significand and no rounding of its own:
+//
+struct DIYFP
+{
+  uint64_t f;
+  int      e;
+};
+
+//
+// Powers of ten, 10^k ~= f * 2^e with f normalized (its top bit
+// set) and rounded to nearest, for k = -348, -340, ..., 340, so
+// that any double can be scaled into the range Grisu needs with
+// one multiplication:
+//
+struct CACHED_POWER
+{
+  uint64_t f;
+  int16_t  e;
+  int16_t  k;
+};
+
+static const struct CACHED_POWER cached_powers[] =
+{
+  { 0xfa8fd5a0081c0288ULL, -1220, -348 },
+  { 0xbaaee17fa23ebf76ULL, -1193, -340 },
+  { 0x8b16fb203055ac76ULL, -1166, -332 },
+  { 0xcf42894a5dce35eaULL, -1140, -324 },
+  { 0x9a6bb0aa55653b2dULL, -1113, -316 },
+  { 0xe61acf033d1a45dfULL, -1087, -308 },
+  { 0xab70fe17c79ac6caULL, -1060, -300 },
+  { 0xff77b1fcbebcdc4fULL, -1034, -292 },
+  { 0xbe5691ef416bd60cULL, -1007, -284 },
+  { 0x8dd01fad907ffc3cULL,  -980, -276 },
+  { 0xd3515c2831559a83ULL,  -954, -268 },
+  { 0x9d71ac8fada6c9b5ULL,  -927, -260 },
+  { 0xea9c227723ee8bcbULL,  -901, -252 },
+  { 0xaecc49914078536dULL,  -874, -244 },
+  { 0x823c12795db6ce57ULL,  -847, -236 },
+  { 0xc21094364dfb5637ULL,  -821, -228 },
+  { 0x9096ea6f3848984fULL,  -794, -220 },
+  { 0xd77485cb25823ac7ULL,  -768, -212 },
+  { 0xa086cfcd97bf97f4ULL,  -741, -204 },
+  { 0xef340a98172aace5ULL,  -715, -196 },
+  { 0xb23867fb2a35b28eULL,  -688, -188 },
+  { 0x84c8d4dfd2c63f3bULL,  -661, -180 },
+  { 0xc5dd44271ad3cdbaULL,  -635, -172 },
+  { 0x936b9fcebb25c996ULL,  -608, -164 },
+  { 0xdbac6c247d62a584ULL,  -582, -156 },
+  { 0xa3ab66580d5fdaf6ULL,  -555, -148 },
+  { 0xf3e2f893dec3f126ULL,  -529, -140 },
+  { 0xb5b5ada8aaff80b8ULL,  -502, -132 },
+  { 0x87625f056c7c4a8bULL,  -475, -124 },
+  { 0xc9bcff6034c13053ULL,  -449, -116 },
+  { 0x964e858c91ba2655ULL,  -422, -108 },
+  { 0xdff9772470297ebdULL,  -396, -100 },
+  { 0xa6dfbd9fb8e5b88fULL,  -369,  -92 },
+  { 0xf8a95fcf88747d94ULL,  -343,  -84 },
+  { 0xb94470938fa89bcfULL,  -316,  -76 },
+  { 0x8a08f0f8bf0f156bULL,  -289,  -68 },
+  { 0xcdb02555653131b6ULL,  -263,  -60 },
+  { 0x993fe2c6d07b7facULL,  -236,  -52 },
+  { 0xe45c10c42a2b3b06ULL,  -210,  -44 },
+  { 0xaa242499697392d3ULL,  -183,  -36 },
+  { 0xfd87b5f28300ca0eULL,  -157,  -28 },
+  { 0xbce5086492111aebULL,  -130,  -20 },
+  { 0x8cbccc096f5088ccULL,  -103,  -12 },
+  { 0xd1b71758e219652cULL,   -77,   -4 },
+  { 0x9c40000000000000ULL,   -50,    4 },
+  { 0xe8d4a51000000000ULL,   -24,   12 },
+  { 0xad78ebc5ac620000ULL,     3,   20 },
+  { 0x813f3978f8940984ULL,    30,   28 },
+  { 0xc097ce7bc90715b3ULL,    56,   36 },
+  { 0x8f7e32ce7bea5c70ULL,    83,   44 },
+  { 0xd5d238a4abe98068ULL,   109,   52 },
+  { 0x9f4f2726179a2245ULL,   136,   60 },
+  { 0xed63a231d4c4fb27ULL,   162,   68 },
+  { 0xb0de65388cc8ada8ULL,   189,   76 },
+  { 0x83c7088e1aab65dbULL,   216,   84 },
+  { 0xc45d1df942711d9aULL,   242,   92 },
+  { 0x924d692ca61be758ULL,   269,  100 },
+  { 0xda01ee641a708deaULL,   295,  108 },
+  { 0xa26da3999aef774aULL,   322,  116 },
+  { 0xf209787bb47d6b85ULL,   348,  124 },
+  { 0xb454e4a179dd1877ULL,   375,  132 },
+  { 0x865b86925b9bc5c2ULL,   402,  140 },
+  { 0xc83553c5c8965d3dULL,   428,  148 },
+  { 0x952ab45cfa97a0b3ULL,   455,  156 },
+  { 0xde469fbd99a05fe3ULL,   481,  164 },
+  { 0xa59bc234db398c25ULL,   508,  172 },
+  { 0xf6c69a72a3989f5cULL,   534,  180 },
+  { 0xb7dcbf5354e9beceULL,   561,  188 },
+  { 0x88fcf317f22241e2ULL,   588,  196 },
+  { 0xcc20ce9bd35c78a5ULL,   614,  204 },
+  { 0x98165af37b2153dfULL,   641,  212 },
+  { 0xe2a0b5dc971f303aULL,   667,  220 },
+  { 0xa8d9d1535ce3b396ULL,   694,  228 },
+  { 0xfb9b7cd9a4a7443cULL,   720,  236 },
+  { 0xbb764c4ca7a44410ULL,   747,  244 },
+  { 0x8bab8eefb6409c1aULL,   774,  252 },
+  { 0xd01fef10a657842cULL,   800,  260 },
+  { 0x9b10a4e5e9913129ULL,   827,  268 },
+  { 0xe7109bfba19c0c9dULL,   853,  276 },
+  { 0xac2820d9623bf429ULL,   880,  284 },
+  { 0x80444b5e7aa7cf85ULL,   907,  292 },
+  { 0xbf21e44003acdd2dULL,   933,  300 },
+  { 0x8e679c2f5e44ff8fULL,   960,  308 },
+  { 0xd433179d9c8cb841ULL,   986,  316 },
+  { 0x9e19db92b4e31ba9ULL,  1013,  324 },
+  { 0xeb96bf6ebadf77d9ULL,  1039,  332 },
+  { 0xaf87023b9bf0ee6bULL,  1066,  340 }
+};
+
+#define CACHED_POWERS_OFFSET  348  // -k of the first power
+#define CACHED_POWERS_STEP      8  // between powers
+
+//
+// the binary exponents a scaled double may have, so its integral
+// part fits 32 bits and its fraction leaves room for a digit:
+//
+#define MIN_TARGET_EXPONENT  -60
+#define MAX_TARGET_EXPONENT  -32
+
+
+//
+// Private functions:
+//
+
+//
+// decompose
+//
+// Splits the given finite, non-negative double into its significand
+// (with the hidden bit, if any) and binary exponent, d = f * 2^e.
+//
+static struct DIYFP decompose(double d)
+{
+  uint64_t bits;
+  memcpy(&bits, &d, sizeof(bits));
+
+  int biased = (int)((bits >> 52) & 0x7FF);
+  uint64_t fraction = bits & ((1ULL << 52) - 1);
+
+  struct DIYFP x;
+
+  if (biased == 0) {  // subnormal
+    x.f = fraction;
+    x.e = -1074;
+  }
+  else {
+    x.f = fraction | (1ULL << 52);
+    x.e = biased - 1075;
+  }
+
+  return x;
+}
+
+//
+// normalize
+//
+// Shifts the significand left until its top bit is set.
+//
+static struct DIYFP normalize(struct DIYFP x)
+{
+  int shift = __builtin_clzll(x.f);
+
+  x.f <<= shift;
+  x.e -= shift;
+
+  return x;
+}
+
+//
+// multiply
+//
+// Returns x * y, the upper 64 bits of the product rounded.
+//
+static struct DIYFP multiply(struct DIYFP x, struct DIYFP y)
+{
+  unsigned __int128 product = (unsigned __int128)x.f * y.f;
+
+  struct DIYFP result;
+
+  result.f = (uint64_t)((product + ((unsigned __int128)1 << 63)) >> 64);
+  result.e = x.e + y.e + 64;
+
+  return result;
+}
+
+//
+// cached_power
+//
+// Returns a power of ten, 10^k, that scales a normalized number
+// with the given binary exponent to a binary exponent between
+// MIN_TARGET_EXPONENT and MAX_TARGET_EXPONENT.
+//
+static struct DIYFP cached_power(int e, int* k)
+{
+  int min_exponent = MIN_TARGET_EXPONENT - (e + 64);
+  int estimate = (int)ceil((min_exponent + 64 - 1) * 0.30102999566398114);  // log10(2)
+  int index = (CACHED_POWERS_OFFSET + estimate - 1) / CACHED_POWERS_STEP + 1;
+
+  struct DIYFP power;
+
+  power.f = cached_powers[index].f;
+  power.e = cached_powers[index].e;
+  *k = cached_powers[index].k;
+
+  return power;
+}
+
+//
+// round_weed
+//
+// Grisu3's last step: moves the last digit generated closer to the
+// exact value, while staying inside the interval of numbers that
+// read back as the value, and tells if the digits are certain to
+// be the closest and to read back despite the imprecision (+/- unit)
+// of the scaled numbers. See Loitsch, section 6.
+//
+static bool round_weed(char* digits, int length, uint64_t distance_too_high_w, uint64_t unsafe_interval,
+  uint64_t rest, uint64_t ten_kappa, uint64_t unit)
+{
+  uint64_t small_distance = distance_too_high_w - unit;
+  uint64_t big_distance = distance_too_high_w + unit;
+
+  while (rest < small_distance &&
+         unsafe_interval - rest >= ten_kappa &&
+         (rest + ten_kappa < small_distance ||
+          small_distance - rest >= rest + ten_kappa - small_distance)) {
+    digits[length - 1]--;
+    rest += ten_kappa;
+  }
+
+  if (rest < big_distance &&
+      unsafe_interval - rest >= ten_kappa &&
+      (rest + ten_kappa < big_distance ||
+       big_distance - rest > rest + ten_kappa - big_distance)) {
+    return false;
+  }
+
+  return (2 * unit <= rest) && (rest <= unsafe_interval - 4 * unit);
+}
+
+//
+// generate_digits
+//
+// Generates the shortest digits of w, scaled, that lie between low
+// and high (its scaled boundaries): digits * 10^kappa. Returns false
+// if the digits can't be certain, see round_weed.
+//
+static bool generate_digits(struct DIYFP low, struct DIYFP w, struct DIYFP high, char* digits, int* length, int* kappa)
+{
+  uint64_t unit = 1;
+  uint64_t too_low = low.f - unit;
+  uint64_t too_high = high.f + unit;
+  uint64_t unsafe_interval = too_high - too_low;
+
+  int shift = -w.e;
+  uint64_t one = 1ULL << shift;
+
+  uint32_t integrals = (uint32_t)(too_high >> shift);
+  uint64_t fractionals = too_high & (one - 1);
+
+  uint32_t divisor = 1;
+
+  *kappa = 1;
+  while (integrals / divisor >= 10) {
+    divisor *= 10;
+    (*kappa)++;
+  }
+
+  *length = 0;
+
+  //
+  // the digits of the integral part:
+  //
+  while (*kappa > 0) {
+    digits[(*length)++] = (char)('0' + integrals / divisor);
+    integrals %= divisor;
+    (*kappa)--;
+
+    uint64_t rest = ((uint64_t)integrals << shift) + fractionals;
+
+    if (rest < unsafe_interval)
+      return round_weed(digits, *length, too_high - w.f, unsafe_interval, rest, (uint64_t)divisor << shift, unit);
+
+    divisor /= 10;
+  }
+
+  //
+  // and of the fraction, as many as needed:
+  //
+  for (;;) {
+    fractionals *= 10;
+    unit *= 10;
+    unsafe_interval *= 10;
+
+    digits[(*length)++] = (char)('0' + (fractionals >> shift));
+    fractionals &= one - 1;
+    (*kappa)--;
+
+    if (fractionals < unsafe_interval)
+      return round_weed(digits, *length, (too_high - w.f) * unit, unsafe_interval, fractionals, one, unit);
+  }
+}
+
+//
+// grisu3
+//
+// Finds the shortest digits of the given finite, positive double
+// that read back as the double, and the closest such: d = digits
+// * 10^exponent. Returns false if it can't be certain of them.
+//
+static bool grisu3(double d, char* digits, int* length, int* exponent)
+{
+  struct DIYFP v = decompose(d);
+  struct DIYFP w = normalize(v);
+
+  //
+  // the boundaries, halfway to the neighboring doubles; the one
+  // below is closer if v is a power of two (but not the smallest
+  // normal), where the exponent steps down:
+  //
+  struct DIYFP plus = { (v.f << 1) + 1, v.e - 1 };
+  struct DIYFP minus;
+
+  plus = normalize(plus);
+
+  if (v.f == (1ULL << 52) && v.e > -1074) {
+    minus.f = (v.f << 2) - 1;
+    minus.e = v.e - 2;
+  }
+  else {
+    minus.f = (v.f << 1) - 1;
+    minus.e = v.e - 1;
+  }
+
+  minus.f <<= minus.e - plus.e;
+  minus.e = plus.e;
+
+  int k;
+  struct DIYFP power = cached_power(w.e, &k);
+
+  int kappa;
+  bool certain = generate_digits(multiply(minus, power), multiply(w, power), multiply(plus, power), digits, length, &kappa);
+
+  *exponent = kappa - k;
+
+  return certain;
+}
+
+//
+// shortest_slow
+//
+// The same as grisu3, but always certain: tries 1, 2, ..., 17
+// digits with snprintf until strtod reads them back as d.
+//
+static void shortest_slow(double d, char* digits, int* length, int* exponent)
+{
+  char text[40];
+
+  for (int precision = 0; ; precision++) {
+    snprintf(text, sizeof(text), "%.*e", precision, d);
+
+    if (precision == 16 || strtod(text, NULL) == d)
+      break;
+  }
+
+  //
+  // "d.ddde+XX" into digits and an exponent:
+  //
+  char* e = strchr(text, 'e');
+
+  *length = 0;
+  for (char* p = text; p < e; p++) {
+    if (*p != '.')
+      digits[(*length)++] = *p;
+  }
+
+  while (*length > 1 && digits[*length - 1] == '0')
+    (*length)--;
+
+  *exponent = atoi(e + 1) - (*length - 1);
+}
+
+//
+// append_uint128
+//
+// Appends the decimal digits of n to the buffer, returning the new
+// length.
+//
+static int append_uint128(char* buffer, int length, unsigned __int128 n)
+{
+  char reversed[40];
+  int count = 0;
+
+  do {
+    reversed[count++] = (char)('0' + (int)(n % 10));
+    n /= 10;
+  } while (n > 0);
+
+  while (count > 0)
+    buffer[length++] = reversed[--count];
+
+  return length;
+}
+
+
+//
+// Public functions:
+//
+
+//
+// dtoa_fixed
+//
+// Formats as printf("%lf").
+//
+int dtoa_fixed(double d, char* buffer)
+{
+  if (!isfinite(d))
+    return snprintf(buffer, DTOA_BUFFER_SIZE, "%lf", d);
+
+  struct DIYFP v = decompose(fabs(d));
+
+  //
+  // an integer of 2^107 (about 1.6e32) or more, whose millionths
+  // don't fit 128 bits, leave it to printf:
+  //
+  if (v.e > 54)
+    return snprintf(buffer, DTOA_BUFFER_SIZE, "%lf", d);
+
+  //
+  // the value in millionths, rounded half to even as printf does
+  // (f * 10^6 < 2^73):
+  //
+  unsigned __int128 millionths;
+
+  if (v.e >= 0) {
+    millionths = ((unsigned __int128)v.f << v.e) * 1000000;
+  }
+  else if (-v.e > 100) {
+    millionths = 0;  // less than half a millionth
+  }
+  else {
+    unsigned __int128 scaled = (unsigned __int128)v.f * 1000000;
+    int shift = -v.e;
+    unsigned __int128 half = (unsigned __int128)1 << (shift - 1);
+    unsigned __int128 rest = scaled & ((half << 1) - 1);
+
+    millionths = scaled >> shift;
+
+    if (rest > half || (rest == half && (millionths & 1) != 0))
+      millionths++;
+  }
+
+  int length = 0;
+
+  if (signbit(d))
+    buffer[length++] = '-';
+
+  length = append_uint128(buffer, length, millionths / 1000000);
+  buffer[length++] = '.';
+
+  int fraction = (int)(millionths % 1000000);
+
+  for (int divisor = 100000; divisor > 0; divisor /= 10)
+    buffer[length++] = (char)('0' + fraction / divisor % 10);
+
+  buffer[length] = '\0';
+
+  return length;
+}
+
+
+//
+// dtoa_repr
+//
+// Formats as Python's repr().
+//
+int dtoa_repr(double d, char* buffer)
+{
+  int length = 0;
+
+  if (isnan(d))
+    return snprintf(buffer, DTOA_BUFFER_SIZE, "nan");
+
+  if (signbit(d)) {
+    buffer[length++] = '-';
+    d = -d;
+  }
+
+  if (isinf(d))
+    return length + snprintf(buffer + length, DTOA_BUFFER_SIZE - length, "inf");
+
+  if (d == 0.0)
+    return length + snprintf(buffer + length, DTOA_BUFFER_SIZE - length, "0.0");
+
+  char digits[20];
+  int num_digits;
+  int exponent;
+
+  if (!grisu3(d, digits, &num_digits, &exponent))
+    shortest_slow(d, digits, &num_digits, &exponent);
+
+  //
+  // where the decimal point goes, d = 0.digits * 10^point; Python
+  // switches to scientific notation outside 1e-4 <= d < 1e16:
+  //
+  int point = num_digits + exponent;
+
+  if (point < -3 || point > 16) {
+    buffer[length++] = digits[0];
+
+    if (num_digits > 1) {
+      buffer[length++] = '.';
+      memcpy(buffer + length, digits + 1, num_digits - 1);
+      length += num_digits - 1;
+    }
+
+    length += snprintf(buffer + length, DTOA_BUFFER_SIZE - length, "e%c%02d",
+      (point - 1 < 0) ? '-' : '+', abs(point - 1));
+  }
+  else if (point <= 0) {
+    buffer[length++] = '0';
+    buffer[length++] = '.';
+    for (int i = point; i < 0; i++)
+      buffer[length++] = '0';
+    memcpy(buffer + length, digits, num_digits);
+    length += num_digits;
+  }
+  else if (point >= num_digits) {
+    memcpy(buffer + length, digits, num_digits);
+    length += num_digits;
+    for (int i = num_digits; i < point; i++)
+      buffer[length++] = '0';
+    buffer[length++] = '.';
+    buffer[length++] = '0';
+  }
+  else {
+    memcpy(buffer + length, digits, point);
+    length += point;
+    buffer[length++] = '.';
+    memcpy(buffer + length, digits + point, num_digits - point);
+    length += num_digits - point;
+  }
+
+  buffer[length] = '\0';
+
+  return length;
+}
+
+
+//
+// dtoa_set_format
+//
+// Selects the format of dtoa_format.
+//
+void dtoa_set_format(enum REAL_FORMATS format)
+{
+  real_format = format;
+}
+
+
+//
+// dtoa_format
+//
+// Formats in the selected format.
+//
+int dtoa_format(double d, char* buffer)
+{
+  if (real_format == REAL_FORMAT_REPR)
+    return dtoa_repr(d, buffer);
+  else
+    return dtoa_fixed(d, buffer);
+}
@@ -0,0 +1,76 @@
+/*dtoa.h*/
+
+//
+// Formatting of nuPython reals, without printf. There are two
+// formats:
+//
+//   fixed -- as printf("%lf") does, 6 decimals: 0.100000, 1.500000
+//   repr  -- as Python's repr() does, the fewest digits that read
+//            back as the same double: 0.1, 1.5, 1e+16, 5e-324
+//
+// Fixed is the default, since it's what nuPython has always output.
+//
+// repr uses the Grisu3 algorithm (Loitsch, "Printing Floating-Point
+// Numbers Quickly and Accurately with Integers", PLDI 2010), which
+// finds the shortest digits with 64-bit integer arithmetic for all
+// but about 0.5% of doubles; for those it can tell it isn't sure,
+// and the digits are found with snprintf and strtod instead. fixed
+// is computed exactly with 128-bit integers for magnitudes below
+// 2^107 (about 1.6e32), and with snprintf beyond. Both give exactly
+// what the slow way gives.
+//
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+
+
+//
+// large enough for any double in either format ("%lf" of -DBL_MAX
+// is 318 characters):
+//
+#define DTOA_BUFFER_SIZE  320
+
+enum REAL_FORMATS
+{
+  REAL_FORMAT_FIXED = 0,
+  REAL_FORMAT_REPR
+};
+
+
+//
+// Public functions:
+//
+
+//
+// dtoa_fixed
+//
+// Formats the given double into the given buffer (of at least
+// DTOA_BUFFER_SIZE chars) as printf("%lf") would, and returns the
+// length.
+//
+int dtoa_fixed(double d, char* buffer);
+
+//
+// dtoa_repr
+//
+// Formats the given double into the given buffer (of at least
+// DTOA_BUFFER_SIZE chars) as Python's repr() would, and returns
+// the length.
+//
+int dtoa_repr(double d, char* buffer);
+
+//
+// dtoa_set_format
+//
+// Selects the format that dtoa_format uses, for the whole run.
+//
+void dtoa_set_format(enum REAL_FORMATS format);
+
+//
+// dtoa_format
+//
+// Formats the given double in the selected format, see
+// dtoa_set_format, and returns the length.
+//
+int dtoa_format(double d, char* buffer);
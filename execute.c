@@ -15,66 +15,78 @@
 
 #include "programgraph.h"
 #include "ram.h"
+#include "resolve.h"
+#include "str.h"
+#include "values.h"
+#include "output.h"
+#include "profile.h"
 #include "execute.h"
 
 
 //
 // Private functions:
 //
-bool execute_function_call(struct STMT* stmt, struct RAM* memory);
-static struct RAM_VALUE* execute_binary_expression(struct RAM_VALUE* lhs, int operator, struct RAM_VALUE* rhs, bool* success, struct STMT* stmt);
-static bool execute_assignment(struct STMT* stmt, struct RAM* memory);
+bool execute_function_call(struct STMT* stmt, struct SYMTAB* symbols, struct RAM* memory);
+static bool execute_assignment(struct STMT* stmt, struct SYMTAB* symbols, struct RAM* memory);
+
+
+//
+// var_addr
+//
+// Returns the RAM address of the variable named by the given graph
+// node, or -1 if that variable has not been written yet. The address
+// is cached in the symbol table the first time the variable is
+// written, so no lookup by name is needed here.
+//
+static int var_addr(struct SYMTAB* symbols, void* node)
+{
+  int slot = resolve_slot(symbols, node);
+  assert(slot != -1);
+
+  return symbols->symbols[slot].addr;
+}
 
 
 // retrieve value
-// helper function, takes in an element and return it as a ram_value struct regardless of whether it came in as a string, int, bool, double, 
-// or an identifier of one of these types
+// helper function, takes in an element and stores it as a ram_value in the caller's temp regardless of whether it came in as a string, int, bool, double, 
+// or an identifier of one of these types. returns true if successful, false if not (error message already output)
 
-//if element is int, set the ram_to_return.types.i =  int_val. also set ram_to_return-> value_type to int
-//if element is real_literal, set the ram_to_return.types.d = real_val. ram_to_return->value_type to double
-//if element is string, set the ram_to_return.types.s = string
-//if element is bool, set the ram_to_return.value_type = RAM_TYPE_BOOLEAN and ram_to_return->types.i = 0 or 1 
-//if element is identifier, just set ram_to_return as ram_read_cell_by_name(memory, var_name)
+//if element is a literal (int, real, string or bool), copy the constant resolve_program parsed for it
+//(a string is borrowed from the program graph)
+//if element is identifier, take the value from RAM by its resolved address (a string is shared, not copied)
 
-struct RAM_VALUE* retrieve_value(struct ELEMENT* element, struct STMT* stmt, struct RAM* memory, bool* success) {
-  *success = false;
-  struct RAM_VALUE* ram_to_return = malloc(sizeof(struct RAM_VALUE));
+static bool retrieve_value(struct ELEMENT* element, struct STMT* stmt, struct SYMTAB* symbols, struct RAM* memory, struct TEMP_VALUE* temp) {
+  temp->owns_str = false;
 
   if (element->element_type == ELEMENT_IDENTIFIER) {
     char* var_name = element->element_value;
-    ram_to_return = ram_read_cell_by_name(memory, var_name);
-    *success = true;
-    if (ram_to_return == NULL) {
-      *success = false;
+    const struct RAM_VALUE* stored = ram_peek_cell_by_addr(memory, var_addr(symbols, element));
+    if (stored == NULL) {
       printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", var_name, stmt->line);
+      return false;
     }
+    //
+    // the value from RAM; a string is shared, so that writing it
+    // to another variable doesn't copy it either:
+    //
+    temp->value = *stored;
+    if (stored->value_type == RAM_TYPE_STR) {
+      str_share(temp->value.types.s);
+      temp->owns_str = true;
+    }
+    return true;
   }
-  else if(element->element_type == ELEMENT_INT_LITERAL) {
-    ram_to_return->value_type = RAM_TYPE_INT;
-    ram_to_return->types.i = atoi(element->element_value);
-    *success = true;
-  }
-  else if(element-> element_type == ELEMENT_REAL_LITERAL) {
-    ram_to_return->value_type = RAM_TYPE_REAL;
-    ram_to_return->types.d = atof(element->element_value);
-    *success = true;
-  }
-  else if(element-> element_type == ELEMENT_TRUE) {
-    ram_to_return->value_type = RAM_TYPE_BOOLEAN;
-    ram_to_return->types.i = 1;
-    *success = true;
-  }
-  else if(element-> element_type == ELEMENT_FALSE) {
-    ram_to_return->value_type = RAM_TYPE_BOOLEAN;
-    ram_to_return->types.i = 0;
-    *success = true;
-  }
-  else if(element-> element_type == ELEMENT_STR_LITERAL) {
-    ram_to_return->value_type = RAM_TYPE_STR;
-    ram_to_return->types.s = element->element_value;
-    *success = true;
+  else {
+    //
+    // a literal, parsed once by resolve_program:
+    //
+    const struct RAM_VALUE* constant = resolve_constant(symbols, element);
+    if (constant != NULL) {
+      temp->value = *constant;
+      return true;
+    }
   }
-  return ram_to_return;
+  return false;
 }
 
 
@@ -93,7 +105,7 @@ struct RAM_VALUE* retrieve_value(struct ELEMENT* element, struct STMT* stmt, str
 //           print(x)
 //           print(123)
 //
-bool execute_function_call(struct STMT* stmt, struct RAM* memory)
+bool execute_function_call(struct STMT* stmt, struct SYMTAB* symbols, struct RAM* memory)
 {
   struct STMT_FUNCTION_CALL* call = stmt->types.function_call;
 
@@ -105,433 +117,123 @@ bool execute_function_call(struct STMT* stmt, struct RAM* memory)
 
 
     if (call->parameter == NULL)
-      printf("\n");
+      output_newline();
     else {
-      bool success;
-      struct RAM_VALUE* to_print = retrieve_value(call->parameter, stmt, memory, &success);
+      struct TEMP_VALUE temp;
 
-      if (!success) {
+      if (!retrieve_value(call->parameter, stmt, symbols, memory, &temp)) {
         return false;
       }
 
-      switch (to_print->value_type) {
-        case RAM_TYPE_INT:
-          printf("%d\n", to_print->types.i);
-          break;
-        case RAM_TYPE_REAL:
-          printf("%lf\n", to_print->types.d);
-          break;
-        case RAM_TYPE_STR:
-          printf("%s\n", to_print->types.s);
-          break;
-        case RAM_TYPE_BOOLEAN: 
-          if (to_print->types.i == 0) {
-            printf("False\n");
-          } else if (to_print->types.i == 1){
-            printf("True\n");
-          } else {
-            printf("Neither false nor true?\n");
-            return false;
-          }
-          break;
-        default:
-          printf("Not int, real, string, or boolean\n");
-          return false;
-      }
+      bool success = print_value(&temp.value);
+
+      release_value(&temp);
+      return success;
     }
     return true;
 }
   
-// execute_int_int_binary
-// takes in two ints and an operator, returns RAM_VALUE
-// will return as RAM_TYPE_BOOLEAN for relational operators and RAM_TYPE_INT for other operators
-// returns error for unrecognizable operators
-
-struct RAM_VALUE* execute_int_int_binary(int lhs, int operator, int rhs) {
-    struct RAM_VALUE* result = malloc(sizeof(struct RAM_VALUE));
-    switch (operator)
-  {
-  case OPERATOR_PLUS:
-    result->value_type = RAM_TYPE_INT;
-    result->types.i = lhs + rhs;
-    break;
-
-  case OPERATOR_MINUS:
-    result->value_type = RAM_TYPE_INT;
-    result->types.i = lhs - rhs;
-    break;
-
-  case OPERATOR_ASTERISK:
-    result->value_type = RAM_TYPE_INT;
-    result->types.i = lhs * rhs;
-    break;
-
-  case OPERATOR_POWER:
-    result->value_type = RAM_TYPE_INT;
-    result->types.i = (int)pow(lhs, rhs);
-    break;
-
-  case OPERATOR_MOD:
-    result->value_type = RAM_TYPE_INT;
-    result->types.i = lhs % rhs;
-    break;
-
-  case OPERATOR_DIV:
-    result->value_type = RAM_TYPE_INT;
-    result->types.i = lhs / rhs;
-    break;
-  case OPERATOR_EQUAL:
-    result->value_type = RAM_TYPE_BOOLEAN;
-    if (lhs == rhs) {
-      result->types.i = 1;
-    } else {
-      result->types.i = 0;
-    }
-    break;
-  case OPERATOR_NOT_EQUAL:
-    result->value_type = RAM_TYPE_BOOLEAN;
-    if (lhs != rhs) {
-      result->types.i = 1;
-    } else {
-      result->types.i = 0;
-    }
-    break;
-  case OPERATOR_LT:
-    result->value_type = RAM_TYPE_BOOLEAN;
-    if (lhs < rhs) {
-      result->types.i = 1;
-    } else {
-      result->types.i = 0;
-    }
-    break;
-  case OPERATOR_LTE:
-    result->value_type = RAM_TYPE_BOOLEAN;
-    if (lhs <= rhs) {
-      result->types.i = 1;
-    } else {
-      result->types.i = 0;
-    }
-    break;
-  case OPERATOR_GT:
-    result->value_type = RAM_TYPE_BOOLEAN;
-    if (lhs > rhs) {
-      result->types.i = 1;
-    } else {
-      result->types.i = 0;
-    }
-    break;
-  case OPERATOR_GTE:
-    result->value_type = RAM_TYPE_BOOLEAN;
-    if (lhs >= rhs) {
-      result->types.i = 1;
-    } else {
-      result->types.i = 0;
-    }
-    break;
-  default:
-    //
-    // did we miss something?
-    //
-    printf("**INTERNAL ERROR: unexpected operator (%d) in execute_binary_expr\n", operator);
-    assert(false);
-  }
-  return result;
-}
-
-// execute_real_real_binary
-// takes in two doubles and an operator, returns RAM_VALUE
-// will return as RAM_TYPE_BOOLEAN for relational operators and RAM_TYPE_REAL for other operators
-// returns error for unrecognizable operators
-
-struct RAM_VALUE* execute_real_real_binary(double lhs, int operator, double rhs) {
-    struct RAM_VALUE* result = malloc(sizeof(struct RAM_VALUE));
-    //printf("executing real real: %lf, %lf\n", lhs, rhs); DELETE LATER
-    switch (operator)
-  {
-  case OPERATOR_PLUS:
-    result->value_type = RAM_TYPE_REAL;
-    result->types.d = lhs + rhs;
-    //printf("computed result: %lf\n", result);  DELETE LATER
-    break;
-
-  case OPERATOR_MINUS:
-    result->value_type = RAM_TYPE_REAL;
-    result->types.d = lhs - rhs;
-    break;
-
-  case OPERATOR_ASTERISK:
-    result->value_type = RAM_TYPE_REAL;
-    result->types.d = lhs * rhs;
-    break;
-
-  case OPERATOR_POWER:
-    result->value_type = RAM_TYPE_REAL;
-    result->types.d = pow(lhs, rhs);
-    break;
-
-  case OPERATOR_MOD:
-    result->value_type = RAM_TYPE_REAL;
-    result->types.d = fmod(lhs, rhs);
-    break;
-
-  case OPERATOR_DIV:
-    result->value_type = RAM_TYPE_REAL;
-    result->types.d = lhs / rhs;
-    break;
-
-  case OPERATOR_EQUAL:
-    result->value_type = RAM_TYPE_BOOLEAN;
-    if (lhs == rhs) {
-      result->types.i = 1;
-    } else {
-      result->types.i = 0;
-    }
-    break;
-
-  case OPERATOR_NOT_EQUAL:
-    result->value_type = RAM_TYPE_BOOLEAN;
-    if (lhs != rhs) {
-      result->types.i = 1;
-    } else {
-      result->types.i = 0;
-    }
-    break;
-  case OPERATOR_LT:
-    result->value_type = RAM_TYPE_BOOLEAN;
-    if (lhs < rhs) {
-      result->types.i = 1;
-    } else {
-      result->types.i = 0;
-    }
-    break;
-  case OPERATOR_LTE:
-    result->value_type = RAM_TYPE_BOOLEAN;
-    if (lhs <= rhs) {
-      result->types.i = 1;
-    } else {
-      result->types.i = 0;
-    }
-    break;
-  case OPERATOR_GT:
-    result->value_type = RAM_TYPE_BOOLEAN;
-    if (lhs > rhs) {
-      result->types.i = 1;
-    } else {
-      result->types.i = 0;
-    }
-    break;
-  case OPERATOR_GTE:
-    result->value_type = RAM_TYPE_BOOLEAN;
-    if (lhs >= rhs) {
-      result->types.i = 1;
-    } else {
-      result->types.i = 0;
-    }
-    break;
+//
+// evaluate_expr
+//
+// Evaluates the given expression --- a single element, or a
+// binary expression such as x + y --- storing the result in the
+// caller's temp. Returns true if successful, false if not (an
+// error message was already output). The operands are released
+// before returning; the caller must release the result.
+//
+static bool evaluate_expr(struct EXPR* expr, struct STMT* stmt, struct SYMTAB* symbols, struct RAM* memory, struct TEMP_VALUE* result)
+{
+  //
+  // we always have a LHS:
+  //
+  assert(expr->lhs != NULL);
 
-  default:
-    //
-    // did we miss something?
-    //
-    printf("**INTERNAL ERROR: unexpected operator (%d) in execute_binary_expr\n", operator);
-    assert(false);
+  //
+  // do we have a binary expression?
+  //
+  if (!expr->isBinaryExpr) {  // no
+    return retrieve_value(expr->lhs->element, stmt, symbols, memory, result);
   }
-  return result;
-}
-
 
-// execute_str_str_binary
-// takes in two strings and an operator, returns RAM_VALUE of type RAM_TYPE_BOOLEAN
-// value will be true if the binary expression using a relational operator and 2 strings is true, false if not
-// returns error for unrecognizable operators
+  //
+  // binary expression such as x + y
+  //
+  assert(expr->operator != OPERATOR_NO_OP);  // we must have an operator
 
-struct RAM_VALUE* execute_str_str_binary (char* s1, int operator, char* s2){
-  struct RAM_VALUE* result = malloc(sizeof(struct RAM_VALUE));
-  result->value_type = RAM_TYPE_BOOLEAN;
+  struct TEMP_VALUE lhs_value;
+  struct TEMP_VALUE rhs_value;
 
-  switch(operator) {
-    case OPERATOR_EQUAL:
-      if (strcmp(s1,s2) == 0) {
-        result->types.i = 1;
-      } else {
-        result->types.i = 0;
-      }
-      break;
-    case OPERATOR_NOT_EQUAL:
-      if (strcmp(s1,s2) != 0) {
-        result->types.i = 1;
-      } else {
-        result->types.i = 0;
-      }
-      break;
-    case OPERATOR_LT:
-      if (strcmp(s1,s2) < 0) {
-        result->types.i = 1;
-      } else {
-        result->types.i = 0;
-      }
-      break;
-    case OPERATOR_LTE:
-      if (strcmp(s1,s2) <= 0) {
-        result->types.i = 1;
-      } else {
-        result->types.i = 0;
-      }
-      break;
-    case OPERATOR_GT:
-      if (strcmp(s1,s2) > 0) {
-        result->types.i = 1;
-      } else {
-        result->types.i = 0;
-      }
-      break;
-    case OPERATOR_GTE:
-      if (strcmp(s1,s2) >= 0) {
-        result->types.i = 1;
-      } else {
-        result->types.i = 0;
-      }
-      break;
+  if (!retrieve_value(expr->lhs->element, stmt, symbols, memory, &lhs_value))
+    return false;
 
-    default:
-      printf("**INTERNAL ERROR: unexpected operator (%d) in execute_binary_expr with 2 strings\n", operator);
-      assert(false);
+  if (!retrieve_value(expr->rhs->element, stmt, symbols, memory, &rhs_value)) {
+    release_value(&lhs_value);
+    return false;
   }
-  return result;
-
-}
 
-//is rel_op
-// is rel_op takes operator and returns boolean: true if it is a relational operator, false otherwise
-bool is_rel_op (int operator) {
-  switch (operator) {
-    case OPERATOR_EQUAL:
-      return true;
-      break;
-    case OPERATOR_NOT_EQUAL:
-      return true;
-      break;
-    case OPERATOR_LT:
-      return true;
-      break;
-    case OPERATOR_LTE:
-      return true;
-      break;
-    case OPERATOR_GT:
-      return true;
-      break;
-    case OPERATOR_GTE:
-      return true;
-      break;
-    default:
-      return false; 
-  }
-}
+  //
+  // perform the operation:
+  //
+  bool success = execute_binary_expression(&lhs_value.value, expr->operator, &rhs_value.value, result, stmt->line);
 
+  release_value(&lhs_value);
+  release_value(&rhs_value);
 
+  return success;
+}
 
 //
-// execute_binary_expression
+// execute_append
 //
-// Given two values (both RAM_VALUE) and an operator (int value), performs the operation
-// if working with one real and one int, convert the int to real so both are real
-// run helper functions str_str, int_int_ and real_real for the different scenarios
-// returns the result as a struct RAM_VALUE*
+// If the given assignment is x = x + y, where x and y are
+// strings, appends y to x in memory (in place, see
+// ram_append_str_by_addr), stores in *success whether that
+// worked, and returns true. Returns false, having done nothing,
+// for any other assignment, which is executed the usual way.
 //
-
-struct RAM_VALUE* execute_binary_expression(struct RAM_VALUE* lhs, int operator, struct RAM_VALUE* rhs, bool* success, struct STMT* stmt)
+static bool execute_append(struct STMT* stmt, struct SYMTAB* symbols, struct RAM* memory, bool* success)
 {
-  assert(operator != OPERATOR_NO_OP);
-  struct RAM_VALUE* result = malloc(sizeof(struct RAM_VALUE));
-  
-  if (lhs->value_type == RAM_TYPE_INT && rhs->value_type == RAM_TYPE_INT) {
-    if (rhs->types.i == 0 && operator == OPERATOR_DIV) {
-      printf("ZeroDivisionError: division by zero\n");
-      *success = false;
-    } else {
-      result = execute_int_int_binary(lhs->types.i, operator, rhs->types.i);
-      *success = true;
-    }
-  }
-
-  else if ((lhs->value_type == RAM_TYPE_REAL && rhs->value_type == RAM_TYPE_REAL) || (lhs->value_type == RAM_TYPE_REAL && rhs->value_type == RAM_TYPE_INT) || (lhs->value_type == RAM_TYPE_INT && rhs->value_type == RAM_TYPE_REAL)) {
-    double new_left;
-    double new_right;
-    if (lhs->value_type == RAM_TYPE_INT) {
-      new_left = (double)lhs->types.i;
-    } else {
-      new_left = lhs->types.d;
-    }
-    if (rhs->value_type == RAM_TYPE_INT) {
-      new_right = (double)rhs->types.i;
-    } else {
-      new_right = rhs->types.d;
-    }
-    if (new_right == 0.0 && operator == OPERATOR_DIV) {
-      printf("ZeroDivisionError: division by zero\n");
-      *success = false;
-    } else {
-      result = execute_real_real_binary(new_left, operator, new_right);
-      *success = true;
-    }
-    //float ex_gets = execute_real_real_binary(new_left, operator, new_right); //DELETE LATER
-    //printf("ex gets: %lf\n", ex_gets);  DELETE LATER
-  }
+  struct STMT_ASSIGNMENT* assign = stmt->types.assignment;
 
-  else if (lhs->value_type == RAM_TYPE_STR && rhs->value_type == RAM_TYPE_STR && operator == OPERATOR_PLUS) {
-    result->value_type = RAM_TYPE_STR;
-    size_t len = strlen(lhs->types.s) + strlen(rhs->types.s) + 1;
-    result->types.s = malloc(len);
-    strcpy(result->types.s,lhs->types.s);
-    strcat(result->types.s,rhs->types.s);
-    *success = true;
-  }
+  if (assign->isPtrDeref || assign->rhs->value_type != VALUE_EXPR)
+    return false;
 
-  else if (lhs->value_type == RAM_TYPE_STR && rhs->value_type == RAM_TYPE_STR && is_rel_op(operator)) {
-    result = execute_str_str_binary(lhs->types.s, operator, rhs->types.s);
-    *success = true;
-  }
+  struct EXPR* expr = assign->rhs->types.expr;
 
-  else {
-    *success = false;
-    printf("**SEMANTIC ERROR: invalid operand types (line %d)\n", stmt->line);
-    return result;
-  }
+  if (!expr->isBinaryExpr || expr->operator != OPERATOR_PLUS ||
+      expr->lhs->element->element_type != ELEMENT_IDENTIFIER)
+    return false;
 
-  
+  int slot = resolve_slot(symbols, stmt);
+  int addr = symbols->symbols[slot].addr;
 
-  
+  if (addr == -1 || resolve_slot(symbols, expr->lhs->element) != slot)
+    return false;
 
-  //
-  // perform the operation:
-  //
+  const struct RAM_VALUE* stored = ram_peek_cell_by_addr(memory, addr);
 
+  if (stored->value_type != RAM_TYPE_STR)
+    return false;
 
-  return result;
-}
+  struct TEMP_VALUE rhs_value;
 
-//is_zero
-//takes in a string and returns true if the value is equal to 0 (comprised completely of 0s and up to one decimal point)
-//returns false if not
+  if (!retrieve_value(expr->rhs->element, stmt, symbols, memory, &rhs_value)) {
+    *success = false;  // message already output
+    return true;
+  }
 
-bool is_zero(char* input_num) {
-  int num_dec = 0;
-  for (int i = 0; i<strlen(input_num); i++) {
-    if (input_num[i] != '0' && input_num[i] != '.'){
-      return false;
-    }
-    if (input_num[i] == '.') {
-      num_dec++;
-    }
-    if (num_dec > 1) {
-      printf("More than one decimal point");
-      return false;
-    }
+  if (rhs_value.value.value_type != RAM_TYPE_STR) {
+    release_value(&rhs_value);
+    return false;  // x + 1 and such report their errors as usual
   }
+
+  *success = ram_append_str_by_addr(memory, rhs_value.value.types.s, addr);
+
+  release_value(&rhs_value);
   return true;
 }
 
-
 //
 // execute_assignment
 //
@@ -544,93 +246,67 @@ bool is_zero(char* input_num) {
 //           y = x ** 2
 //
 
-static bool execute_assignment(struct STMT* stmt, struct RAM* memory)
+static bool execute_assignment(struct STMT* stmt, struct SYMTAB* symbols, struct RAM* memory)
 {
   struct STMT_ASSIGNMENT* assign = stmt->types.assignment;
-  struct RAM_VALUE* result = malloc(sizeof(struct RAM_VALUE));
+  struct TEMP_VALUE result;
+  struct INPUT_LINE line;  // input() buffer, result may borrow it
   bool success;
 
   char* var_name = assign->var_name;
 
+  result.owns_str = false;
+  input_line_init(&line);
+
   //
   // no pointers yet:
   //
   assert(assign->isPtrDeref == false);
 
+  //
+  // x = x + y with strings appends to x, without copying it:
+  //
+  if (execute_append(stmt, symbols, memory, &success))
+    return success;
+
   //
   // we only have expressions on the RHS, no function calls:
   //
   if (assign->rhs->value_type == VALUE_EXPR) {
-    struct EXPR* expr = assign->rhs->types.expr;
-
-    //
-    // we always have a LHS:
-    //
-    assert(expr->lhs != NULL);
-
-
-    struct RAM_VALUE* lhs_value = retrieve_value(expr->lhs->element, stmt, memory, &success);
-
-    if (!success)  // semantic error? If so, return now:
-      return false;
-
-    //
-    // do we have a binary expression?
-    //
-    if (!expr->isBinaryExpr) {  // no
-      result = lhs_value;
-    }
-    else {
-      //
-      // binary expression such as x + y
-      //
-      assert(expr->operator != OPERATOR_NO_OP);  // we must have an operator
-
-      struct RAM_VALUE* rhs_value = retrieve_value(expr->rhs->element, stmt, memory, &success);
-
-      if (!success)  // semantic error? If so, return now:
-        return false;
-
-      //
-      // perform the operation:
-      //
-      bool bin_success;
-      result = execute_binary_expression(lhs_value, expr->operator, rhs_value, &bin_success, stmt);
-
-      if (!bin_success)
-        return false;
-    }
-    
+    if (!evaluate_expr(assign->rhs->types.expr, stmt, symbols, memory, &result))
+      return false;  // semantic error, message already output
   }
 
   else if (assign->rhs->value_type == VALUE_FUNCTION_CALL) {
     char* func_name = assign->rhs->types.function_call->function_name;
-    char* param = assign->rhs->types.function_call->parameter->element_value;
+    struct ELEMENT* param_element = assign->rhs->types.function_call->parameter;
+    char* param = param_element->element_value;
 
     if (strcmp(func_name,"input") == 0) {
-      printf("%s", param);
-      char line[256];
-      fgets(line, sizeof(line), stdin);
-
-      //delete EOL chars from input:
-      line[strcspn(line, "\r\n")] = '\0';
+      output_str(param);
+      output_flush();  // the prompt, before waiting for input
 
-      result->value_type = RAM_TYPE_STR;
-      result->types.s = line;
+      result.value.value_type = RAM_TYPE_STR;
+      result.value.types.s = read_input_line(&line, stdin);
     } else if (strcmp(func_name, "int") == 0) {
-      result->value_type = RAM_TYPE_INT;
-      struct RAM_VALUE* var_value = ram_read_cell_by_name(memory, param);
-      result->types.i = atoi(var_value->types.s); //didn't check if this works
-      //if result->types.i == 0, check if the string is equal to 0, if not, return false
-      if (result->types.i == 0 && !(is_zero(var_value->types.s))) {
+      struct TEMP_VALUE var_value;
+      if (!retrieve_value(param_element, stmt, symbols, memory, &var_value))
+        return false;
+      bool valid = (var_value.value.value_type == RAM_TYPE_STR &&
+                    execute_int_conversion(var_value.value.types.s, &result.value));
+      release_value(&var_value);
+      if (!valid) {
         printf("**SEMANTIC ERROR: invalid string for int() (line %d)\n", stmt->line);
         return false;
       }
     } else if (strcmp(func_name, "float") == 0) {
-      result->value_type = RAM_TYPE_REAL;
-      struct RAM_VALUE* var_value = ram_read_cell_by_name(memory, param);
-      result->types.d = atof(var_value->types.s); //didn't check if this works
-      if (result->types.d == 0.0 && !(is_zero(var_value->types.s))) {
+      struct TEMP_VALUE var_value;
+      if (!retrieve_value(param_element, stmt, symbols, memory, &var_value))
+        return false;
+      bool valid = (var_value.value.value_type == RAM_TYPE_STR &&
+                    execute_real_conversion(var_value.value.types.s, &result.value));
+      release_value(&var_value);
+      if (!valid) {
         printf("**SEMANTIC ERROR: invalid string for float() (line %d)\n", stmt->line);
         return false;
       }
@@ -643,18 +319,94 @@ static bool execute_assignment(struct STMT* stmt, struct RAM* memory)
   
 
   //
-  // write result to memory:
+  // write result to memory: a string the result owns is handed
+  // to memory, a borrowed one is copied by RAM:
   //
-  struct RAM_VALUE ram_value;
+  struct SYMBOL* symbol = &symbols->symbols[resolve_slot(symbols, stmt)];
+
+  if (symbol->addr != -1) {
+    if (result.owns_str)
+      success = ram_move_cell_by_addr(memory, result.value, symbol->addr);
+    else
+      success = ram_write_cell_by_addr(memory, result.value, symbol->addr);
+  }
+  else {
+    //
+    // first write, the variable gets its address now and
+    // keeps it from here on:
+    //
+    if (result.owns_str)
+      success = ram_move_cell_by_name(memory, result.value, var_name);
+    else
+      success = ram_write_cell_by_name(memory, result.value, var_name);
+    symbol->addr = ram_get_addr(memory, var_name);
+  }
 
-  ram_value = *result;
+  if (success)
+    result.owns_str = false;  // memory has it now
 
-  success = ram_write_cell_by_name(memory, ram_value, var_name);
+  release_value(&result);
+  input_line_destroy(&line);
 
   return success;
 }
 
 
+//
+// execute_stmt
+//
+// Executes the given statement, storing the statement to execute
+// next in *next (NULL at the end of the program). Returns true if
+// successful and false if not (an error message will be output
+// before false is returned). Shared by execute and
+// execute_profiled, so the two run programs the same way.
+//
+static inline bool execute_stmt(struct STMT* stmt, struct SYMTAB* symbols, struct RAM* memory, struct STMT** next)
+{
+  if (stmt->stmt_type == STMT_ASSIGNMENT) {
+
+    if (!execute_assignment(stmt, symbols, memory))
+      return false;
+
+    *next = stmt->types.assignment->next_stmt;  // advance
+  }
+  else if (stmt->stmt_type == STMT_FUNCTION_CALL) {
+
+    if (!execute_function_call(stmt, symbols, memory))
+      return false;
+
+    *next = stmt->types.function_call->next_stmt;
+  }
+  else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+    struct EXPR* expr = stmt->types.while_loop->condition;
+    struct TEMP_VALUE result;
+
+    if (!evaluate_expr(expr, stmt, symbols, memory, &result))
+      return false;
+
+    bool condition = (result.value.types.i == 1);
+    release_value(&result);
+
+    if (condition) {
+      *next = stmt->types.while_loop->loop_body;
+    } else {
+      *next = stmt->types.while_loop->next_stmt;
+    }
+  }
+  else {
+    assert(stmt->stmt_type == STMT_PASS);
+
+    //
+    // nothing to do!
+    //
+
+    *next = stmt->types.pass->next_stmt;
+  }
+
+  return true;
+}
+
+
 //
 // Public functions:
 //
@@ -662,80 +414,103 @@ static bool execute_assignment(struct STMT* stmt, struct RAM* memory)
 //
 // execute
 //
-// Given a nuPython program graph and a memory, 
-// executes the statements in the program graph
-// If a semantic error occurs (e.g. type error),
+// Given a nuPython program graph, its symbol table
+// and a memory, executes the statements in the program
+// graph. If a semantic error occurs (e.g. type error),
 // an error message is output, execution stops,
-// and the function returns
+// and the function returns. Returns the number of
+// statements executed.
 //
-void execute(struct STMT* program, struct RAM* memory)
+long execute(struct STMT* program, struct SYMTAB* symbols, struct RAM* memory)
 {
   struct STMT* stmt = program;
+  long executed = 0;  // statements
 
   //
   // traverse through the program statements:
   //
   while (stmt != NULL) {
+    struct STMT* next;
 
-    if (stmt->stmt_type == STMT_ASSIGNMENT) {
+    if (!execute_stmt(stmt, symbols, memory, &next))
+      return executed;
 
-      bool success = execute_assignment(stmt, memory);
+    if (stmt->stmt_type != STMT_PASS)
+      executed++;
 
-      if (!success)
-        return;
+    stmt = next;
+  }//while
 
-      stmt = stmt->types.assignment->next_stmt;  // advance
-    }
-    else if (stmt->stmt_type == STMT_FUNCTION_CALL) {
+  //
+  // done:
+  //
+  return executed;
+}
 
 
-      if (!execute_function_call(stmt, memory)) {
-        return;
-      }
+//
+// execute_profiled
+//
+// Same as execute, and charges each statement executed, and the
+// ticks it took, to its line in the given profile. The counter is
+// read once per statement: the ticks from one statement's start to
+// the next's are the first statement's (so a while loop's line is
+// charged for its condition, not its body).
+//
+long execute_profiled(struct STMT* program, struct SYMTAB* symbols, struct RAM* memory, struct PROFILE* profile)
+{
+  struct STMT* stmt = program;
+  long executed = 0;  // statements
+  long long started = profile_ticks();
 
-      stmt = stmt->types.function_call->next_stmt;
-    } 
-    else if (stmt->stmt_type == STMT_WHILE_LOOP) {
-      struct EXPR* expr = stmt->types.while_loop->condition;
-      struct RAM_VALUE* result = malloc(sizeof(struct RAM_VALUE));
-      bool success;
-
-      struct RAM_VALUE* lhs_value = retrieve_value(expr->lhs->element, stmt, memory, &success);
-      if (!success)
-        return;
-
-      if (expr->isBinaryExpr) {  
-        struct RAM_VALUE* rhs_value = retrieve_value(expr->rhs->element, stmt, memory, &success);
-        if (!success)
-          return;
-        result = execute_binary_expression(lhs_value, expr->operator, rhs_value, &success, stmt);
-        if (!success)
-          return;
-      }
-      else {
-        result = lhs_value;
-      }
+  while (stmt != NULL) {
+    struct STMT* next;
 
-      if (result->types.i == 1) {
-        stmt = stmt->types.while_loop->loop_body;
-      } else {
-        stmt = stmt->types.while_loop->next_stmt;
-      }
+    if (!execute_stmt(stmt, symbols, memory, &next))
+      return executed;
 
-    }
-    else {
-      assert(stmt->stmt_type == STMT_PASS);
+    long long now = profile_ticks();
 
-      //
-      // nothing to do!
-      //
+    profile_add(profile, stmt->line, now - started);
+    started = now;
 
-      stmt = stmt->types.pass->next_stmt;
-    }
+    if (stmt->stmt_type != STMT_PASS)
+      executed++;
+
+    stmt = next;
   }//while
 
-  //
-  // done:
-  //
-  return;
+  return executed;
+}
+
+
+//
+// execute_sampled
+//
+// Same as execute, and publishes the line of each statement in
+// *line before executing it, for a sampling profiler to read from
+// a signal handler (see sampler.h); 0 once done.
+//
+long execute_sampled(struct STMT* program, struct SYMTAB* symbols, struct RAM* memory, volatile sig_atomic_t* line)
+{
+  struct STMT* stmt = program;
+  long executed = 0;  // statements
+
+  while (stmt != NULL) {
+    struct STMT* next;
+
+    *line = stmt->line;
+
+    if (!execute_stmt(stmt, symbols, memory, &next))
+      break;
+
+    if (stmt->stmt_type != STMT_PASS)
+      executed++;
+
+    stmt = next;
+  }//while
+
+  *line = 0;
+
+  return executed;
 }
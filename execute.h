@@ -6,8 +6,12 @@
 
 #pragma once
 
+#include <signal.h>  // sig_atomic_t
+
 #include "programgraph.h"
 #include "ram.h"
+#include "resolve.h"
+#include "profile.h"
 
 //
 // Public functions:
@@ -16,10 +20,35 @@
 //
 // execute
 //
-// Given a nuPython program graph and a memory, 
-// executes the statements in the program graph.
+// Given a nuPython program graph, its symbol table
+// (see resolve_program) and a memory, executes the
+// statements in the program graph. Variables are
+// read and written by address.
 // If a semantic error occurs (e.g. type error),
 // and error message is output, execution stops,
 // and the function returns.
 //
-void execute(struct STMT* program, struct RAM* memory);
+// Returns the number of statements executed, not
+// counting one that failed; a while loop counts once
+// each time its condition is evaluated.
+//
+long execute(struct STMT* program, struct SYMTAB* symbols, struct RAM* memory);
+
+//
+// execute_profiled
+//
+// Same as execute, and also records in the given profile
+// how many statements were executed on each line, and
+// how long they took (see profile.h). A separate function
+// so execute doesn't pay for the profiling.
+//
+long execute_profiled(struct STMT* program, struct SYMTAB* symbols, struct RAM* memory, struct PROFILE* profile);
+
+//
+// execute_sampled
+//
+// Same as execute, and also stores the line of each
+// statement in *line before executing it, so a sampling
+// profiler can tell where the program is (see sampler.h).
+//
+long execute_sampled(struct STMT* program, struct SYMTAB* symbols, struct RAM* memory, volatile sig_atomic_t* line);
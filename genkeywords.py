@@ -0,0 +1,127 @@
+#
+# genkeywords.py
+#
+# Generates keywords.h, the keyword table of the memory-mapped
+# scanner (mapscanner.c), from the keyword tokens in token.h:
+#
+#   python3 genkeywords.py > keywords.h
+#
+# The table is a minimal perfect hash: each of the N keywords has
+# its own slot in a table of N, at
+#
+#   (length + asso[first char] + asso[last char]) % N
+#
+# so an identifier is told apart from the keywords with one hash
+# and one memcmp. The asso values are found by backtracking.
+#
+
+import re
+import sys
+
+
+def read_keywords(filename):
+  #
+  # the keyword tokens look like:  nuPy_KEYW_AND,      // and
+  #
+  keywords = []
+  with open(filename) as f:
+    for line in f:
+      m = re.match(r'\s*(nuPy_KEYW_\w+),?\s*//\s*(\S+)', line)
+      if m:
+        keywords.append((m.group(1), m.group(2)))
+  return keywords
+
+
+def find_asso(words):
+  n = len(words)
+  keys = [(len(w), w[0], w[-1]) for w in words]
+
+  #
+  # assign the characters that complete the most keys first:
+  #
+  chars = []
+  for length, first, last in keys:
+    for c in (first, last):
+      if c not in chars:
+        chars.append(c)
+  chars.sort(key=lambda c: -sum(1 for k in keys if c in (k[1], k[2])))
+
+  asso = {}
+
+  def consistent():
+    used = set()
+    for length, first, last in keys:
+      if first in asso and last in asso:
+        h = (length + asso[first] + asso[last]) % n
+        if h in used:
+          return False
+        used.add(h)
+    return True
+
+  def assign(i):
+    if i == len(chars):
+      return True
+    for value in range(n):
+      asso[chars[i]] = value
+      if consistent() and assign(i + 1):
+        return True
+    del asso[chars[i]]
+    return False
+
+  if not assign(0):
+    sys.exit("genkeywords.py: no minimal perfect hash found")
+
+  return asso
+
+
+def main():
+  keywords = read_keywords("token.h")
+  words = [word for token, word in keywords]
+  n = len(words)
+  asso = find_asso(words)
+
+  table = [None] * n
+  for token, word in keywords:
+    table[(len(word) + asso[word[0]] + asso[word[-1]]) % n] = (token, word)
+
+  print("/*keywords.h*/")
+  print("")
+  print("//")
+  print("// Keyword table of the memory-mapped scanner, a minimal perfect")
+  print("// hash on the length and the first and last characters.")
+  print("//")
+  print("// GENERATED by genkeywords.py from token.h, do not edit:")
+  print("//")
+  print("//   python3 genkeywords.py > keywords.h")
+  print("//")
+  print("")
+  print("#pragma once")
+  print("")
+  print("#include \"token.h\"")
+  print("")
+  print("")
+  print("#define NUM_KEYWORDS        %d" % n)
+  print("#define MIN_KEYWORD_LENGTH  %d" % min(len(w) for w in words))
+  print("#define MAX_KEYWORD_LENGTH  %d" % max(len(w) for w in words))
+  print("")
+  print("#define KEYWORD_HASH(text, length) \\")
+  print("  (((length) + keyword_asso[(unsigned char)(text)[0]] + \\")
+  print("    keyword_asso[(unsigned char)(text)[(length) - 1]]) % NUM_KEYWORDS)")
+  print("")
+  print("static const unsigned char keyword_asso[256] = {")
+  for c in sorted(asso):
+    print("  ['%s'] = %d," % (c, asso[c]))
+  print("};")
+  print("")
+  print("static const struct")
+  print("{")
+  print("  const char* text;")
+  print("  int length;")
+  print("  int id;")
+  print("} keyword_table[NUM_KEYWORDS] = {")
+  for token, word in table:
+    print("  { %-11s %d, %-19s }," % ('"%s",' % word, len(word), token))
+  print("};")
+
+
+main()
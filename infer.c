@@ -0,0 +1,645 @@
+/*infer.c*/
+
+//
+// Static type inference for nuPython, see infer.h.
+//
+// The analysis tracks one type per variable slot: a RAM_TYPE_...
+// if the variable is guaranteed to hold a value of that type at
+// this point of the program, or TYPE_UNKNOWN if it might hold
+// something else or might not be defined at all. Statements are
+// analyzed in order; a statement that fails at runtime stops the
+// program, so after a statement we may assume it succeeded. At a
+// while loop, the types at the loop header are those before the
+// loop joined with those at the end of the body, iterated until
+// nothing changes (a type can only go to TYPE_UNKNOWN, so this
+// takes at most one extra pass per variable).
+//
+// There is a single state[] for the whole program. Inside a loop,
+// each change to it is recorded in an undo log, so that after a
+// pass over the body the slots it changed are known and the header
+// types can be restored; a loop costs time in proportion to its
+// body, not to the number of variables in the program.
+//
+// Bytecode is analyzed the same way, one instruction at a time,
+// with the type of the accumulator tracked alongside state[]; the
+// while loops are found from their jumps.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+#include <assert.h>
+
+#include "programgraph.h"
+#include "ram.h"
+#include "resolve.h"
+#include "values.h"
+#include "nodemap.h"
+#include "bytecode.h"
+#include "infer.h"
+
+#define TYPE_UNKNOWN  -1
+
+
+//
+// A change to state[]: the slot, and its type before the change.
+//
+struct UNDO_ENTRY
+{
+  int slot;
+  int type;
+};
+
+//
+// The undo log, with the buffers the loop joins work in; one of
+// each for the whole analysis, whatever the number of loops.
+//
+struct UNDO_LOG
+{
+  struct UNDO_ENTRY* entries;
+  int length;
+  int capacity;
+  int depth;          // loops around the statement being analyzed
+
+  struct UNDO_ENTRY* changed;  // slots a pass changed, with their types at the end of the body
+  int changed_capacity;
+
+  int* stamps;        // stamps[slot] == stamp => slot is in changed
+  int  stamp;
+};
+
+
+//
+// Private functions:
+//
+
+//
+// specialize
+//
+// Returns the specialized operator for lhs_type <operator> rhs_type,
+// SPEC_GENERIC if there is none.
+//
+static int specialize(int lhs_type, int operator, int rhs_type)
+{
+#define SPECIALIZE(type, name, op_enum, op, result_type) \
+  if (operator == op_enum && lhs_type == type##_OPERAND_TYPE && rhs_type == type##_OPERAND_TYPE) \
+    return SPEC_##type##_##name;
+
+  SPECIALIZED_BINARIES(SPECIALIZE)
+
+#undef SPECIALIZE
+
+  return SPEC_GENERIC;
+}
+
+//
+// binary_type
+//
+// Returns the type of the result of lhs_type <operator> rhs_type,
+// following execute_binary_expression, or TYPE_UNKNOWN if it
+// can't be known (or the operation fails).
+//
+static int binary_type(int lhs_type, int operator, int rhs_type)
+{
+  bool lhs_numeric = (lhs_type == RAM_TYPE_INT || lhs_type == RAM_TYPE_REAL);
+  bool rhs_numeric = (rhs_type == RAM_TYPE_INT || rhs_type == RAM_TYPE_REAL);
+
+  if (lhs_numeric && rhs_numeric) {
+    if (is_rel_op(operator))
+      return RAM_TYPE_BOOLEAN;
+    if (operator > OPERATOR_DIV)  // is, in
+      return TYPE_UNKNOWN;
+    if (lhs_type == RAM_TYPE_INT && rhs_type == RAM_TYPE_INT)
+      return RAM_TYPE_INT;
+    return RAM_TYPE_REAL;
+  }
+
+  if (lhs_type == RAM_TYPE_STR && rhs_type == RAM_TYPE_STR) {
+    if (is_rel_op(operator))
+      return RAM_TYPE_BOOLEAN;
+    if (operator == OPERATOR_PLUS)
+      return RAM_TYPE_STR;
+  }
+
+  return TYPE_UNKNOWN;
+}
+
+//
+// element_type
+//
+// Returns the type of the given element: the type of its constant
+// if it is a literal, the type the variable has in state[] if it is
+// an identifier.
+//
+static int element_type(struct SYMTAB* symbols, struct ELEMENT* element, int* state)
+{
+  if (element == NULL)
+    return TYPE_UNKNOWN;
+
+  if (element->element_type == ELEMENT_IDENTIFIER)
+    return state[resolve_slot(symbols, element)];
+
+  const struct RAM_VALUE* constant = resolve_constant(symbols, element);
+
+  if (constant == NULL)
+    return TYPE_UNKNOWN;  // None
+
+  return constant->value_type;
+}
+
+//
+// infer_expr
+//
+// Returns the type of the given expression, and (re)annotates it
+// with its specialized operator if it is a binary expression.
+//
+static int infer_expr(struct TYPEINFO* types, struct SYMTAB* symbols, struct EXPR* expr, int* state)
+{
+  int lhs_type = element_type(symbols, expr->lhs->element, state);
+
+  if (!expr->isBinaryExpr)
+    return lhs_type;
+
+  int rhs_type = element_type(symbols, expr->rhs->element, state);
+
+  if (lhs_type == TYPE_UNKNOWN || rhs_type == TYPE_UNKNOWN) {
+    nodemap_put(types->ops, expr, SPEC_GENERIC);
+    return TYPE_UNKNOWN;
+  }
+
+  nodemap_put(types->ops, expr, specialize(lhs_type, expr->operator, rhs_type));
+
+  return binary_type(lhs_type, expr->operator, rhs_type);
+}
+
+//
+// function_type
+//
+// Returns the type of input(), int() or float() on the rhs of an
+// assignment.
+//
+static int function_type(struct FUNCTION_CALL* call)
+{
+  if (strcmp(call->function_name, "input") == 0)
+    return RAM_TYPE_STR;
+  else if (strcmp(call->function_name, "int") == 0)
+    return RAM_TYPE_INT;
+  else if (strcmp(call->function_name, "float") == 0)
+    return RAM_TYPE_REAL;
+  else
+    return TYPE_UNKNOWN;
+}
+
+//
+// init_log
+//
+// Sets up an empty undo log, and a state[] in which none of the
+// given number of slots is defined, as when the program starts.
+// Returns state[].
+//
+static int* init_log(struct UNDO_LOG* log, int num_slots)
+{
+  int* state = (int*)malloc((num_slots + 1) * sizeof(int));
+
+  log->entries = NULL;
+  log->length = 0;
+  log->capacity = 0;
+  log->depth = 0;
+  log->changed = NULL;
+  log->changed_capacity = 0;
+  log->stamps = (int*)malloc((num_slots + 1) * sizeof(int));
+  log->stamp = 0;
+
+  for (int i = 0; i < num_slots; i++) {
+    state[i] = TYPE_UNKNOWN;
+    log->stamps[i] = 0;
+  }
+
+  return state;
+}
+
+//
+// free_log
+//
+// Frees the undo log and state[].
+//
+static void free_log(struct UNDO_LOG* log, int* state)
+{
+  free(state);
+  free(log->entries);
+  free(log->changed);
+  free(log->stamps);
+}
+
+//
+// set_type
+//
+// Sets the type of the given slot in state[], logging the change
+// if inside a loop.
+//
+static void set_type(struct UNDO_LOG* log, int* state, int slot, int type)
+{
+  if (state[slot] == type)
+    return;
+
+  if (log->depth > 0) {
+    if (log->length == log->capacity) {
+      log->capacity = (log->capacity == 0) ? 64 : 2 * log->capacity;
+      log->entries = (struct UNDO_ENTRY*)realloc(log->entries, log->capacity * sizeof(struct UNDO_ENTRY));
+    }
+
+    log->entries[log->length].slot = slot;
+    log->entries[log->length].type = state[slot];
+    log->length++;
+  }
+
+  state[slot] = type;
+}
+
+//
+// undo_pass
+//
+// Given the start of the log entries made by a pass over a loop
+// body, collects the slots that pass changed, with their types at
+// the end of the body, into log->changed, and restores state[] to
+// the types at the loop header. Returns the number of slots.
+//
+static int undo_pass(struct UNDO_LOG* log, int* state, int mark)
+{
+  int num_changed = 0;
+
+  log->stamp++;
+
+  for (int i = mark; i < log->length; i++) {
+    int slot = log->entries[i].slot;
+
+    if (log->stamps[slot] == log->stamp)
+      continue;
+    log->stamps[slot] = log->stamp;
+
+    if (num_changed == log->changed_capacity) {
+      log->changed_capacity = (log->changed_capacity == 0) ? 64 : 2 * log->changed_capacity;
+      log->changed = (struct UNDO_ENTRY*)realloc(log->changed, log->changed_capacity * sizeof(struct UNDO_ENTRY));
+    }
+
+    log->changed[num_changed].slot = slot;
+    log->changed[num_changed].type = state[slot];
+    num_changed++;
+  }
+
+  for (int i = log->length - 1; i >= mark; i--) {
+    state[log->entries[i].slot] = log->entries[i].type;
+  }
+  log->length = mark;
+
+  return num_changed;
+}
+
+//
+// join_pass
+//
+// Ends a pass over a loop body whose log entries start at mark:
+// restores state[] to the types at the loop header, and joins into
+// them the types at the end of the body. Returns true if a header
+// type changed, so another pass is needed.
+//
+static bool join_pass(struct UNDO_LOG* log, int* state, int mark)
+{
+  int num_changed = undo_pass(log, state, mark);
+
+  bool changed = false;
+  for (int i = 0; i < num_changed; i++) {
+    int slot = log->changed[i].slot;
+
+    if (log->changed[i].type != state[slot] && state[slot] != TYPE_UNKNOWN) {
+      set_type(log, state, slot, TYPE_UNKNOWN);  // logged for an enclosing loop
+      changed = true;
+    }
+  }
+
+  return changed;
+}
+
+//
+// infer_stmts
+//
+// Analyzes the chain of statements starting at stmt, stopping at
+// the end of the program (NULL) or when the chain loops back to
+// the given while loop header (the end of a loop body). state[]
+// holds the type of each slot before the first statement, and is
+// updated to the types after the last; changes are logged in log.
+//
+static void infer_stmts(struct TYPEINFO* types, struct SYMTAB* symbols, struct STMT* stmt, struct STMT* loop_header, int* state, struct UNDO_LOG* log)
+{
+  while (stmt != NULL && stmt != loop_header) {
+
+    if (stmt->stmt_type == STMT_ASSIGNMENT) {
+      struct STMT_ASSIGNMENT* assign = stmt->types.assignment;
+      int type;
+
+      if (assign->rhs->value_type == VALUE_EXPR)
+        type = infer_expr(types, symbols, assign->rhs->types.expr, state);
+      else
+        type = function_type(assign->rhs->types.function_call);
+
+      set_type(log, state, resolve_slot(symbols, stmt), type);
+
+      stmt = assign->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_FUNCTION_CALL) {
+      stmt = stmt->types.function_call->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+      struct STMT_WHILE_LOOP* loop = stmt->types.while_loop;
+
+      //
+      // iterate to a fixed point; the last pass over the loop is
+      // made with the final types at the header, so the last
+      // annotation of each expression in the loop is the right one.
+      // Only the slots the body changes can change at the header:
+      //
+      for (;;) {
+        infer_expr(types, symbols, loop->condition, state);
+
+        int mark = log->length;
+
+        log->depth++;
+        infer_stmts(types, symbols, loop->loop_body, stmt, state, log);
+        log->depth--;
+
+        if (!join_pass(log, state, mark))
+          break;
+      }
+
+      //
+      // the loop exits from the header, so state[] is right as is:
+      //
+      stmt = loop->next_stmt;
+    }
+    else {
+      assert(stmt->stmt_type == STMT_PASS);
+
+      stmt = stmt->types.pass->next_stmt;
+    }
+  }
+}
+
+
+//
+// operand_type
+//
+// Returns the type of the given instruction operand: the type of
+// its constant, or the type its variable has in state[].
+//
+static int operand_type(struct BYTECODE* bytecode, int operand, int* state)
+{
+  if (OPERAND_IS_CONST(operand))
+    return bytecode->constants[OPERAND_CONST_INDEX(operand)].value_type;
+  else
+    return state[operand];
+}
+
+//
+// specialized_types
+//
+// If the given opcode is a specialized one, sets the type both its
+// operands must have and the type of its result, and returns true;
+// returns false otherwise.
+//
+static bool specialized_types(int opcode, int* operand_type, int* result_type)
+{
+  switch (opcode) {
+#define SPECIALIZED_CASE(type, name, operator, op, result) \
+    case OP_##type##_##name: \
+      *operand_type = type##_OPERAND_TYPE; \
+      *result_type = result; \
+      return true;
+
+    SPECIALIZED_BINARIES(SPECIALIZED_CASE)
+
+#undef SPECIALIZED_CASE
+
+    default:
+      return false;
+  }
+}
+
+//
+// check_code
+//
+// Analyzes the instructions from pc up to (not including) end, as
+// infer_stmts does the statements they were compiled from: state[]
+// holds the type of each slot at pc, and is updated to the types at
+// end; changes are logged in log. Returns false as soon as a
+// specialized instruction's operand types are not proven, or a jump
+// is not part of a while loop within [pc, end).
+//
+static bool check_code(struct BYTECODE* bytecode, int pc, int end, int* state, struct UNDO_LOG* log)
+{
+  struct INSTR* code = bytecode->code;
+  int acc = TYPE_UNKNOWN;
+
+  while (pc < end) {
+    struct INSTR* instr = &code[pc];
+    int type, result;
+
+    switch (instr->opcode) {
+      case OP_LOAD:
+        acc = operand_type(bytecode, instr->lhs, state);
+        break;
+      case OP_BINARY:
+        acc = binary_type(operand_type(bytecode, instr->lhs, state), instr->arg, operand_type(bytecode, instr->rhs, state));
+        break;
+      case OP_STORE:
+        set_type(log, state, instr->arg, acc);
+        break;
+      case OP_INPUT:
+        acc = RAM_TYPE_STR;
+        break;
+      case OP_INT:
+        acc = RAM_TYPE_INT;
+        break;
+      case OP_FLOAT:
+        acc = RAM_TYPE_REAL;
+        break;
+      case OP_PRINT:
+      case OP_PRINT_NEWLINE:
+      case OP_BAD_CALL:
+      case OP_STOP:
+      case OP_HALT:
+        //
+        // the program either goes on to the next instruction or
+        // ends here, in which case whatever follows is unreachable
+        // from here and may be analyzed as if it weren't:
+        //
+        acc = TYPE_UNKNOWN;
+        break;
+      case OP_JUMP: {
+        //
+        // a while loop, see compile_stmts:
+        //
+        //       JUMP test
+        // body: <body>
+        // test: <condition, which assigns nothing>
+        //       JUMP_IF_TRUE body
+        //
+        int body = pc + 1;
+        int test = instr->arg;
+        int bottom = test;
+
+        if (test < body || test >= end)
+          return false;
+
+        while (bottom < end && code[bottom].opcode != OP_JUMP_IF_TRUE) {
+          if (code[bottom].opcode == OP_JUMP || code[bottom].opcode == OP_STORE)
+            return false;
+          bottom++;
+        }
+
+        if (bottom == end || code[bottom].arg != body)
+          return false;
+
+        for (;;) {
+          if (!check_code(bytecode, test, bottom, state, log))
+            return false;
+
+          int mark = log->length;
+
+          log->depth++;
+          bool proven = check_code(bytecode, body, test, state, log);
+          log->depth--;
+
+          if (!proven)
+            return false;
+
+          if (!join_pass(log, state, mark))
+            break;
+        }
+
+        //
+        // the loop exits from the bottom, with the header types:
+        //
+        pc = bottom + 1;
+        acc = TYPE_UNKNOWN;
+        continue;
+      }
+      case OP_JUMP_IF_TRUE:
+        return false;  // not at the bottom of a loop
+      default:
+        //
+        // a specialized binary operation; the types at the header
+        // of a loop only ever become less known with each pass, so
+        // if the last pass proves an instruction all did:
+        //
+        if (!specialized_types(instr->opcode, &type, &result) ||
+            operand_type(bytecode, instr->lhs, state) != type ||
+            operand_type(bytecode, instr->rhs, state) != type)
+          return false;
+        acc = result;
+        break;
+    }
+
+    pc++;
+  }
+
+  return true;
+}
+
+
+//
+// Public functions:
+//
+
+//
+// infer_types
+//
+// Infers variable types and specializes binary expressions.
+//
+struct TYPEINFO* infer_types(struct STMT* program, struct SYMTAB* symbols)
+{
+  struct TYPEINFO* types = (struct TYPEINFO*)malloc(sizeof(struct TYPEINFO));
+
+  types->ops = nodemap_init();
+
+  struct UNDO_LOG log;
+  int* state = init_log(&log, symbols->num_symbols);
+
+  infer_stmts(types, symbols, program, NULL, state, &log);
+
+  free_log(&log, state);
+
+  //
+  // every binary expression has been annotated, count them:
+  //
+  types->num_binary = 0;
+  types->num_specialized = 0;
+
+  for (int i = 0; i < types->ops->capacity; i++) {
+    if (types->ops->entries[i].node != NULL) {
+      types->num_binary++;
+      if (types->ops->entries[i].value != SPEC_GENERIC)
+        types->num_specialized++;
+    }
+  }
+
+  return types;
+}
+
+
+//
+// infer_op
+//
+// Returns the specialized operator of a binary expression.
+//
+int infer_op(struct TYPEINFO* types, struct EXPR* expr)
+{
+  int op = nodemap_get(types->ops, expr);
+
+  return (op == -1) ? SPEC_GENERIC : op;
+}
+
+
+//
+// infer_check_bytecode
+//
+// Checks the specialized instructions of the given bytecode.
+//
+bool infer_check_bytecode(struct BYTECODE* bytecode)
+{
+  struct UNDO_LOG log;
+  int* state = init_log(&log, bytecode->num_names);
+
+  bool proven = check_code(bytecode, 0, bytecode->num_instrs, state, &log);
+
+  free_log(&log, state);
+
+  return proven;
+}
+
+
+//
+// infer_print_stats
+//
+// Prints how many binary expressions were specialized.
+//
+void infer_print_stats(struct TYPEINFO* types)
+{
+  printf("**TYPE INFERENCE**\n");
+  printf("Binary operations: %d\n", types->num_binary);
+  printf("Specialized: %d\n", types->num_specialized);
+  printf("Generic: %d\n", types->num_binary - types->num_specialized);
+  printf("**END TYPE INFERENCE**\n");
+}
+
+
+//
+// infer_destroy
+//
+// Frees the memory associated with the type information.
+//
+void infer_destroy(struct TYPEINFO* types)
+{
+  nodemap_destroy(types->ops);
+  free(types);
+}
@@ -0,0 +1,134 @@
+/*infer.h*/
+
+//
+// Static type inference for nuPython. A flow-sensitive pass over
+// the program graph works out, at each binary expression, which
+// types its operands are guaranteed to have. Where both types
+// are proven and the operation is one of the specialized ones
+// below, the expression is annotated with that specialized
+// operator (e.g. INT_ADD), so it can execute without checking
+// operand types. Everything else stays generic.
+//
+// A variable only has a proven type where every path to it has
+// assigned it, so a specialized operator's variable operands are
+// also known to be defined.
+//
+// The same analysis can be run over bytecode, to check the
+// specialized opcodes in bytecode that was not compiled here (see
+// bytecache.h) before the VM trusts them.
+//
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+
+#include "programgraph.h"
+#include "resolve.h"
+#include "nodemap.h"
+
+
+//
+// The specialized binary operations, X(operand type, name,
+// operator, C operator, result type). Both operands have the
+// given type: INT, REAL or STR (see *_OPERAND_TYPE).
+//
+#define SPECIALIZED_BINARIES(X) \
+  X(INT,  ADD, OPERATOR_PLUS,      +,  RAM_TYPE_INT)     \
+  X(INT,  SUB, OPERATOR_MINUS,     -,  RAM_TYPE_INT)     \
+  X(INT,  MUL, OPERATOR_ASTERISK,  *,  RAM_TYPE_INT)     \
+  X(INT,  EQ,  OPERATOR_EQUAL,     ==, RAM_TYPE_BOOLEAN) \
+  X(INT,  NE,  OPERATOR_NOT_EQUAL, !=, RAM_TYPE_BOOLEAN) \
+  X(INT,  LT,  OPERATOR_LT,        <,  RAM_TYPE_BOOLEAN) \
+  X(INT,  LE,  OPERATOR_LTE,       <=, RAM_TYPE_BOOLEAN) \
+  X(INT,  GT,  OPERATOR_GT,        >,  RAM_TYPE_BOOLEAN) \
+  X(INT,  GE,  OPERATOR_GTE,       >=, RAM_TYPE_BOOLEAN) \
+  X(REAL, ADD, OPERATOR_PLUS,      +,  RAM_TYPE_REAL)    \
+  X(REAL, SUB, OPERATOR_MINUS,     -,  RAM_TYPE_REAL)    \
+  X(REAL, MUL, OPERATOR_ASTERISK,  *,  RAM_TYPE_REAL)    \
+  X(REAL, EQ,  OPERATOR_EQUAL,     ==, RAM_TYPE_BOOLEAN) \
+  X(REAL, NE,  OPERATOR_NOT_EQUAL, !=, RAM_TYPE_BOOLEAN) \
+  X(REAL, LT,  OPERATOR_LT,        <,  RAM_TYPE_BOOLEAN) \
+  X(REAL, LE,  OPERATOR_LTE,       <=, RAM_TYPE_BOOLEAN) \
+  X(REAL, GT,  OPERATOR_GT,        >,  RAM_TYPE_BOOLEAN) \
+  X(REAL, GE,  OPERATOR_GTE,       >=, RAM_TYPE_BOOLEAN) \
+  X(STR,  EQ,  OPERATOR_EQUAL,     ==, RAM_TYPE_BOOLEAN) \
+  X(STR,  NE,  OPERATOR_NOT_EQUAL, !=, RAM_TYPE_BOOLEAN) \
+  X(STR,  LT,  OPERATOR_LT,        <,  RAM_TYPE_BOOLEAN) \
+  X(STR,  LE,  OPERATOR_LTE,       <=, RAM_TYPE_BOOLEAN) \
+  X(STR,  GT,  OPERATOR_GT,        >,  RAM_TYPE_BOOLEAN) \
+  X(STR,  GE,  OPERATOR_GTE,       >=, RAM_TYPE_BOOLEAN)
+
+#define INT_OPERAND_TYPE   RAM_TYPE_INT
+#define REAL_OPERAND_TYPE  RAM_TYPE_REAL
+#define STR_OPERAND_TYPE   RAM_TYPE_STR
+
+//
+// Specialized operators: SPEC_INT_ADD, SPEC_REAL_LT, ...
+//
+enum SPECIALIZED_OPS
+{
+  SPEC_GENERIC = 0,  // types not proven, check at runtime
+#define SPECIALIZED_OP(type, name, operator, op, result_type) SPEC_##type##_##name,
+  SPECIALIZED_BINARIES(SPECIALIZED_OP)
+#undef SPECIALIZED_OP
+  NUM_SPECIALIZED_OPS
+};
+
+struct BYTECODE;  // see bytecode.h
+
+struct TYPEINFO
+{
+  struct NODE_MAP* ops;  // binary EXPR => enum SPECIALIZED_OPS
+
+  int num_binary;        // binary expressions in the program
+  int num_specialized;   // ... of which were specialized
+};
+
+
+//
+// Public functions:
+//
+
+//
+// infer_types
+//
+// Infers the types of the variables throughout the given program
+// graph, whose identifiers were resolved to the given symbol table,
+// and picks a specialized operator for every binary expression
+// whose operand types are proven. Returns the result.
+//
+struct TYPEINFO* infer_types(struct STMT* program, struct SYMTAB* symbols);
+
+//
+// infer_op
+//
+// Returns the specialized operator (enum SPECIALIZED_OPS) chosen
+// for the given binary expression, SPEC_GENERIC if none.
+//
+int infer_op(struct TYPEINFO* types, struct EXPR* expr);
+
+//
+// infer_check_bytecode
+//
+// Infers the types of the variables throughout the given bytecode,
+// and returns true if they prove the operand types of every
+// specialized instruction in it. Returns false if any is not
+// proven, or if the jumps are not those of while loops as laid out
+// by bytecode_compile. The operands must be valid slots and
+// constants.
+//
+bool infer_check_bytecode(struct BYTECODE* bytecode);
+
+//
+// infer_print_stats
+//
+// Prints how many binary expressions were specialized.
+//
+void infer_print_stats(struct TYPEINFO* types);
+
+//
+// infer_destroy
+//
+// Frees the memory associated with the type information.
+//
+void infer_destroy(struct TYPEINFO* types);
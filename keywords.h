@@ -0,0 +1,70 @@
+/*keywords.h*/
+
+//
+// Keyword table of the memory-mapped scanner, a minimal perfect
+// hash on the length and the first and last characters.
+//
+// GENERATED by genkeywords.py from token.h, do not edit:
+//
+//   python3 genkeywords.py > keywords.h
+//
+
+#pragma once
+
+#include "token.h"
+
+
+#define NUM_KEYWORDS        18
+#define MIN_KEYWORD_LENGTH  2
+#define MAX_KEYWORD_LENGTH  8
+
+#define KEYWORD_HASH(text, length) \
+  (((length) + keyword_asso[(unsigned char)(text)[0]] + \
+    keyword_asso[(unsigned char)(text)[(length) - 1]]) % NUM_KEYWORDS)
+
+static const unsigned char keyword_asso[256] = {
+  ['F'] = 8,
+  ['N'] = 10,
+  ['T'] = 14,
+  ['a'] = 4,
+  ['b'] = 0,
+  ['c'] = 4,
+  ['d'] = 3,
+  ['e'] = 0,
+  ['f'] = 1,
+  ['i'] = 0,
+  ['k'] = 6,
+  ['n'] = 0,
+  ['o'] = 12,
+  ['p'] = 6,
+  ['r'] = 2,
+  ['s'] = 7,
+  ['t'] = 12,
+  ['w'] = 14,
+};
+
+static const struct
+{
+  const char* text;
+  int length;
+  int id;
+} keyword_table[NUM_KEYWORDS] = {
+  { "True",     4, nuPy_KEYW_TRUE      },
+  { "while",    5, nuPy_KEYW_WHILE     },
+  { "in",       2, nuPy_KEYW_IN        },
+  { "if",       2, nuPy_KEYW_IF        },
+  { "else",     4, nuPy_KEYW_ELSE      },
+  { "elif",     4, nuPy_KEYW_ELIF      },
+  { "for",      3, nuPy_KEYW_FOR       },
+  { "def",      3, nuPy_KEYW_DEF       },
+  { "return",   6, nuPy_KEYW_RETURN    },
+  { "is",       2, nuPy_KEYW_IS        },
+  { "and",      3, nuPy_KEYW_AND       },
+  { "break",    5, nuPy_KEYW_BREAK     },
+  { "continue", 8, nuPy_KEYW_CONTINUE  },
+  { "False",    5, nuPy_KEYW_FALSE     },
+  { "None",     4, nuPy_KEYW_NONE      },
+  { "not",      3, nuPy_KEYW_NOT       },
+  { "or",       2, nuPy_KEYW_OR        },
+  { "pass",     4, nuPy_KEYW_PASS      },
+};
@@ -15,30 +15,149 @@
 
 #include "token.h"    // token defs
 #include "scanner.h" 
+#include "mapscanner.h"
 #include "parser.h"
 
 #include "programgraph.h" 
+#include "arena.h"
 #include "ram.h"
+#include "optimize.h"
+#include "resolve.h"
 #include "execute.h"
+#include "infer.h"
+#include "bytecode.h"
+#include "vm.h"
+#include "bytecache.h"
+#include "stats.h"
+#include "profile.h"
+#include "sampler.h"
+#include "output.h"
+#include "dtoa.h"
 
 //
 // main
 //
-// usage: program.exe [filename.py]
+// usage: program.exe [--tree] [--profile] [--sample[=hz]] [--stats[=json]] [--pipeline] [--no-cache]
+//                    [--output-buffer=bytes] [--real=fixed|repr] [filename.py]
 // 
-// If a filename is given, the file is opened and serves as
-// input to the program. If a filename is not given, then 
-// input is taken from the keyboard until $ is input.
+// If a filename is given, the file is mapped into memory and
+// serves as input to the program. If a filename is not given, then 
+// input is taken from the keyboard until $ is input. The program
+// graph is built while the program is parsed. With --pipeline,
+// the file is scanned on a separate thread while it's being
+// parsed, and the graph is built from the tokens afterwards.
+//
+// The program is compiled to bytecode and run on the VM.
+// With --tree, the program graph is executed directly by
+// the tree-walking executor instead (for differential
+// testing of the two). With --profile, the program graph is
+// executed by the tree-walking executor, and how many times each
+// line was executed, and for how long, is output at the end, the
+// most time first (see profile.h). With --sample, the program
+// graph is executed by the tree-walking executor while a timer
+// samples which line is executing, 997 times a second of CPU time
+// or the given number, and the samples are output to stderr as
+// folded stacks for flame graph tools (see sampler.h). With
+// --stats, statistics about the
+// run are output at the end: for each phase of the run, the
+// time, allocations and peak memory it took, and counts such
+// as the number of statements executed (see stats.h). With
+// --stats=json, they are output as a line of JSON instead.
+//
+// Output is buffered, 64 KB at a time by default (see output.h);
+// --output-buffer sets the size, and --output-buffer=0 leaves
+// stdout buffered the way the C library chooses.
+//
+// Reals are output with 6 decimals, as printf("%lf") does; with
+// --real=repr, they're output as Python's repr() does instead, with
+// the fewest digits that read back as the same real (see dtoa.h).
+//
+// The bytecode of a file is cached next to it (filename.pyc, see
+// bytecache.h), and run from there as long as the file doesn't
+// change. The cache is only used to run a file on the VM, with no
+// other options; --no-cache compiles the file regardless.
 //
 int main(int argc, char* argv[])
 {
   FILE* input = NULL;
+  struct MappedSource* source = NULL;
   bool  keyboardInput = false;
+  bool  treeWalker = false;
+  bool  profile = false;
+  int   sampleHz = 0;  // not sampling
+  int   outputSize = OUTPUT_DEFAULT_SIZE;
+  bool  stats = false;
+  bool  statsJson = false;
+  bool  pipeline = false;
+  bool  useCache = true;
+  char* filename = NULL;
+
+  //
+  // options first, then the (optional) filename:
+  //
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--tree") == 0)
+      treeWalker = true;
+    else if (strcmp(argv[i], "--profile") == 0)
+      treeWalker = profile = true;
+    else if (strcmp(argv[i], "--sample") == 0) {
+      treeWalker = true;
+      sampleHz = SAMPLER_DEFAULT_HZ;
+    }
+    else if (strncmp(argv[i], "--sample=", 9) == 0) {
+      treeWalker = true;
+      sampleHz = atoi(argv[i] + 9);
+
+      if (sampleHz < 1 || sampleHz > 1000000) {
+        printf("**ERROR: sample rate must be 1..1000000 per second, not '%s'.\n", argv[i] + 9);
+        return 0;
+      }
+    }
+    else if (strncmp(argv[i], "--output-buffer=", 16) == 0) {
+      char* end;
+      long size = strtol(argv[i] + 16, &end, 10);
+
+      if (end == argv[i] + 16 || *end != '\0' || size < 0 || size > 1024 * 1024 * 1024) {
+        printf("**ERROR: output buffer must be 0..1073741824 bytes, not '%s'.\n", argv[i] + 16);
+        return 0;
+      }
+
+      outputSize = (int)size;
+    }
+    else if (strcmp(argv[i], "--real=fixed") == 0)
+      dtoa_set_format(REAL_FORMAT_FIXED);
+    else if (strcmp(argv[i], "--real=repr") == 0)
+      dtoa_set_format(REAL_FORMAT_REPR);
+    else if (strcmp(argv[i], "--stats") == 0)
+      stats = true;
+    else if (strcmp(argv[i], "--stats=json") == 0)
+      stats = statsJson = true;
+    else if (strcmp(argv[i], "--pipeline") == 0)
+      pipeline = true;
+    else if (strcmp(argv[i], "--no-cache") == 0)
+      useCache = false;
+    else if (filename == NULL)
+      filename = argv[i];
+    else {
+      printf("**ERROR: unexpected argument '%s'.\n", argv[i]);
+      return 0;
+    }
+  }
+
+  output_init(outputSize);
+
+  //
+  // profiling each statement would skew the samples:
+  //
+  if (profile && sampleHz > 0) {
+    printf("**ERROR: --profile and --sample can't be used together.\n");
+    return 0;
+  }
 
   //
   // where is the input coming from?
   //
-  if (argc < 2) {
+  if (filename == NULL) {
     //
     // no args, just the program name:
     //
@@ -47,13 +166,12 @@ int main(int argc, char* argv[])
   }
   else {
     //
-    // assume 2nd arg is a nuPython file:
+    // assume the filename is a nuPython file, and map it
+    // into memory:
     //
-    char* filename = argv[1];
+    source = mapscanner_open(filename);
 
-    input = fopen(filename, "r");
-
-    if (input == NULL) // unable to open:
+    if (source == NULL) // unable to open:
     {
       printf("**ERROR: unable to open input file '%s' for input.\n", filename);
       return 0;
@@ -65,14 +183,101 @@ int main(int argc, char* argv[])
   if (keyboardInput)  // prompt the user if appropriate:
   {
     printf("nuPython input (enter $ when you're done)>\n");
+    output_flush();
+  }
+
+  //
+  // if the file was compiled before, and hasn't changed since,
+  // run the bytecode it was compiled to; only a file that could be
+  // mapped is cached, not a pipe or the like that was read into a
+  // buffer:
+  //
+  char* cachename = NULL;
+
+  if (source != NULL && source->buffer == NULL && useCache && !treeWalker && !stats && !pipeline)
+  {
+    cachename = bytecache_filename(filename);
+
+    struct BYTECODE* bytecode = bytecache_load(cachename, source);
+
+    if (bytecode != NULL)
+    {
+      mapscanner_close(source);
+      free(cachename);
+
+      printf("**parsing successful, valid syntax\n");
+      printf("**building program graph...\n");
+      printf("**executing...\n");
+
+      struct RAM* memory = ram_init();
+
+      vm_execute(bytecode, memory);
+      output_flush();
+
+      bytecode_destroy(bytecode);
+
+      printf("**done\n");
+
+      ram_print(memory);
+      ram_destroy(memory);
+
+      return 0;
+    }
+  }
+
+  //
+  // with --stats, the run is measured phase by phase:
+  //
+  struct STATS* runStats = stats ? stats_init() : NULL;
+
+  //
+  // call parser to check program syntax, and build the program
+  // graph as it goes; the graph is only built from the tokens
+  // when it can't be built directly:
+  //
+  struct ARENA* arena = arena_init();
+  struct STMT* program = NULL;
+  struct TokenQueue* tokens = NULL;
+  bool valid;
+
+  stats_begin(runStats, "parse");
+
+  if (source != NULL) {
+    if (pipeline) {
+      tokens = parser_parse_pipelined(source);
+      valid = (tokens != NULL);
+    }
+    else
+      valid = parser_build_source(source, arena, &program, &tokens);
+
+    //
+    // the source is hashed when the bytecode is cached:
+    //
+    if (cachename == NULL) {
+      mapscanner_close(source);
+      source = NULL;
+    }
   }
+  else {
+    valid = parser_build(input, arena, &program, &tokens);
+  }
+
+  stats_end(runStats);
+
+  if (runStats != NULL)
+    runStats->tokens = mapscanner_num_tokens();
 
   //
-  // call parser to check program syntax:
+  // a graph built from the tokens is malloc'd a node at a time,
+  // rather than in the arena:
   //
-  struct TokenQueue* tokens = parser_parse(input);
+  bool fromTokens = (tokens != NULL);
+
+  struct SYMTAB* symbols = NULL;
+  struct TYPEINFO* types = NULL;
+  struct RAM* memory = NULL;
 
-  if (tokens == NULL)
+  if (!valid)
   {
     // 
     // program has a syntax error, error msg already output:
@@ -84,37 +289,162 @@ int main(int argc, char* argv[])
     printf("**parsing successful, valid syntax\n");
     printf("**building program graph...\n");
 
-    struct STMT* program = programgraph_build(tokens);
+    if (fromTokens) {
+      stats_begin(runStats, "build");
+      program = programgraph_build(tokens);
+      stats_end(runStats);
+    }
 
     //programgraph_print(program);
 
+    if (runStats != NULL)
+      runStats->nodes = stats_count_nodes(program);
+
+    //
+    // fold constants and drop dead statements:
+    //
+    stats_begin(runStats, "optimize");
+    program = optimize_program(program, fromTokens ? NULL : arena);
+    stats_end(runStats);
+
     //
-    // now execute the program:
+    // resolve identifiers to slots and parse the literals:
     //
-    printf("**executing...\n");
+    stats_begin(runStats, "resolve");
+    symbols = resolve_program(program);
+    stats_end(runStats);
+
+    if (symbols == NULL)
+    {
+      //
+      // a literal is out of range, error msg already output:
+      //
+      printf("**building program graph failed...\n");
+    }
+    else
+    {
+      //
+      // now execute the program; memory grows as variables are
+      // written, so a program that stops early prints only what it
+      // wrote:
+      //
+      printf("**executing...\n");
 
-    struct RAM* memory = ram_init();
+      stats_begin(runStats, "ram_init");
+      memory = ram_init();
+      stats_end(runStats);
 
-    execute(program, memory);
+      long executed;
+      struct PROFILE* lines = NULL;
 
-    printf("**done\n");
+      if (sampleHz > 0) {
+        struct SAMPLER* sampler = sampler_init(program, sampleHz);
 
-    ram_print(memory);
+        stats_begin(runStats, "execute");
+        sampler_start(sampler);
+        executed = execute_sampled(program, symbols, memory, &sampler->line);
+        sampler_stop(sampler);
+        stats_end(runStats);
 
-    //
-    // cleanup:
-    //
-    programgraph_destroy(program);
+        sampler_print(sampler, stderr);
+        sampler_destroy(sampler);
+      }
+      else if (profile) {
+        lines = profile_init();
+
+        stats_begin(runStats, "execute");
+        executed = execute_profiled(program, symbols, memory, lines);
+        stats_end(runStats);
+      }
+      else if (treeWalker) {
+        stats_begin(runStats, "execute");
+        executed = execute(program, symbols, memory);
+        stats_end(runStats);
+      }
+      else {
+        //
+        // prove what types we can, so the VM can skip type checks
+        // (the tree walker checks them all anyway):
+        //
+        stats_begin(runStats, "infer");
+        types = infer_types(program, symbols);
+        stats_end(runStats);
+
+        stats_begin(runStats, "compile");
+        struct BYTECODE* bytecode = bytecode_compile(program, symbols, types);
+
+        //
+        // cache it for next time, unless the scanner output warnings
+        // (which a run from the cache wouldn't):
+        //
+        if (cachename != NULL && source->warnings == 0)
+          bytecache_save(cachename, source, bytecode);
+        stats_end(runStats);
+
+        stats_begin(runStats, "execute");
+        executed = vm_execute(bytecode, memory);
+        stats_end(runStats);
+
+        bytecode_destroy(bytecode);
+      }
+
+      //
+      // the program stopped, done or on an error:
+      //
+      output_flush();
+
+      printf("**done\n");
+
+      ram_print(memory);
+
+      if (lines != NULL) {
+        profile_print(lines);
+        profile_destroy(lines);
+      }
+
+      if (stats && !statsJson && types != NULL)
+        infer_print_stats(types);
+
+      if (runStats != NULL) {
+        runStats->statements = executed;
+        runStats->cells = memory->num_values;
+      }
+    }
+  }
+
+  //
+  // cleanup:
+  //
+  stats_begin(runStats, "destroy");
+
+  if (types != NULL)
+    infer_destroy(types);
+  if (symbols != NULL)
+    resolve_destroy(symbols);
+  if (memory != NULL)
     ram_destroy(memory);
+
+  if (fromTokens) {
+    programgraph_destroy(program);
     tokenqueue_destroy(tokens);
   }
 
+  arena_destroy(arena);
+
+  if (source != NULL)
+    mapscanner_close(source);
+  free(cachename);
+
+  stats_end(runStats);
+
+  if (runStats != NULL) {
+    stats_print(runStats, statsJson);
+    stats_destroy(runStats);
+  }
+
   //
   // done:
   //
-  if (!keyboardInput)
-    fclose(input);
-
   return 0;
 
 }
@@ -0,0 +1,734 @@
+/*mapscanner.c*/
+
+//
+// Memory-mapped scanner for nuPython, see mapscanner.h.
+//
+
+// mmap, posix_madvise
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>   // INT_MAX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define MAPSCANNER_SIMD
+#include <immintrin.h>
+#endif
+
+#include "token.h"
+#include "mapscanner.h"
+#include "keywords.h"    // generated, see genkeywords.py
+
+
+//
+// character classes, a table lookup instead of a ctype call per
+// character (filled from ctype, so the classes are the same as
+// the stream scanner's):
+//
+#define CLASS_BLANK        1  // white space other than '\n'
+#define CLASS_DIGIT        2
+#define CLASS_IDENT_START  4  // letter or _
+#define CLASS_IDENT        8  // letter, digit or _
+
+static unsigned char char_class[256];
+static bool char_class_built = false;
+
+//
+// tokens scanned so far, by every scanner (see mapscanner_num_tokens):
+//
+static long num_tokens = 0;
+
+#define IS_BLANK(c)        (char_class[(unsigned char)(c)] & CLASS_BLANK)
+#define IS_DIGIT(c)        (char_class[(unsigned char)(c)] & CLASS_DIGIT)
+#define IS_IDENT_START(c)  (char_class[(unsigned char)(c)] & CLASS_IDENT_START)
+#define IS_IDENT(c)        (char_class[(unsigned char)(c)] & CLASS_IDENT)
+
+//
+// Scanning kernels. Most of the bytes of a (generated) script are
+// indentation, comments and long identifiers, so the three loops
+// over them -- skip a run of blanks, find the end of a comment's
+// line, find the end of an identifier -- come in a scalar version,
+// and on x86-64 in SSE2 and AVX2 versions that classify 16 or 32
+// bytes at a time. The fastest one the CPU supports is used, see
+// mapscanner_use_kernel. Each returns the offset of the first
+// byte at or after pos that doesn't belong to the run (or size).
+//
+struct SCAN_KERNEL
+{
+  const char* name;
+  int (*skip_blanks)(const char* text, int pos, int size);
+  int (*find_eoln)(const char* text, int pos, int size);
+  int (*skip_ident)(const char* text, int pos, int size);
+};
+
+static const struct SCAN_KERNEL* kernel = NULL;
+
+
+//
+// Private functions:
+//
+
+//
+// build_char_class
+//
+// Fills in the character class table.
+//
+static void build_char_class(void)
+{
+  for (int c = 0; c < 256; c++) {
+    char_class[c] = 0;
+
+    if (isspace(c) && c != '\n')
+      char_class[c] |= CLASS_BLANK;
+    if (isdigit(c))
+      char_class[c] |= CLASS_DIGIT;
+    if (isalpha(c) || c == '_')
+      char_class[c] |= CLASS_IDENT_START;
+    if (isalnum(c) || c == '_')
+      char_class[c] |= CLASS_IDENT;
+  }
+
+  char_class_built = true;
+}
+
+//
+// skip_blanks_scalar, find_eoln_scalar, skip_ident_scalar
+//
+// The scalar kernels, also used for the last few bytes by the
+// vector kernels.
+//
+static int skip_blanks_scalar(const char* text, int pos, int size)
+{
+  while (pos < size && IS_BLANK(text[pos]))
+    pos++;
+
+  return pos;
+}
+
+static int find_eoln_scalar(const char* text, int pos, int size)
+{
+  while (pos < size && text[pos] != '\n')
+    pos++;
+
+  return pos;
+}
+
+static int skip_ident_scalar(const char* text, int pos, int size)
+{
+  while (pos < size && IS_IDENT(text[pos]))
+    pos++;
+
+  return pos;
+}
+
+#ifdef MAPSCANNER_SIMD
+
+//
+// VECTOR_KERNELS
+//
+// Defines the three kernels for one vector width. The byte compares
+// are signed, so bytes >= 128 are negative and fall outside every
+// (ASCII) range below, like they do for ctype. A mask has a bit
+// set for each byte in the run; the run ends at the first 0 bit
+// of the width bits.
+//
+//   blank: ' ', or '\t' .. '\r' except '\n'
+//   ident: 'a' .. 'z' (after | 0x20, so also 'A' .. 'Z'),
+//          '0' .. '9', '_'
+//
+#define ALL_BYTES(width)  (unsigned int)((1ull << (width)) - 1)
+
+#define VECTOR_KERNELS(isa, attr, vec, width, load, set1, cmpeq, cmpgt, and, or, andnot, movemask) \
+  attr static int skip_blanks_##isa(const char* text, int pos, int size) \
+  { \
+    const vec space = set1(' '); \
+    const vec eoln = set1('\n'); \
+    const vec below_tab = set1('\t' - 1); \
+    const vec above_cr = set1('\r' + 1); \
+    \
+    for (; pos + width <= size; pos += width) { \
+      vec x = load((const vec*)(text + pos)); \
+      vec ctrl = and(cmpgt(x, below_tab), cmpgt(above_cr, x)); \
+      vec blank = or(cmpeq(x, space), andnot(cmpeq(x, eoln), ctrl)); \
+      unsigned int end = ~(unsigned int)movemask(blank) & ALL_BYTES(width); \
+      if (end != 0) \
+        return pos + __builtin_ctz(end); \
+    } \
+    return skip_blanks_scalar(text, pos, size); \
+  } \
+  \
+  attr static int find_eoln_##isa(const char* text, int pos, int size) \
+  { \
+    const vec eoln = set1('\n'); \
+    \
+    for (; pos + width <= size; pos += width) { \
+      vec x = load((const vec*)(text + pos)); \
+      unsigned int found = (unsigned int)movemask(cmpeq(x, eoln)); \
+      if (found != 0) \
+        return pos + __builtin_ctz(found); \
+    } \
+    return find_eoln_scalar(text, pos, size); \
+  } \
+  \
+  attr static int skip_ident_##isa(const char* text, int pos, int size) \
+  { \
+    const vec case_bit = set1(0x20); \
+    const vec below_a = set1('a' - 1); \
+    const vec above_z = set1('z' + 1); \
+    const vec below_0 = set1('0' - 1); \
+    const vec above_9 = set1('9' + 1); \
+    const vec underscore = set1('_'); \
+    \
+    for (; pos + width <= size; pos += width) { \
+      vec x = load((const vec*)(text + pos)); \
+      vec lower = or(x, case_bit); \
+      vec alpha = and(cmpgt(lower, below_a), cmpgt(above_z, lower)); \
+      vec digit = and(cmpgt(x, below_0), cmpgt(above_9, x)); \
+      vec ident = or(or(alpha, digit), cmpeq(x, underscore)); \
+      unsigned int end = ~(unsigned int)movemask(ident) & ALL_BYTES(width); \
+      if (end != 0) \
+        return pos + __builtin_ctz(end); \
+    } \
+    return skip_ident_scalar(text, pos, size); \
+  }
+
+VECTOR_KERNELS(sse2, , __m128i, 16, _mm_loadu_si128, _mm_set1_epi8, _mm_cmpeq_epi8, _mm_cmpgt_epi8,
+  _mm_and_si128, _mm_or_si128, _mm_andnot_si128, _mm_movemask_epi8)
+
+VECTOR_KERNELS(avx2, __attribute__((target("avx2"))), __m256i, 32, _mm256_loadu_si256, _mm256_set1_epi8,
+  _mm256_cmpeq_epi8, _mm256_cmpgt_epi8, _mm256_and_si256, _mm256_or_si256, _mm256_andnot_si256, _mm256_movemask_epi8)
+
+#endif
+
+//
+// the kernels, fastest last:
+//
+static const struct SCAN_KERNEL kernels[] = {
+  { "scalar", skip_blanks_scalar, find_eoln_scalar, skip_ident_scalar },
+#ifdef MAPSCANNER_SIMD
+  { "sse2",   skip_blanks_sse2,   find_eoln_sse2,   skip_ident_sse2 },
+  { "avx2",   skip_blanks_avx2,   find_eoln_avx2,   skip_ident_avx2 },
+#endif
+};
+
+#define NUM_KERNELS  (int)(sizeof(kernels) / sizeof(kernels[0]))
+
+//
+// kernel_supported
+//
+// Returns true if the CPU can run the given kernel.
+//
+static bool kernel_supported(const struct SCAN_KERNEL* k)
+{
+#ifdef MAPSCANNER_SIMD
+  if (strcmp(k->name, "avx2") == 0)
+    return __builtin_cpu_supports("avx2");
+#endif
+
+  return true;
+}
+
+//
+// pick_kernel
+//
+// Selects the fastest kernel the CPU supports.
+//
+static void pick_kernel(void)
+{
+  for (int i = 0; i < NUM_KERNELS; i++) {
+    if (kernel_supported(&kernels[i]))
+      kernel = &kernels[i];
+  }
+}
+
+//
+// make_view
+//
+// Returns a token view.
+//
+static inline struct TokenView make_view(int id, int offset, int length)
+{
+  struct TokenView view;
+
+  num_tokens++;
+
+  view.id = id;
+  view.offset = offset;
+  view.length = length;
+
+  return view;
+}
+
+//
+// id_or_keyword
+//
+// Returns the token id of the identifier text[0 .. length): a
+// keyword's id, or nuPy_IDENTIFIER. The only keyword it can be
+// is the one in its slot of the perfect hash table.
+//
+static inline int id_or_keyword(const char* text, int length)
+{
+  if (length < MIN_KEYWORD_LENGTH || length > MAX_KEYWORD_LENGTH)
+    return nuPy_IDENTIFIER;
+
+  int slot = KEYWORD_HASH(text, length);
+
+  if (keyword_table[slot].length == length && memcmp(text, keyword_table[slot].text, length) == 0)
+    return keyword_table[slot].id;
+
+  return nuPy_IDENTIFIER;
+}
+
+//
+// scan_digits
+//
+// Returns the offset of the first non-digit at or after pos.
+//
+static inline int scan_digits(const char* text, int pos, int size)
+{
+  while (pos < size && IS_DIGIT(text[pos]))
+    pos++;
+
+  return pos;
+}
+
+
+//
+// read_stream
+//
+// Returns a scanner over a buffer holding everything that can be
+// read from the given file descriptor, which is closed; for input
+// whose size isn't known up front, such as a pipe. Returns NULL if
+// the input doesn't fit.
+//
+static struct MappedSource* read_stream(int fd)
+{
+  FILE* input = fdopen(fd, "r");
+
+  if (input == NULL) {
+    close(fd);
+    return NULL;
+  }
+
+  struct MappedSource* source = mapscanner_create();
+
+  while (mapscanner_read_line(source, input))
+    ;
+
+  bool complete = feof(input);
+
+  fclose(input);
+
+  if (!complete) {  // too large, or a read error
+    mapscanner_close(source);
+    return NULL;
+  }
+
+  return source;
+}
+
+
+//
+// Public functions:
+//
+
+//
+// mapscanner_open
+//
+// Maps the given file into memory and returns a scanner positioned
+// at its start, or NULL. Input that can't be mapped is read into
+// a buffer.
+//
+struct MappedSource* mapscanner_open(const char* filename)
+{
+  if (!char_class_built)
+    build_char_class();
+  if (kernel == NULL)
+    pick_kernel();
+
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+
+  struct stat info;
+  if (fstat(fd, &info) < 0) {
+    close(fd);
+    return NULL;
+  }
+
+  //
+  // only a regular file with a known size that fits in an int
+  // offset is mapped; pipes, FIFOs and /dev/stdin aren't regular,
+  // /proc files have a size of 0 whatever they hold, and an empty
+  // file can't be mapped anyway:
+  //
+  if (!S_ISREG(info.st_mode) || info.st_size == 0 || info.st_size > INT_MAX)
+    return read_stream(fd);
+
+  void* mapping = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+  if (mapping == MAP_FAILED) {
+    close(fd);
+    return NULL;
+  }
+
+  posix_madvise(mapping, info.st_size, POSIX_MADV_SEQUENTIAL);
+
+  //
+  // the mapping stays valid after the file is closed:
+  //
+  close(fd);
+
+  struct MappedSource* source = (struct MappedSource*)malloc(sizeof(struct MappedSource));
+
+  source->text = (const char*)mapping;
+  source->size = (int)info.st_size;
+  source->pos = 0;
+
+  source->buffer = NULL;
+  source->capacity = 0;
+
+  source->line_offset = 0;
+  source->line = 1;
+  source->line_start = 0;
+
+  source->warnings = 0;
+
+  return source;
+}
+
+
+//
+// mapscanner_create
+//
+// Returns a scanner over an empty, growable buffer.
+//
+struct MappedSource* mapscanner_create(void)
+{
+  if (!char_class_built)
+    build_char_class();
+  if (kernel == NULL)
+    pick_kernel();
+
+  struct MappedSource* source = (struct MappedSource*)malloc(sizeof(struct MappedSource));
+
+  source->capacity = 4096;
+  source->buffer = (char*)malloc(source->capacity * sizeof(char));
+
+  source->text = source->buffer;
+  source->size = 0;
+  source->pos = 0;
+
+  source->line_offset = 0;
+  source->line = 1;
+  source->line_start = 0;
+
+  source->warnings = 0;
+
+  return source;
+}
+
+
+//
+// mapscanner_read_line
+//
+// Reads the next line straight into the buffer, a character at a
+// time (a line may contain '\0', so fgets won't do); the buffer
+// doubles when it gets full, up to INT_MAX chars, where reading
+// stops. Returns false at the end of the stream, or at that limit.
+//
+bool mapscanner_read_line(struct MappedSource* source, FILE* input)
+{
+  int start = source->size;
+  int c;
+
+  while (source->size < INT_MAX && (c = getc_unlocked(input)) != EOF) {
+    if (source->size == source->capacity) {
+      source->capacity = (source->capacity > INT_MAX / 2) ? INT_MAX : 2 * source->capacity;
+      source->buffer = (char*)realloc(source->buffer, source->capacity * sizeof(char));
+      source->text = source->buffer;
+    }
+
+    source->buffer[source->size++] = (char)c;
+
+    if (c == '\n')
+      break;
+  }
+
+  return source->size > start;
+}
+
+
+//
+// mapscanner_close
+//
+// Unmaps the file, or frees the buffer, and frees the scanner.
+//
+void mapscanner_close(struct MappedSource* source)
+{
+  if (source->buffer != NULL)
+    free(source->buffer);
+  else if (source->size > 0)
+    munmap((void*)source->text, source->size);
+
+  free(source);
+}
+
+
+//
+// mapscanner_nextToken
+//
+// Scans the next token, following the same rules as scanner_nextToken.
+//
+struct TokenView mapscanner_nextToken(struct MappedSource* source)
+{
+  const char* text = source->text;
+  int size = source->size;
+  int pos = source->pos;
+
+  for (;;) {
+    int start = pos;
+
+    if (pos >= size || text[pos] == '$') {
+      source->pos = pos;  // stay at the end
+      return make_view(nuPy_EOS, pos, 0);
+    }
+
+    int c = (unsigned char)text[pos];
+    int next = (pos + 1 < size) ? (unsigned char)text[pos + 1] : EOF;
+    int id;
+
+    if (c == '\n') {
+      source->pos = pos + 1;
+      return make_view(nuPy_EOLN, pos, 1);
+    }
+
+    if (IS_BLANK(c)) {
+      pos = kernel->skip_blanks(text, pos + 1, size);
+      continue;
+    }
+
+    if (c == '#') {
+      //
+      // comment, skip to the end of the line (a $ doesn't end
+      // the input here):
+      //
+      pos = kernel->find_eoln(text, pos + 1, size);
+      continue;
+    }
+
+    int length = 1;
+
+    switch (c) {
+      case '(': id = nuPy_LEFT_PAREN; break;
+      case ')': id = nuPy_RIGHT_PAREN; break;
+      case '[': id = nuPy_LEFT_BRACKET; break;
+      case ']': id = nuPy_RIGHT_BRACKET; break;
+      case '{': id = nuPy_LEFT_BRACE; break;
+      case '}': id = nuPy_RIGHT_BRACE; break;
+      case '+': id = nuPy_PLUS; break;
+      case '-': id = nuPy_MINUS; break;
+      case '/': id = nuPy_SLASH; break;
+      case '%': id = nuPy_PERCENT; break;
+      case '&': id = nuPy_AMPERSAND; break;
+      case ':': id = nuPy_COLON; break;
+
+      //
+      // one or two characters (a ! on its own is not nuPython):
+      //
+      case '*':
+        id = (next == '*') ? nuPy_POWER : nuPy_ASTERISK;
+        length = (next == '*') ? 2 : 1;
+        break;
+      case '=':
+        id = (next == '=') ? nuPy_EQUALEQUAL : nuPy_EQUAL;
+        length = (next == '=') ? 2 : 1;
+        break;
+      case '!':
+        id = (next == '=') ? nuPy_NOTEQUAL : nuPy_UNKNOWN;
+        length = (next == '=') ? 2 : 1;
+        break;
+      case '<':
+        id = (next == '=') ? nuPy_LTE : nuPy_LT;
+        length = (next == '=') ? 2 : 1;
+        break;
+      case '>':
+        id = (next == '=') ? nuPy_GTE : nuPy_GT;
+        length = (next == '=') ? 2 : 1;
+        break;
+
+      default:
+        id = nuPy_UNKNOWN;
+        length = 0;  // not punctuation, see below
+        break;
+    }
+
+    if (length > 0) {
+      source->pos = pos + length;
+      return make_view(id, start, length);
+    }
+
+    if (IS_IDENT_START(c)) {
+      pos = kernel->skip_ident(text, pos + 1, size);
+
+      source->pos = pos;
+      return make_view(id_or_keyword(text + start, pos - start), start, pos - start);
+    }
+
+    if (c == '.' || IS_DIGIT(c)) {
+      id = nuPy_INT_LITERAL;
+
+      if (c == '.') {
+        //
+        // a lone . is not a literal:
+        //
+        if (next == EOF || !IS_DIGIT(next)) {
+          source->pos = pos + 1;
+          return make_view(nuPy_UNKNOWN, start, 1);
+        }
+      }
+      else {
+        pos = scan_digits(text, pos, size);
+      }
+
+      if (pos < size && text[pos] == '.') {
+        id = nuPy_REAL_LITERAL;
+        pos = scan_digits(text, pos + 1, size);
+      }
+
+      source->pos = pos;
+      return make_view(id, start, pos - start);
+    }
+
+    if (c == '"' || c == '\'') {
+      //
+      // the value is the contents, up to the matching quote or
+      // the end of the line:
+      //
+      pos++;
+      while (pos < size && text[pos] != c && text[pos] != '\n')
+        pos++;
+
+      length = pos - (start + 1);
+
+      if (pos < size && text[pos] == c) {
+        pos++;  // closing quote
+      }
+      else {
+        int line, col;
+        mapscanner_position(source, start, &line, &col);
+        printf("**WARNING: string literal @ (%d, %d) not terminated properly\n", line, col);
+        source->warnings++;
+      }
+
+      source->pos = pos;
+      return make_view(nuPy_STR_LITERAL, start + 1, length);
+    }
+
+    //
+    // a character that is not part of nuPython:
+    //
+    source->pos = pos + 1;
+    return make_view(nuPy_UNKNOWN, start, 1);
+  }
+}
+
+
+//
+// mapscanner_id_or_keyword
+//
+// Returns the token id of the given identifier.
+//
+int mapscanner_id_or_keyword(const char* text, int length)
+{
+  return id_or_keyword(text, length);
+}
+
+
+//
+// mapscanner_use_kernel
+//
+// Selects the scanning kernel with the given name.
+//
+bool mapscanner_use_kernel(const char* name)
+{
+  if (!char_class_built)
+    build_char_class();
+
+  for (int i = 0; i < NUM_KERNELS; i++) {
+    if (strcmp(kernels[i].name, name) == 0 && kernel_supported(&kernels[i])) {
+      kernel = &kernels[i];
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+//
+// mapscanner_kernel
+//
+// Returns the name of the scanning kernel in use.
+//
+const char* mapscanner_kernel(void)
+{
+  if (kernel == NULL)
+    pick_kernel();
+
+  return kernel->name;
+}
+
+
+//
+// mapscanner_num_tokens
+//
+// Returns the number of tokens scanned so far.
+//
+long mapscanner_num_tokens(void)
+{
+  return num_tokens;
+}
+
+
+//
+// mapscanner_position
+//
+// Computes the line and column of the character at the given
+// offset, counting newlines from where the previous call left
+// off (or from the start, if the offset is before that).
+//
+void mapscanner_position(struct MappedSource* source, int offset, int* line, int* col)
+{
+  if (offset < source->line_offset) {
+    source->line_offset = 0;
+    source->line = 1;
+    source->line_start = 0;
+  }
+
+  const char* text = source->text;
+  int pos = source->line_offset;
+
+  for (;;) {
+    const char* eoln = (const char*)memchr(text + pos, '\n', offset - pos);
+    if (eoln == NULL)
+      break;
+
+    source->line++;
+    pos = (int)(eoln - text) + 1;
+    source->line_start = pos;
+  }
+
+  source->line_offset = offset;
+
+  *line = source->line;
+  *col = offset - source->line_start + 1;
+}
@@ -0,0 +1,155 @@
+/*mapscanner.h*/
+
+//
+// Memory-mapped scanner for nuPython. The source file is mapped
+// into memory and scanned in place: instead of copying each
+// lexeme into a buffer, a token refers to its value by offset
+// and length in the mapping. Line and column numbers are not
+// tracked while scanning, they are derived from a token's offset
+// when needed (see mapscanner_position).
+//
+// The tokens are the same as those of scanner_nextToken in
+// scanner.h, without its 256-character limit on a lexeme. Input
+// that can't be mapped, such as the keyboard, is read a line at
+// a time into a growable buffer instead (see mapscanner_create).
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stdbool.h>  // true, false
+
+#include "token.h"
+
+
+struct MappedSource
+{
+  const char* text;   // the mapped file (not '\0'-terminated)
+  int   size;         // in bytes
+  int   pos;          // offset of the next character to scan
+
+  char* buffer;       // non-NULL => text is this buffer, not a mapping
+  int   capacity;
+
+  //
+  // where mapscanner_position left off, positions are usually
+  // asked for in order:
+  //
+  int   line_offset;  // offset the line count below is for
+  int   line;         // line at line_offset (1-based)
+  int   line_start;   // offset of the first character of that line
+
+  int   warnings;     // # of warnings output while scanning
+};
+
+//
+// TokenView
+//
+// A token's value, as a view into the source text. For a string
+// literal, the value is the contents without the quotes, so the
+// token itself starts one character before offset. End-of-line
+// and end-of-stream have the values "EOLN" and "$", which are not
+// in the source; their views are the '\n' and the (empty) end.
+//
+struct TokenView
+{
+  int id;       // token id
+  int offset;   // value is text[offset .. offset+length)
+  int length;
+};
+
+
+//
+// Public functions:
+//
+
+//
+// mapscanner_open
+//
+// Maps the given file into memory and returns a scanner positioned
+// at its start. A file that isn't a regular one (a pipe, FIFO,
+// /dev/stdin, ...), reports a size of 0 (empty, or in /proc), or
+// is too large to map, is read to its end into a buffer instead,
+// as if by mapscanner_create and mapscanner_read_line. Returns NULL if the file cannot be opened
+// or mapped, or it holds more than INT_MAX bytes.
+//
+struct MappedSource* mapscanner_open(const char* filename);
+
+//
+// mapscanner_create
+//
+// Returns a scanner over an empty, growable buffer, for input
+// that is read as it comes, see mapscanner_read_line.
+//
+struct MappedSource* mapscanner_create(void);
+
+//
+// mapscanner_read_line
+//
+// Appends the next line of the given stream, however long, to the
+// scanner's buffer. Returns false, and appends nothing, at the end
+// of the stream, or once the buffer holds INT_MAX bytes. The buffer may move, so token views are offsets
+// rather than pointers.
+//
+bool mapscanner_read_line(struct MappedSource* source, FILE* input);
+
+//
+// mapscanner_close
+//
+// Unmaps the file (or frees the buffer) and frees the scanner.
+// Token views into the text are no longer valid afterwards.
+//
+void mapscanner_close(struct MappedSource* source);
+
+//
+// mapscanner_nextToken
+//
+// Scans the next token. Once the end of the file, or a $, is
+// reached, every call returns nuPy_EOS.
+//
+struct TokenView mapscanner_nextToken(struct MappedSource* source);
+
+//
+// mapscanner_id_or_keyword
+//
+// Returns the token id of the identifier text[0 .. length): the
+// keyword's token id if it is a keyword, else nuPy_IDENTIFIER.
+//
+int mapscanner_id_or_keyword(const char* text, int length);
+
+//
+// mapscanner_use_kernel
+//
+// The scanner skips blanks, comments and identifiers with the
+// fastest kernel the CPU supports: "avx2", "sse2" or "scalar"
+// (the vector kernels only on x86-64). Selects the kernel with
+// the given name instead, for testing and benchmarking. Returns
+// false, and changes nothing, if there is no such kernel or the
+// CPU doesn't support it.
+//
+bool mapscanner_use_kernel(const char* name);
+
+//
+// mapscanner_kernel
+//
+// Returns the name of the kernel in use.
+//
+const char* mapscanner_kernel(void);
+
+//
+// mapscanner_num_tokens
+//
+// Returns the number of tokens scanned so far, by all scanners,
+// including the nuPy_EOS at the end of each input. A scanner on
+// another thread (see tokenring.h) must have been stopped first.
+//
+long mapscanner_num_tokens(void);
+
+//
+// mapscanner_position
+//
+// Computes the (1-based) line and column of the character at the
+// given offset. Cheap when offsets are asked for in increasing
+// order, since the count continues from the previous call.
+//
+void mapscanner_position(struct MappedSource* source, int offset, int* line, int* col);
@@ -0,0 +1,142 @@
+/*nodemap.c*/
+
+//
+// A map from program graph nodes to ints, see nodemap.h.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>   // uintptr_t
+#include <assert.h>
+
+#include "nodemap.h"
+
+
+//
+// Private functions:
+//
+
+//
+// node_hash
+//
+// Hash of a node address (Fibonacci hashing, the low bits of a
+// node's address are always zero: nodes are malloc'd, or allocated
+// from an arena 8 bytes apart).
+//
+static unsigned int node_hash(void* node)
+{
+  uintptr_t p = (uintptr_t)node;
+  return (unsigned int)((p >> 3) * 2654435761u);
+}
+
+//
+// nodemap_find
+//
+// Returns the position in the table for the given node, either
+// the entry holding it or the empty entry where it goes.
+//
+static int nodemap_find(struct NODE_MAP* map, void* node)
+{
+  int mask = map->capacity - 1;
+  int pos = (int)(node_hash(node) & (unsigned int)mask);
+
+  while (map->entries[pos].node != NULL && map->entries[pos].node != node) {
+    pos = (pos + 1) & mask;
+  }
+  return pos;
+}
+
+//
+// nodemap_grow
+//
+// Doubles the size of the table.
+//
+static void nodemap_grow(struct NODE_MAP* map)
+{
+  struct NODE_MAP_ENTRY* old_entries = map->entries;
+  int old_capacity = map->capacity;
+
+  map->capacity = old_capacity * 2;
+  map->entries = (struct NODE_MAP_ENTRY*)calloc(map->capacity, sizeof(struct NODE_MAP_ENTRY));
+
+  for (int i = 0; i < old_capacity; i++) {
+    if (old_entries[i].node != NULL) {
+      int pos = nodemap_find(map, old_entries[i].node);
+      map->entries[pos] = old_entries[i];
+    }
+  }
+  free(old_entries);
+}
+
+
+//
+// Public functions:
+//
+
+//
+// nodemap_init
+//
+// Returns a new, empty node map.
+//
+struct NODE_MAP* nodemap_init(void)
+{
+  struct NODE_MAP* map = (struct NODE_MAP*)malloc(sizeof(struct NODE_MAP));
+
+  map->capacity = 16;
+  map->num_entries = 0;
+  map->entries = (struct NODE_MAP_ENTRY*)calloc(map->capacity, sizeof(struct NODE_MAP_ENTRY));
+
+  return map;
+}
+
+
+//
+// nodemap_put
+//
+// Maps the given node to the given value. The table is kept at
+// most half full.
+//
+void nodemap_put(struct NODE_MAP* map, void* node, int value)
+{
+  assert(node != NULL);
+
+  int pos = nodemap_find(map, node);
+
+  if (map->entries[pos].node == NULL) {
+    map->entries[pos].node = node;
+    map->num_entries++;
+  }
+  map->entries[pos].value = value;
+
+  if (map->num_entries * 2 > map->capacity) {
+    nodemap_grow(map);
+  }
+}
+
+
+//
+// nodemap_get
+//
+// Returns the value of the given node, or -1 if absent.
+//
+int nodemap_get(struct NODE_MAP* map, void* node)
+{
+  int pos = nodemap_find(map, node);
+
+  if (map->entries[pos].node == NULL)
+    return -1;
+
+  return map->entries[pos].value;
+}
+
+
+//
+// nodemap_destroy
+//
+// Frees the memory associated with the map.
+//
+void nodemap_destroy(struct NODE_MAP* map)
+{
+  free(map->entries);
+  free(map);
+}
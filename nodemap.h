@@ -0,0 +1,62 @@
+/*nodemap.h*/
+
+//
+// A map from nodes of the program graph to ints. The graph nodes
+// are allocated by the program graph module, and their structs
+// can't grow new fields, so passes that need to remember something
+// per node (the slot of an identifier, the specialized operator
+// of an expression, ...) keep it on the side in a node map.
+//
+// The map is an open-addressing hash table keyed by node address.
+//
+
+#pragma once
+
+
+struct NODE_MAP_ENTRY
+{
+  void* node;  // NULL => empty entry
+  int   value;
+};
+
+struct NODE_MAP
+{
+  struct NODE_MAP_ENTRY* entries;
+  int num_entries;
+  int capacity;  // always a power of 2
+};
+
+
+//
+// Public functions:
+//
+
+//
+// nodemap_init
+//
+// Returns a new, empty node map.
+//
+struct NODE_MAP* nodemap_init(void);
+
+//
+// nodemap_put
+//
+// Maps the given node to the given value, replacing the value
+// the node had, if any.
+//
+void nodemap_put(struct NODE_MAP* map, void* node, int value);
+
+//
+// nodemap_get
+//
+// Returns the value of the given node, or -1 if the node is not
+// in the map.
+//
+int nodemap_get(struct NODE_MAP* map, void* node);
+
+//
+// nodemap_destroy
+//
+// Frees the memory associated with the map (not the nodes).
+//
+void nodemap_destroy(struct NODE_MAP* map);
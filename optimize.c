@@ -0,0 +1,291 @@
+/*optimize.c*/
+
+//
+// Optimization pass over the nuPython program graph: constant
+// folding and removal of dead statements, see optimize.h.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+#include <math.h>     // isfinite
+#include <assert.h>
+
+#include "programgraph.h"
+#include "arena.h"
+#include "ram.h"
+#include "values.h"
+#include "optimize.h"
+
+
+//
+// Private functions:
+//
+
+//
+// next_link
+//
+// Returns the address of the given statement's next_stmt field,
+// which lives in a different struct for each kind of statement.
+//
+static struct STMT** next_link(struct STMT* stmt)
+{
+  switch (stmt->stmt_type) {
+    case STMT_ASSIGNMENT:
+      return &stmt->types.assignment->next_stmt;
+    case STMT_FUNCTION_CALL:
+      return &stmt->types.function_call->next_stmt;
+    case STMT_WHILE_LOOP:
+      return &stmt->types.while_loop->next_stmt;
+    default:
+      assert(stmt->stmt_type == STMT_PASS);
+      return &stmt->types.pass->next_stmt;
+  }
+}
+
+//
+// literal_operand
+//
+// If the given operand is a plain literal (no unary operator),
+// stores its value in *value and returns true.
+//
+static bool literal_operand(struct UNARY_EXPR* operand, struct RAM_VALUE* value)
+{
+  if (operand == NULL || operand->expr_type != UNARY_ELEMENT)
+    return false;
+
+  if (!parse_literal(operand->element, value))
+    return false;  // out of range, resolve_program reports it
+
+  return value->value_type != RAM_TYPE_NONE;
+}
+
+//
+// is_numeric
+//
+static bool is_numeric(struct RAM_VALUE* value)
+{
+  return value->value_type == RAM_TYPE_INT || value->value_type == RAM_TYPE_REAL;
+}
+
+//
+// can_fold
+//
+// Returns true if lhs <operator> rhs is guaranteed to succeed,
+// i.e. execute_binary_expression won't report an error (or, for
+// % by zero, crash) when it is computed.
+//
+static bool can_fold(struct RAM_VALUE* lhs, int operator, struct RAM_VALUE* rhs)
+{
+  if (is_numeric(lhs) && is_numeric(rhs)) {
+    bool rhs_zero = (rhs->value_type == RAM_TYPE_INT) ? (rhs->types.i == 0) : (rhs->types.d == 0.0);
+
+    if ((operator == OPERATOR_DIV || operator == OPERATOR_MOD) && rhs_zero)
+      return false;
+
+    int power;
+
+    if (operator == OPERATOR_POWER && lhs->value_type == RAM_TYPE_INT && rhs->value_type == RAM_TYPE_INT &&
+        !int_power(lhs->types.i, rhs->types.i, &power))
+      return false;
+
+    return operator <= OPERATOR_GTE;  // not is, in
+  }
+
+  if (lhs->value_type == RAM_TYPE_STR && rhs->value_type == RAM_TYPE_STR)
+    return operator == OPERATOR_PLUS || is_rel_op(operator);
+
+  return false;
+}
+
+//
+// set_literal
+//
+// Turns the given element into a literal holding the given value.
+// The element gets a copy of the string in *result, if any (from
+// the arena, if there is one), and the result's string is released.
+// Returns false (and leaves the element alone) if the value can't
+// be written as a literal.
+//
+static bool set_literal(struct ELEMENT* element, struct TEMP_VALUE* result, struct ARENA* arena)
+{
+  char buffer[64];
+  char* text;
+  int type;
+
+  switch (result->value.value_type) {
+    case RAM_TYPE_INT:
+      sprintf(buffer, "%d", result->value.types.i);
+      type = ELEMENT_INT_LITERAL;
+      break;
+    case RAM_TYPE_REAL:
+      if (!isfinite(result->value.types.d))
+        return false;
+      sprintf(buffer, "%.17g", result->value.types.d);  // exact round trip
+      type = ELEMENT_REAL_LITERAL;
+      break;
+    case RAM_TYPE_BOOLEAN:
+      strcpy(buffer, result->value.types.i ? "True" : "False");
+      type = result->value.types.i ? ELEMENT_TRUE : ELEMENT_FALSE;
+      break;
+    case RAM_TYPE_STR:
+      assert(result->owns_str);
+      if (arena != NULL) {
+        element->element_value = arena_strdup(arena, result->value.types.s);
+        release_value(result);
+      }
+      else {
+        free(element->element_value);
+        element->element_value = (char*)malloc((strlen(result->value.types.s) + 1) * sizeof(char));
+        strcpy(element->element_value, result->value.types.s);
+        release_value(result);
+      }
+      element->element_type = ELEMENT_STR_LITERAL;
+      return true;
+    default:
+      return false;
+  }
+
+  if (arena != NULL)
+    text = arena_strdup(arena, buffer);
+  else {
+    text = (char*)malloc(strlen(buffer) + 1);
+    strcpy(text, buffer);
+
+    free(element->element_value);
+  }
+
+  element->element_value = text;
+  element->element_type = type;
+  return true;
+}
+
+//
+// fold_expr
+//
+// Folds the given expression into a single literal if both of its
+// operands are literals and the operation can't fail at runtime.
+//
+static void fold_expr(struct EXPR* expr, struct ARENA* arena)
+{
+  struct RAM_VALUE lhs, rhs;
+  struct TEMP_VALUE result;
+
+  if (!expr->isBinaryExpr)
+    return;
+
+  if (!literal_operand(expr->lhs, &lhs) || !literal_operand(expr->rhs, &rhs))
+    return;
+
+  if (!can_fold(&lhs, expr->operator, &rhs))
+    return;
+
+  bool success = execute_binary_expression(&lhs, expr->operator, &rhs, &result, 0);
+  assert(success);
+
+  if (!set_literal(expr->lhs->element, &result, arena)) {
+    release_value(&result);
+    return;
+  }
+
+  //
+  // the rhs is gone, free it like programgraph_destroy would (it
+  // stays in the arena otherwise):
+  //
+  if (arena == NULL) {
+    free(expr->rhs->element->element_value);
+    free(expr->rhs->element);
+    free(expr->rhs);
+  }
+
+  expr->rhs = NULL;
+  expr->isBinaryExpr = false;
+  expr->operator = OPERATOR_NO_OP;
+}
+
+//
+// is_false
+//
+// Returns true if the given (folded) expression is the literal False.
+//
+static bool is_false(struct EXPR* expr)
+{
+  return !expr->isBinaryExpr &&
+         expr->lhs->expr_type == UNARY_ELEMENT &&
+         expr->lhs->element->element_type == ELEMENT_FALSE;
+}
+
+//
+// optimize_stmts
+//
+// Optimizes the chain of statements starting at stmt, stopping at
+// the end of the program (NULL) or when the chain loops back to
+// the given while loop header (the end of a loop body). Returns the
+// first statement of the optimized chain; for a loop body that is
+// now empty, that is the loop header itself.
+//
+static struct STMT* optimize_stmts(struct STMT* stmt, struct STMT* loop_header, struct ARENA* arena)
+{
+  struct STMT* first = stmt;
+  struct STMT** link = &first;  // the pointer to the current stmt
+
+  while (*link != NULL && *link != loop_header) {
+    stmt = *link;
+
+    bool remove = false;
+
+    if (stmt->stmt_type == STMT_ASSIGNMENT) {
+      struct VALUE* rhs = stmt->types.assignment->rhs;
+
+      if (rhs->value_type == VALUE_EXPR)
+        fold_expr(rhs->types.expr, arena);
+    }
+    else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+      struct STMT_WHILE_LOOP* loop = stmt->types.while_loop;
+
+      fold_expr(loop->condition, arena);
+
+      if (is_false(loop->condition))
+        remove = true;
+      else
+        loop->loop_body = optimize_stmts(loop->loop_body, stmt, arena);
+    }
+    else if (stmt->stmt_type == STMT_PASS) {
+      remove = true;
+    }
+
+    if (remove) {
+      //
+      // unlink the stmt, and free it (along with the body of a
+      // loop) by destroying it as a program of its own, unless
+      // it's in the arena:
+      //
+      *link = *next_link(stmt);
+      *next_link(stmt) = NULL;
+      if (arena == NULL)
+        programgraph_destroy(stmt);
+    }
+    else {
+      link = next_link(stmt);
+    }
+  }
+
+  return first;
+}
+
+
+//
+// Public functions:
+//
+
+//
+// optimize_program
+//
+// Folds constant expressions and removes dead statements, see
+// optimize.h. Returns the first statement of the program.
+//
+struct STMT* optimize_program(struct STMT* program, struct ARENA* arena)
+{
+  return optimize_stmts(program, NULL, arena);
+}
@@ -0,0 +1,40 @@
+/*optimize.h*/
+
+//
+// Optimization pass over the nuPython program graph, run after
+// the graph is built and before identifiers are resolved.
+//
+
+#pragma once
+
+#include "programgraph.h"
+#include "arena.h"
+
+
+//
+// Public functions:
+//
+
+//
+// optimize_program
+//
+// Optimizes the given program graph in place:
+//
+//   - a binary expression whose operands are both literals, such
+//     as 60 * 60, is folded into a single literal;
+//   - a while loop whose condition is the constant False is
+//     removed, along with its body;
+//   - pass statements are removed.
+//
+// An expression that would fail at runtime (e.g. division by zero,
+// or invalid operand types) is left alone, so the error is still
+// reported when the statement executes, with its line number.
+//
+// If the graph was allocated from an arena (see parser_build), pass
+// the arena: new literals are allocated from it, and removed nodes
+// are left for arena_destroy. Otherwise pass NULL, and removed nodes
+// are freed. Returns the first statement of the optimized program,
+// which may differ from the given one, and is NULL if nothing is
+// left.
+//
+struct STMT* optimize_program(struct STMT* program, struct ARENA* arena);
@@ -0,0 +1,122 @@
+/*output.c*/
+
+//
+// Output of nuPython programs, see output.h.
+//
+
+// fwrite_unlocked, putchar_unlocked
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+
+#include "dtoa.h"
+#include "output.h"
+
+
+//
+// stdout's buffer, if given one; never freed, since stdout uses it
+// until exit:
+//
+static char* buffer = NULL;
+
+
+//
+// Public functions:
+//
+
+//
+// output_init
+//
+// Gives stdout a buffer of the given size.
+//
+void output_init(int size)
+{
+  if (size <= 0)
+    return;
+
+  buffer = (char*)malloc(size * sizeof(char));
+
+  if (buffer == NULL || setvbuf(stdout, buffer, _IOFBF, size) != 0) {
+    free(buffer);  // keep the C library's buffering
+    buffer = NULL;
+  }
+}
+
+
+//
+// output_str
+//
+// Outputs the string. Only the main thread outputs, so stdout
+// isn't locked for each call.
+//
+void output_str(const char* s)
+{
+  fwrite_unlocked(s, 1, strlen(s), stdout);
+}
+
+
+//
+// output_int
+//
+// Outputs the integer, in decimal.
+//
+void output_int(int i)
+{
+  char digits[16];
+  char* end = digits + sizeof(digits);
+  char* p = end;
+
+  //
+  // the magnitude as unsigned, so INT_MIN works too:
+  //
+  unsigned int n = (i < 0) ? 0u - (unsigned int)i : (unsigned int)i;
+
+  do {
+    *--p = (char)('0' + n % 10);
+    n /= 10;
+  } while (n > 0);
+
+  if (i < 0)
+    *--p = '-';
+
+  fwrite_unlocked(p, 1, end - p, stdout);
+}
+
+
+//
+// output_real
+//
+// Outputs the real, in the selected format.
+//
+void output_real(double d)
+{
+  char digits[DTOA_BUFFER_SIZE];
+  int length = dtoa_format(d, digits);
+
+  fwrite_unlocked(digits, 1, length, stdout);
+}
+
+
+//
+// output_newline
+//
+// Outputs a newline.
+//
+void output_newline(void)
+{
+  putchar_unlocked('\n');
+}
+
+
+//
+// output_flush
+//
+// Writes out whatever is buffered.
+//
+void output_flush(void)
+{
+  fflush(stdout);
+}
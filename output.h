@@ -0,0 +1,75 @@
+/*output.h*/
+
+//
+// Output of nuPython programs. stdout is given a buffer of its own,
+// of a configurable size, and is fully buffered whether it's a file,
+// a pipe or a terminal, so a program that prints line after line
+// makes one write per buffer full rather than one per line. Since
+// it's stdout's buffer, everything else output with printf (error
+// messages, the memory print) stays in order with print()'s output.
+//
+// The buffer is flushed when full, when the program asks for input
+// (the prompt must be seen first), when the program stops, done or
+// on an error, and at exit.
+//
+// print() writes ints, strings and booleans directly, and formats
+// reals with dtoa.h; none of them go through printf.
+//
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+
+
+#define OUTPUT_DEFAULT_SIZE  (64 * 1024)  // bytes
+
+
+//
+// Public functions:
+//
+
+//
+// output_init
+//
+// Gives stdout a buffer of the given size, in bytes; with size 0,
+// stdout is left buffered the way the C library chooses (by line
+// on a terminal). Must be called before anything is output. The
+// buffer lasts until exit.
+//
+void output_init(int size);
+
+//
+// output_str
+//
+// Outputs the given string.
+//
+void output_str(const char* s);
+
+//
+// output_int
+//
+// Outputs the given integer, in decimal.
+//
+void output_int(int i);
+
+//
+// output_real
+//
+// Outputs the given real, in the format selected with
+// dtoa_set_format (see dtoa.h).
+//
+void output_real(double d);
+
+//
+// output_newline
+//
+// Outputs a newline.
+//
+void output_newline(void);
+
+//
+// output_flush
+//
+// Writes out whatever is buffered.
+//
+void output_flush(void);
@@ -1,867 +1,1210 @@
-/*parser.c*/
-
-//
-// Recursive-descent parsing functions for nuPython programming language.
-// The parser is responsible for checking if the input follows the syntax
-// ("grammar") rules of nuPython. If successful, a copy of the tokens is
-// returned so the program can be analyzed and executed.
-//
-
-#include <stdio.h>
-#include <stdlib.h>
-#include <stdbool.h>  // true, false
-#include <assert.h>
-
-#include "token.h"
-#include "tokenqueue.h"
-#include "scanner.h"
-#include "parser.h"
-
-
-//
-// declarations of private functions:
-//
-static void errorMsg(char* expecting, char* value, struct Token found);
-static bool match(struct TokenQueue* tokens, int expectedID, char* expectedValue);
-
-static bool parser_expr(struct TokenQueue* tokens);
-static bool parser_body(struct TokenQueue* tokens);
-static bool parser_else(struct TokenQueue* tokens);
-
-static bool parser_if_then_else(struct TokenQueue* tokens);
-static bool parser_pass_stmt(struct TokenQueue* tokens);
-static bool parser_empty_stmt(struct TokenQueue* tokens);
-static bool startOfStmt(struct TokenQueue* tokens);
-static bool parser_stmt(struct TokenQueue* tokens);
-static bool parser_stmts(struct TokenQueue* tokens);
-static bool parser_program(struct TokenQueue* tokens);
-
-// declarations of more that I create 
-
-static bool parser_op(struct TokenQueue* tokens);
-static bool parser_unary_expr(struct TokenQueue* tokens);
-static bool parser_element(struct TokenQueue* tokens);
-static bool parser_function_call(struct TokenQueue* tokens);
-static bool parser_value(struct TokenQueue* tokens);
-static bool parser_while_loop(struct TokenQueue* tokens);
-static bool parser_assignment(struct TokenQueue* tokens);
-static bool parser_call_stmt(struct TokenQueue* tokens);
-
-
-//
-// errorMsg:
-//
-// Outputs a properly-formatted syntax error message of the form
-// "expecting X, found Y".
-//
-static void errorMsg(char* expecting, char* value, struct Token found)
-{
-  printf("**SYNTAX ERROR @ (%d,%d): expecting %s, found '%s'\n",
-    found.line, found.col, expecting, value);
-}
-
-
-//
-// match
-//
-// Checks to see if the token at the front of the queue matches
-// the exectedID. If so, the token is removed from the queue and
-// true is returned. If not, an error message is output and false
-// is returned.
-// 
-// If false is returned, the error message output is of the form
-// "expecting X, found Y" where X is the value of the expected 
-// token and Y is the expectedValue passed in. 
-//
-static bool match(struct TokenQueue* tokens, int expectedID, char* expectedValue)
-{
-  //
-  // does the token match the expected token?
-  //
-  struct Token curToken = tokenqueue_peekToken(tokens);
-  char* curValue = tokenqueue_peekValue(tokens);
-
-  if (curToken.id != expectedID)  // no, => error
-  {
-    errorMsg(expectedValue, curValue, curToken);
-    return false;
-  }
-
-  //
-  // yes, it matched, so discard and return true:
-  //
-  tokenqueue_dequeue(tokens);
-
-  return true;
-}
-
-
-// 
-// <element> ::= INDENTIFIER, INT_LITERAL, REAL_LITERAL, STR_LITERAL, True, False, None
-// 
-
-static bool parser_element(struct TokenQueue* tokens)
-{
-  struct Token curToken = tokenqueue_peekToken(tokens);
-
-  if (curToken.id == nuPy_IDENTIFIER)
-  {
-    return match(tokens, nuPy_IDENTIFIER, "IDENTIFIER");
-  }
-
-  else if (curToken.id == nuPy_INT_LITERAL)
-  {
-    return match(tokens, nuPy_INT_LITERAL, "INT_LITERAL");
-  }
-
-  else if (curToken.id == nuPy_REAL_LITERAL)
-  {
-    return match(tokens, nuPy_REAL_LITERAL, "REAL_LITERAL");
-  }
-
-  else if (curToken.id == nuPy_STR_LITERAL)
-  {
-    return match(tokens, nuPy_STR_LITERAL, "STR_LITERAL");
-  }
-
-  else if (curToken.id == nuPy_KEYW_TRUE)
-  {
-    return match(tokens, nuPy_KEYW_TRUE, "true");
-  }
-
-  else if (curToken.id == nuPy_KEYW_FALSE)
-  {
-    return match(tokens, nuPy_KEYW_FALSE, "false");
-  }
-  
-  else if (curToken.id == nuPy_KEYW_NONE)
-  {
-    return match(tokens, nuPy_KEYW_NONE, "None");
-  }
-  errorMsg("element", "not an element", curToken);
-  return false;
-
-
-}
-
-/*
-<unary_expr> ::= '*' IDENTIFIER 
-                | '&' IDENTIFIER 
-                | '+' [IDENTIFIER | INT_LITERAL | REAL_LITERAL]
-                | '-' [IDENTIFIER | INT_LITERAL | REAL_LITERAL]
-                |<element>
-*/
-
-
-static bool parser_unary_expr(struct TokenQueue* tokens)
-{
-
-  struct Token curToken = tokenqueue_peekToken(tokens);
-  char* curValue = tokenqueue_peekValue(tokens);
-  //'*' IDENTIFIER 
-  if (curToken.id == nuPy_ASTERISK)
-  {
-    if (!match(tokens, nuPy_ASTERISK, "*"))
-      return false;
-    if (!match(tokens, nuPy_IDENTIFIER, "IDENTIFIER"))
-      return false;
-    return true;
-  }
-  //'&' IDENTIFIER 
-  else if (curToken.id == nuPy_AMPERSAND)
-  {
-    if (!match(tokens, nuPy_AMPERSAND, "&"))
-      return false;
-    if (!match(tokens, nuPy_IDENTIFIER, "IDENTIFIER"))
-      return false;
-    return true;
-  }
-  //'+' [IDENTIFIER | INT_LITERAL | REAL_LITERAL]
-  else if (curToken.id == nuPy_PLUS)
-  {
-    if (!match(tokens, nuPy_PLUS, "+"))
-      return false;
-    struct Token nextToken = tokenqueue_peekToken(tokens);
-    char* nextValue = tokenqueue_peekValue(tokens);
-
-    if (nextToken.id == nuPy_IDENTIFIER)
-    {
-      return match(tokens, nuPy_IDENTIFIER, "IDENTIFIER");
-    }
-    else if (nextToken.id == nuPy_INT_LITERAL)
-    {
-      return match(tokens, nuPy_INT_LITERAL, "INT_LITERAL");
-
-    } 
-    else if (nextToken.id == nuPy_REAL_LITERAL)
-    {
-      return match(tokens, nuPy_REAL_LITERAL, "REAL_LITERAL");
-    }
-    else 
-    {
-      errorMsg("identifier or numberic literal", nextValue, nextToken);
-      return false;
-    }
-  }
-  //'-' [IDENTIFIER | INT_LITERAL | REAL_LITERAL]
-  else if (curToken.id == nuPy_MINUS)
-  {
-    if (!match(tokens, nuPy_MINUS, "-"))
-      return false;
-    struct Token nextToken = tokenqueue_peekToken(tokens);
-    char* nextValue = tokenqueue_peekValue(tokens);
-
-
-     if (nextToken.id == nuPy_IDENTIFIER)
-    {
-      return match(tokens, nuPy_IDENTIFIER, "IDENTIFIER");
-    }
-    else if (nextToken.id == nuPy_INT_LITERAL)
-    {
-      return match(tokens, nuPy_INT_LITERAL, "INT_LITERAL");
-    } 
-    else if (nextToken.id == nuPy_REAL_LITERAL)
-    {
-      return match(tokens, nuPy_REAL_LITERAL, "REAL_LITERAL");
-    }
-    else 
-    {
-      errorMsg("identifier or numberic literal", nextValue, nextToken);
-      return false;
-    }
-  }
-  //<element>
-  else if (curToken.id == nuPy_IDENTIFIER 
-      || curToken.id == nuPy_INT_LITERAL 
-      || curToken.id == nuPy_REAL_LITERAL 
-      || curToken.id == nuPy_STR_LITERAL 
-      || curToken.id == nuPy_KEYW_TRUE 
-      || curToken.id == nuPy_KEYW_FALSE 
-      || curToken.id == nuPy_KEYW_NONE)
-  {
-    return parser_element(tokens);
-  }
-  errorMsg("unary expression", "nothing", curToken);
-  return false;
-}
-
-//create parser_element - done
-
-
-// 
-// <op> ::= + | - | * | ** | % | / | == | != | < | <= | > | >= | is | in
-//
-
-static bool parser_op(struct TokenQueue* tokens)
-{
-  struct Token curToken = tokenqueue_peekToken(tokens);
-
-  if (curToken.id == nuPy_PLUS)
-  {
-    return match(tokens, nuPy_PLUS, "+");
-  }
-
-  else if (curToken.id == nuPy_MINUS)
-  {
-    return match(tokens, nuPy_MINUS, "-");
-  }
-
-  else if (curToken.id == nuPy_ASTERISK)
-  {
-    return match(tokens, nuPy_ASTERISK, "*");
-  }
-
-  else if (curToken.id == nuPy_POWER)
-  {
-    return match(tokens, nuPy_POWER, "**");
-  }
-
-  else if (curToken.id == nuPy_PERCENT)
-  {
-    return match(tokens, nuPy_PERCENT, "%%");
-  }
-
-  else if (curToken.id == nuPy_SLASH)
-  {
-    return match(tokens, nuPy_SLASH, "/");
-  }
-
-  else if (curToken.id == nuPy_EQUALEQUAL)
-  {
-    return match(tokens, nuPy_EQUALEQUAL, "==");
-  }
-
-  else if (curToken.id == nuPy_NOTEQUAL)
-  {
-    return match(tokens, nuPy_NOTEQUAL, "!=");
-  }
-
-  else if (curToken.id == nuPy_LT)
-  {
-    return match(tokens, nuPy_LT, "<");
-  }
-  else if (curToken.id == nuPy_LTE)
-  {
-    return match(tokens, nuPy_LTE, "<=");
-  }
-  else if (curToken.id == nuPy_GT)
-  {
-    return match(tokens, nuPy_GT, ">");
-  }
-  else if (curToken.id == nuPy_GTE)
-  {
-    return match(tokens, nuPy_GTE, ">=");
-  }
-  else if (curToken.id == nuPy_KEYW_IS)
-  {
-    return match(tokens, nuPy_KEYW_IS, "is");
-  }
-  else if (curToken.id == nuPy_KEYW_IN)
-  {
-    return match(tokens, nuPy_KEYW_IN, "in");
-  }
-  errorMsg("op", "other", curToken);
-  return false;
-}
-
-
-
-
-//
-// <expr> ::= <unary_expr> [<op> <unary_expr>]
-//
-
-static bool parser_expr(struct TokenQueue* tokens)
-{
-  //
-  // TODO: done?
-  //
-  // does the unary_expr match?
-  if (!parser_unary_expr(tokens)) 
-    return false;
-
-  //make a struct to peek at the next token; does it have an op? 
-  struct Token curToken = tokenqueue_peekToken(tokens);
-
-  if (curToken.id == nuPy_PLUS || 
-      curToken.id == nuPy_MINUS || 
-      curToken.id == nuPy_ASTERISK || 
-      curToken.id == nuPy_POWER || 
-      curToken.id == nuPy_PERCENT || 
-      curToken.id == nuPy_SLASH || 
-      curToken.id == nuPy_EQUALEQUAL || 
-      curToken.id == nuPy_NOTEQUAL || 
-      curToken.id == nuPy_LT || 
-      curToken.id == nuPy_LTE || 
-      curToken.id == nuPy_GT || 
-      curToken.id == nuPy_GTE || 
-      curToken.id == nuPy_KEYW_IS || 
-      curToken.id == nuPy_KEYW_IN )
-  //if op it should also have unary expr
-  {
-    if (!parser_op(tokens))
-      return false;
-    if (!parser_unary_expr(tokens))
-      return false;
-    return true;
-  }
-  //else just return true
-
-  return true;
-
-}
-  
-
-// create parser_unary_expr - yes
-// create parser_op - yes
-
-
-
-
-
-//
-// <body> ::= '{' EOLN <stmts> '}' EOLN
-//
-
-static bool parser_body(struct TokenQueue* tokens)
-{
-  //
-  // TODO: done?
-  //
-  if (!match(tokens, nuPy_LEFT_BRACE, "{"))
-    return false;
-  if (!match(tokens, nuPy_EOLN, "EOLN"))
-    return false;
-  if (!parser_stmts(tokens))
-    return false;
-  if (!match(tokens, nuPy_RIGHT_BRACE, "}"))
-    return false;
-  if (!match(tokens, nuPy_EOLN, "EOLN"))
-    return false;
-  return true;
-}
-
-
-//
-// <else> ::= elif <expr> ':' EOLN <body> [<else>]
-//          | else ':' EOLN <body>
-//
-static bool parser_else(struct TokenQueue* tokens)
-{
-  //
-  // TODO: done
-  //
-
-  struct Token curToken = tokenqueue_peekToken(tokens);
-
-  if (curToken.id == nuPy_KEYW_ELIF)
-  {
-    if (!match(tokens, nuPy_KEYW_ELIF, "ELIF"))
-      return false;
-    if (!parser_expr(tokens))
-      return false;
-    if (!match(tokens, nuPy_COLON, ":"))
-      return false;
-    if (!match(tokens, nuPy_EOLN, "EOLN"))
-      return false;
-    if(!parser_body(tokens))
-      return false;
-    struct Token nextToken = tokenqueue_peekToken(tokens);
-    if (nextToken.id == nuPy_KEYW_ELSE || nextToken.id == nuPy_KEYW_ELIF)
-    {
-      if (!parser_else(tokens))
-        return false;
-    }
-  }
-  if (curToken.id == nuPy_KEYW_ELSE)
-  {
-    if (!match(tokens, nuPy_KEYW_ELSE, "ELSE"))
-      return false;
-    if (!match(tokens, nuPy_COLON, ":"))
-      return false;
-    if (!match(tokens, nuPy_EOLN, "EOLN"))
-      return false;
-    if (!parser_body(tokens))
-      return false; 
-  }
-  return true;
-}
-
-
-//
-// <if_then_else> ::= if <expr> ':' EOLN <body> [<else>]
-//
-static bool parser_if_then_else(struct TokenQueue* tokens)
-{
-  if (!match(tokens, nuPy_KEYW_IF, "if"))
-    return false;
-
-  if (!parser_expr(tokens))
-    return false;
-
-  if (!match(tokens, nuPy_COLON, ":"))
-    return false;
-
-  if (!match(tokens, nuPy_EOLN, "EOLN"))
-    return false;
-
-  if (!parser_body(tokens))
-    return false;
-
-  //
-  // is the optional <else> present?
-  //
-  struct Token curToken = tokenqueue_peekToken(tokens);
-
-  if (curToken.id == nuPy_KEYW_ELIF || curToken.id == nuPy_KEYW_ELSE)
-  {
-    bool result = parser_else(tokens);
-    return result;
-  }
-  else
-  {
-    // <else> is optional, missing => do nothing and return success:
-    return true;
-  }
-}
-
-
-// 
-// <pass_stmt> ::= pass EOLN
-//
-static bool parser_pass_stmt(struct TokenQueue* tokens)
-{
-  if (!match(tokens, nuPy_KEYW_PASS, "pass"))
-    return false;
-
-  if (!match(tokens, nuPy_EOLN, "EOLN"))
-    return false;
-
-  return true;
-}
-
-
-// 
-// <empty_stmt> ::= EOLN
-//
-static bool parser_empty_stmt(struct TokenQueue* tokens)
-{
-  if (!match(tokens, nuPy_EOLN, "EOLN"))
-    return false;
-
-  return true;
-}
-
-
-//
-// startOfStmt
-//
-// Returns true if the next token denotes the start of a stmt,
-// and false if not.
-//
-static bool startOfStmt(struct TokenQueue* tokens)
-{
-  struct Token curToken = tokenqueue_peekToken(tokens);
-
-  //
-  // TODO: this is not complete.
-  //
-
-  if (curToken.id == nuPy_KEYW_PASS ||
-      curToken.id == nuPy_EOLN ||
-      curToken.id == nuPy_KEYW_IF || 
-      curToken.id == nuPy_KEYW_WHILE ||
-      curToken.id == nuPy_ASTERISK ||
-      curToken.id == nuPy_IDENTIFIER || 
-      curToken.id == nuPy_INT_LITERAL || 
-      curToken.id == nuPy_REAL_LITERAL || 
-      curToken.id == nuPy_STR_LITERAL || 
-      curToken.id == nuPy_KEYW_TRUE || 
-      curToken.id == nuPy_KEYW_FALSE || 
-      curToken.id == nuPy_KEYW_NONE)
-      {
-    return true;
-  }
-  else {
-    return false;
-  }
-}
-
-
-//
-// <stmt> ::= <assignment>
-//          | <if_then_else>
-//          | <while_loop>
-//          | <call_stmt>
-//          | <pass_stmt>
-//          | <empty_stmt>
-//
-static bool parser_stmt(struct TokenQueue* tokens)
-{
-  //
-  // TODO: for now we just accept a program consisting of a
-  // single "pass" or "empty" statement.
-  //
-  if (!startOfStmt(tokens)) {
-    struct Token curToken = tokenqueue_peekToken(tokens);
-    char* curValue = tokenqueue_peekValue(tokens);
-
-    errorMsg("start of a statement", curValue, curToken);
-    return false;
-  }
-
-  //
-  // we have the start of a stmt, but which one?
-  //
-  struct Token curToken = tokenqueue_peekToken(tokens);
-  struct Token peekNext = tokenqueue_peek2Token(tokens);
-  char* curValue = tokenqueue_peekValue(tokens);
-
-  if (curToken.id == nuPy_KEYW_PASS) {
-    bool result = parser_pass_stmt(tokens);
-    return result;
-  }
-  else if (curToken.id == nuPy_EOLN) {
-    bool result = parser_empty_stmt(tokens);
-    return result;
-  }
-  else if (curToken.id == nuPy_KEYW_IF) {
-    bool result = parser_if_then_else(tokens);
-    return result;
-  }
-  else if (curToken.id == nuPy_KEYW_WHILE) {
-    bool result = parser_while_loop(tokens);
-    return result;
-  }
-  else if (curToken.id == nuPy_ASTERISK && peekNext.id == nuPy_IDENTIFIER){
-    bool result = parser_assignment(tokens);
-    return result;
-  }
-   else if (curToken.id == nuPy_IDENTIFIER && peekNext.id == nuPy_EQUAL){
-    bool result = parser_assignment(tokens);
-    return result;
-  }
-  else if (curToken.id == nuPy_IDENTIFIER && peekNext.id == nuPy_LEFT_PAREN){
-    bool result = parser_call_stmt(tokens);
-    return result;
-  }
-  else if (curToken.id == nuPy_IDENTIFIER){
-    errorMsg("assignment or function call", curValue, curToken);
-    return false;
-  }
-  
-  else {
-    printf("**INTERNAL ERROR: unknown stmt (parser_stmt)\n"); 
-    //errorMsg("assignment or function call", curValue, curToken);
-    return false;
-  }
-}
-
-
-
-//
-// <stmts> ::= <stmt> [<stmts>]
-//
-static bool parser_stmts(struct TokenQueue* tokens)
-{
-  //
-  // TODO: for now we just accept a program consisting of a
-  // single statement.
-  //
-  if (!parser_stmt(tokens))
-    return false;
-
-  struct Token curToken = tokenqueue_peekToken(tokens);
-
-  if (curToken.id == nuPy_ASTERISK 
-      || curToken.id == nuPy_IDENTIFIER 
-      || curToken.id == nuPy_KEYW_IF 
-      || curToken.id == nuPy_KEYW_WHILE 
-      || curToken.id == nuPy_KEYW_PASS 
-      || curToken.id == nuPy_EOLN)
-  {
-    bool result = parser_stmts(tokens);
-    return result;
-  }
-
-  return true;
-}
-
-
-//
-// <program> ::= <stmts> EOS
-//
-static bool parser_program(struct TokenQueue* tokens)
-{
-  if (!parser_stmts(tokens))
-    return false;
-
-  if (!match(tokens, nuPy_EOS, "$"))
-    return false;
-
-  return true;
-}
-
-
-//
-//<call_stmt> ::= <function_call> EOLN
-//
-static bool parser_call_stmt(struct TokenQueue* tokens)
-{
-  if(!parser_function_call(tokens))
-    return false;
-  if(!match(tokens, nuPy_EOLN, "EOLN"))
-    return false;
-  return true;
-}
-
-
-//
-//<function_call> ::= IDENTIFIER '(' [<element>] ')'
-//
-
-static bool parser_function_call(struct TokenQueue* tokens)
-{
-  if (!match(tokens, nuPy_IDENTIFIER, "IDENTIFIER"))
-    return false;
-  if (!match(tokens, nuPy_LEFT_PAREN, "("))
-    return false;
-  
-  struct Token curToken = tokenqueue_peekToken(tokens);
-  if (curToken.id == nuPy_IDENTIFIER 
-      || curToken.id == nuPy_INT_LITERAL 
-      || curToken.id == nuPy_REAL_LITERAL 
-      || curToken.id == nuPy_STR_LITERAL 
-      || curToken.id == nuPy_KEYW_TRUE 
-      || curToken.id == nuPy_KEYW_FALSE 
-      || curToken.id == nuPy_KEYW_NONE)
-  {
-    if (!parser_element(tokens))
-      return false;
-  }
-  if (!match(tokens, nuPy_RIGHT_PAREN, ")"))
-    return false;
-  return true;
-}
-
-//
-//<value> ::= <expr> | <function_call>
-//
-
-static bool parser_value(struct TokenQueue* tokens)
-{
-  struct Token curToken = tokenqueue_peekToken(tokens);
-  struct Token peekNext = tokenqueue_peek2Token(tokens);
-  //if identifier and left paren, then must be function call. otherwise expression
-  if (curToken.id == nuPy_IDENTIFIER && peekNext.id == nuPy_LEFT_PAREN)
-  {
-    return parser_function_call(tokens);
-  }
-    
-  //now must be expr
-  return parser_expr(tokens);
-}
-
-//
-// <while_loop> ::= while <expr> ':' EOLN <body>
-//
-
-static bool parser_while_loop(struct TokenQueue* tokens)
-{
-  if (!match(tokens, nuPy_KEYW_WHILE, "while"))
-    return false;
-
-  if (!parser_expr(tokens))
-    return false;
-
-  if (!match(tokens, nuPy_COLON, ":"))
-    return false;
-
-  if (!match(tokens, nuPy_EOLN, "EOLN"))
-    return false;
-
-  if (!parser_body(tokens))
-    return false;
-  return true;
-}
-
-//
-// <assignment> ::= ['*'] IDENTIFIER '=' <value> EOLN
-//
-
-static bool parser_assignment(struct TokenQueue* tokens)
-{
-  struct Token curToken = tokenqueue_peekToken(tokens);
-  //first check if the assignment starts with an asterisk
-  if (curToken.id == nuPy_ASTERISK)
-  {
-    if (!match(tokens, nuPy_ASTERISK, "*"))
-      return false;
-  }
-
-  if(!match(tokens, nuPy_IDENTIFIER, "IDENTIFIER"))
-    return false;
-  if(!match(tokens, nuPy_EQUAL, "="))
-    return false;
-  if(!parser_value(tokens))
-    return false;
-  if(!match(tokens, nuPy_EOLN, "EOLN"))
-    return false;
-  return true;
-}
-//
-// public functions:
-//
-
-//
-// parser_parse
-//
-// Given an input stream, uses the scanner to obtain the tokens
-// and then checks the syntax of the input against the BNF rules
-// for the subset of Python we are supporting. 
-//
-// Returns NULL if a syntax error was found; in this case 
-// an error message was output. Returns a pointer to a list
-// of tokens -- a Token Queue -- if no syntax errors were 
-// detected. This queue contains the complete input in token
-// form for further analysis.
-//
-// NOTE: it is the callers responsibility to free the resources
-// used by the Token Queue.
-//
-struct TokenQueue* parser_parse(FILE* input)
-{
-  if (input == NULL) {
-    printf("**INTERNAL ERROR: input stream is NULL (parser_parse)\n");
-    return NULL;
-  }
-
-  //
-  // First, let's get all the tokens and store them
-  // into a queue:
-  //
-  int lineNumber, colNumber;
-  char value[256];
-  struct Token token;
-  struct TokenQueue* tokens;
-
-  scanner_init(&lineNumber, &colNumber, value);
-
-  token = scanner_nextToken(input, &lineNumber, &colNumber, value);
-  tokens = tokenqueue_create();
-
-  while (token.id != nuPy_EOS)
-  {
-    tokenqueue_enqueue(tokens, token, value);
-
-    token = scanner_nextToken(input, &lineNumber, &colNumber, value);
-  }
-
-  // enqueue the final token:
-  tokenqueue_enqueue(tokens, token, value);
-
-  //
-  // now duplicate the tokens so that we have a copy after the
-  // parsing process is over --- we need a copy so we can return
-  // in case the parsing is successful. The tokens are then used
-  // for analysis and execution.
-  //
-  struct TokenQueue* duplicate;
-
-  duplicate = tokenqueue_duplicate(tokens);
-
-  //
-  // okay, now let's parse the input tokens:
-  //
-  bool result = parser_program(tokens);
-
-  //
-  // When we are done parsing, we are going to 
-  // execute (assuming the parse was successful).
-  // If the input is coming from the keyboard, 
-  // consume the rest of the input after the $ 
-  // before we start executing the python which
-  // may do it's own input from the keyboard:
-  //
-  if (result && input == stdin) {
-    int c = fgetc(stdin);
-    while (c != '\n' && c != EOF)
-      c = fgetc(stdin);
-  }
-
-  //
-  // done, free memory and return tokens or NULL:
-  //
-  tokenqueue_destroy(tokens);
-
-  if (result) // parse was successful
-  {
-    return duplicate;
-  }
-  else  // syntax error, nothing to execute:
-  {
-    tokenqueue_destroy(duplicate);
-
-    return NULL;
-  }
-}
+/*parser.c*/
+
+//
+// Recursive-descent parsing functions for nuPython programming language.
+// The parser is responsible for checking if the input follows the syntax
+// ("grammar") rules of nuPython. If successful, the tokens are
+// returned so the program can be analyzed and executed.
+//
+// The parser can also build the program graph as it goes (see
+// parser_build): each parsing function then takes a pointer to
+// where the node it parses goes, and builds the node as it checks
+// its syntax. The nodes come from an arena (see arena.h), in the
+// order they are parsed, so a syntax error just leaves them there.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+#include <assert.h>
+
+#include "token.h"
+#include "tokenqueue.h"
+#include "tokenbuffer.h"
+#include "tokenring.h"
+#include "mapscanner.h"
+#include "programgraph.h"
+#include "arena.h"
+#include "parser.h"
+
+
+//
+// GraphBuild
+//
+// Passed to the parsing functions while the program graph is being
+// built (and NULL otherwise).
+//
+struct GraphBuild
+{
+  struct ARENA* arena;  // where the nodes come from
+
+  //
+  // true => a statement was found that the graph can't be built
+  // from directly, so it must be built from the tokens instead:
+  //
+  bool from_tokens;
+};
+
+
+//
+// declarations of private functions:
+//
+static void errorMsg(char* expecting, char* value, struct Token found);
+static bool match(struct TokenBuffer* tokens, int expectedID, char* expectedValue);
+
+static bool parser_expr(struct TokenBuffer* tokens, struct GraphBuild* graph, struct EXPR** expr);
+static bool parser_body(struct TokenBuffer* tokens, struct GraphBuild* graph, struct STMT** body);
+static bool parser_else(struct TokenBuffer* tokens);
+
+static bool parser_if_then_else(struct TokenBuffer* tokens);
+static bool parser_pass_stmt(struct TokenBuffer* tokens, struct GraphBuild* graph, struct STMT** stmt);
+static bool parser_empty_stmt(struct TokenBuffer* tokens);
+static bool startOfStmt(struct TokenBuffer* tokens);
+static bool parser_stmt(struct TokenBuffer* tokens, struct GraphBuild* graph, struct STMT** stmt);
+static bool parser_stmts(struct TokenBuffer* tokens, struct GraphBuild* graph, struct STMT** slot);
+static bool parser_program(struct TokenBuffer* tokens, struct GraphBuild* graph, struct STMT** program);
+
+// declarations of more that I create 
+
+static bool parser_op(struct TokenBuffer* tokens, int* op);
+static bool parser_unary_expr(struct TokenBuffer* tokens, struct GraphBuild* graph, struct UNARY_EXPR** expr);
+static bool parser_element(struct TokenBuffer* tokens, struct GraphBuild* graph, struct ELEMENT** element);
+static bool parser_identifier(struct TokenBuffer* tokens, struct GraphBuild* graph, struct ELEMENT** element);
+static bool parser_function_call(struct TokenBuffer* tokens, struct GraphBuild* graph, char** name, struct ELEMENT** parameter);
+static bool parser_value(struct TokenBuffer* tokens, struct GraphBuild* graph, struct VALUE** value);
+static bool parser_while_loop(struct TokenBuffer* tokens, struct GraphBuild* graph, struct STMT** stmt);
+static bool parser_assignment(struct TokenBuffer* tokens, struct GraphBuild* graph, struct STMT** stmt);
+static bool parser_call_stmt(struct TokenBuffer* tokens, struct GraphBuild* graph, struct STMT** stmt);
+
+
+//
+// errorMsg:
+//
+// Outputs a properly-formatted syntax error message of the form
+// "expecting X, found Y".
+//
+static void errorMsg(char* expecting, char* value, struct Token found)
+{
+  printf("**SYNTAX ERROR @ (%d,%d): expecting %s, found '%s'\n",
+    found.line, found.col, expecting, value);
+}
+
+
+//
+// match
+//
+// Checks to see if the token at the cursor matches the
+// exectedID. If so, the cursor moves past the token and
+// true is returned. If not, an error message is output and false
+// is returned.
+// 
+// If false is returned, the error message output is of the form
+// "expecting X, found Y" where X is the value of the expected 
+// token and Y is the expectedValue passed in. 
+//
+static bool match(struct TokenBuffer* tokens, int expectedID, char* expectedValue)
+{
+  //
+  // does the token match the expected token?
+  //
+  struct Token curToken = tokenbuffer_peekToken(tokens);
+
+  if (curToken.id != expectedID)  // no, => error
+  {
+    errorMsg(expectedValue, tokenbuffer_peekValue(tokens), tokenbuffer_locate(tokens));
+    return false;
+  }
+
+  //
+  // yes, it matched, so move past it and return true:
+  //
+  tokenbuffer_advance(tokens);
+
+  return true;
+}
+
+
+//
+// new_stmt
+//
+// Returns a new statement of the given type, starting on the given
+// line, with its type-specific struct zeroed.
+//
+static struct STMT* new_stmt(struct GraphBuild* graph, int stmt_type, int line)
+{
+  struct STMT* stmt = (struct STMT*)arena_alloc(graph->arena, sizeof(struct STMT));
+
+  stmt->stmt_type = stmt_type;
+  stmt->line = line;
+
+  if (stmt_type == STMT_ASSIGNMENT) {
+    stmt->types.assignment = (struct STMT_ASSIGNMENT*)arena_alloc(graph->arena, sizeof(struct STMT_ASSIGNMENT));
+    memset(stmt->types.assignment, 0, sizeof(struct STMT_ASSIGNMENT));
+  }
+  else if (stmt_type == STMT_FUNCTION_CALL) {
+    stmt->types.function_call = (struct STMT_FUNCTION_CALL*)arena_alloc(graph->arena, sizeof(struct STMT_FUNCTION_CALL));
+    memset(stmt->types.function_call, 0, sizeof(struct STMT_FUNCTION_CALL));
+  }
+  else if (stmt_type == STMT_WHILE_LOOP) {
+    stmt->types.while_loop = (struct STMT_WHILE_LOOP*)arena_alloc(graph->arena, sizeof(struct STMT_WHILE_LOOP));
+    memset(stmt->types.while_loop, 0, sizeof(struct STMT_WHILE_LOOP));
+  }
+  else {
+    assert(stmt_type == STMT_PASS);
+    stmt->types.pass = (struct STMT_PASS*)arena_alloc(graph->arena, sizeof(struct STMT_PASS));
+    memset(stmt->types.pass, 0, sizeof(struct STMT_PASS));
+  }
+
+  return stmt;
+}
+
+
+//
+// next_stmt_slot
+//
+// Returns the address of the given statement's next_stmt pointer.
+//
+static struct STMT** next_stmt_slot(struct STMT* stmt)
+{
+  if (stmt->stmt_type == STMT_ASSIGNMENT)
+    return &stmt->types.assignment->next_stmt;
+  else if (stmt->stmt_type == STMT_FUNCTION_CALL)
+    return &stmt->types.function_call->next_stmt;
+  else if (stmt->stmt_type == STMT_WHILE_LOOP)
+    return &stmt->types.while_loop->next_stmt;
+  else {
+    assert(stmt->stmt_type == STMT_PASS);
+    return &stmt->types.pass->next_stmt;
+  }
+}
+
+
+// 
+// <element> ::= INDENTIFIER, INT_LITERAL, REAL_LITERAL, STR_LITERAL, True, False, None
+// 
+
+static bool parser_element(struct TokenBuffer* tokens, struct GraphBuild* graph, struct ELEMENT** element)
+{
+  struct Token curToken = tokenbuffer_peekToken(tokens);
+  int type;
+
+  if (curToken.id == nuPy_IDENTIFIER)
+    type = ELEMENT_IDENTIFIER;
+  else if (curToken.id == nuPy_INT_LITERAL)
+    type = ELEMENT_INT_LITERAL;
+  else if (curToken.id == nuPy_REAL_LITERAL)
+    type = ELEMENT_REAL_LITERAL;
+  else if (curToken.id == nuPy_STR_LITERAL)
+    type = ELEMENT_STR_LITERAL;
+  else if (curToken.id == nuPy_KEYW_TRUE)
+    type = ELEMENT_TRUE;
+  else if (curToken.id == nuPy_KEYW_FALSE)
+    type = ELEMENT_FALSE;
+  else if (curToken.id == nuPy_KEYW_NONE)
+    type = ELEMENT_NONE;
+  else
+  {
+    errorMsg("element", "not an element", tokenbuffer_locate(tokens));
+    return false;
+  }
+
+  if (graph != NULL)
+  {
+    *element = (struct ELEMENT*)arena_alloc(graph->arena, sizeof(struct ELEMENT));
+    (*element)->element_type = type;
+    (*element)->element_value = arena_strdup(graph->arena, tokenbuffer_peekValue(tokens));
+  }
+
+  tokenbuffer_advance(tokens);
+  return true;
+}
+
+//
+// IDENTIFIER, as an element
+//
+
+static bool parser_identifier(struct TokenBuffer* tokens, struct GraphBuild* graph, struct ELEMENT** element)
+{
+  if (tokenbuffer_peekToken(tokens).id != nuPy_IDENTIFIER)
+    return match(tokens, nuPy_IDENTIFIER, "IDENTIFIER");  // error
+
+  return parser_element(tokens, graph, element);
+}
+
+/*
+<unary_expr> ::= '*' IDENTIFIER 
+                | '&' IDENTIFIER 
+                | '+' [IDENTIFIER | INT_LITERAL | REAL_LITERAL]
+                | '-' [IDENTIFIER | INT_LITERAL | REAL_LITERAL]
+                |<element>
+*/
+
+
+static bool parser_unary_expr(struct TokenBuffer* tokens, struct GraphBuild* graph, struct UNARY_EXPR** expr)
+{
+  struct ELEMENT** element = NULL;
+
+  if (graph != NULL)
+  {
+    *expr = (struct UNARY_EXPR*)arena_alloc(graph->arena, sizeof(struct UNARY_EXPR));
+    (*expr)->element = NULL;
+    element = &(*expr)->element;
+  }
+
+  struct Token curToken = tokenbuffer_peekToken(tokens);
+  int type = UNARY_ELEMENT;
+  bool result;
+
+  //'*' IDENTIFIER 
+  if (curToken.id == nuPy_ASTERISK)
+  {
+    type = UNARY_PTR_DEREF;
+    result = match(tokens, nuPy_ASTERISK, "*") && parser_identifier(tokens, graph, element);
+  }
+  //'&' IDENTIFIER 
+  else if (curToken.id == nuPy_AMPERSAND)
+  {
+    type = UNARY_ADDRESS_OF;
+    result = match(tokens, nuPy_AMPERSAND, "&") && parser_identifier(tokens, graph, element);
+  }
+  //'+' [IDENTIFIER | INT_LITERAL | REAL_LITERAL]
+  //'-' [IDENTIFIER | INT_LITERAL | REAL_LITERAL]
+  else if (curToken.id == nuPy_PLUS || curToken.id == nuPy_MINUS)
+  {
+    type = (curToken.id == nuPy_PLUS) ? UNARY_PLUS : UNARY_MINUS;
+    tokenbuffer_advance(tokens);
+
+    struct Token nextToken = tokenbuffer_peekToken(tokens);
+
+    if (nextToken.id == nuPy_IDENTIFIER
+        || nextToken.id == nuPy_INT_LITERAL
+        || nextToken.id == nuPy_REAL_LITERAL)
+    {
+      result = parser_element(tokens, graph, element);
+    }
+    else 
+    {
+      errorMsg("identifier or numberic literal", tokenbuffer_peekValue(tokens), tokenbuffer_locate(tokens));
+      result = false;
+    }
+  }
+  //<element>
+  else if (curToken.id == nuPy_IDENTIFIER 
+      || curToken.id == nuPy_INT_LITERAL 
+      || curToken.id == nuPy_REAL_LITERAL 
+      || curToken.id == nuPy_STR_LITERAL 
+      || curToken.id == nuPy_KEYW_TRUE 
+      || curToken.id == nuPy_KEYW_FALSE 
+      || curToken.id == nuPy_KEYW_NONE)
+  {
+    result = parser_element(tokens, graph, element);
+  }
+  else
+  {
+    errorMsg("unary expression", "nothing", tokenbuffer_locate(tokens));
+    result = false;
+  }
+
+  if (graph != NULL)
+    (*expr)->expr_type = type;
+
+  return result;
+}
+
+//create parser_element - done
+
+
+// 
+// <op> ::= + | - | * | ** | % | / | == | != | < | <= | > | >= | is | in
+//
+
+static bool parser_op(struct TokenBuffer* tokens, int* op)
+{
+  //
+  // the program graph's operator for each operator token:
+  //
+  static const int operators[] = {
+    [nuPy_PLUS] = OPERATOR_PLUS,
+    [nuPy_MINUS] = OPERATOR_MINUS,
+    [nuPy_ASTERISK] = OPERATOR_ASTERISK,
+    [nuPy_POWER] = OPERATOR_POWER,
+    [nuPy_PERCENT] = OPERATOR_MOD,
+    [nuPy_SLASH] = OPERATOR_DIV,
+    [nuPy_EQUALEQUAL] = OPERATOR_EQUAL,
+    [nuPy_NOTEQUAL] = OPERATOR_NOT_EQUAL,
+    [nuPy_LT] = OPERATOR_LT,
+    [nuPy_LTE] = OPERATOR_LTE,
+    [nuPy_GT] = OPERATOR_GT,
+    [nuPy_GTE] = OPERATOR_GTE,
+    [nuPy_KEYW_IS] = OPERATOR_IS,
+    [nuPy_KEYW_IN] = OPERATOR_IN,
+  };
+
+  struct Token curToken = tokenbuffer_peekToken(tokens);
+
+  if (op != NULL && curToken.id < (int)(sizeof(operators) / sizeof(operators[0])))
+    *op = operators[curToken.id];
+
+  if (curToken.id == nuPy_PLUS)
+  {
+    return match(tokens, nuPy_PLUS, "+");
+  }
+
+  else if (curToken.id == nuPy_MINUS)
+  {
+    return match(tokens, nuPy_MINUS, "-");
+  }
+
+  else if (curToken.id == nuPy_ASTERISK)
+  {
+    return match(tokens, nuPy_ASTERISK, "*");
+  }
+
+  else if (curToken.id == nuPy_POWER)
+  {
+    return match(tokens, nuPy_POWER, "**");
+  }
+
+  else if (curToken.id == nuPy_PERCENT)
+  {
+    return match(tokens, nuPy_PERCENT, "%%");
+  }
+
+  else if (curToken.id == nuPy_SLASH)
+  {
+    return match(tokens, nuPy_SLASH, "/");
+  }
+
+  else if (curToken.id == nuPy_EQUALEQUAL)
+  {
+    return match(tokens, nuPy_EQUALEQUAL, "==");
+  }
+
+  else if (curToken.id == nuPy_NOTEQUAL)
+  {
+    return match(tokens, nuPy_NOTEQUAL, "!=");
+  }
+
+  else if (curToken.id == nuPy_LT)
+  {
+    return match(tokens, nuPy_LT, "<");
+  }
+  else if (curToken.id == nuPy_LTE)
+  {
+    return match(tokens, nuPy_LTE, "<=");
+  }
+  else if (curToken.id == nuPy_GT)
+  {
+    return match(tokens, nuPy_GT, ">");
+  }
+  else if (curToken.id == nuPy_GTE)
+  {
+    return match(tokens, nuPy_GTE, ">=");
+  }
+  else if (curToken.id == nuPy_KEYW_IS)
+  {
+    return match(tokens, nuPy_KEYW_IS, "is");
+  }
+  else if (curToken.id == nuPy_KEYW_IN)
+  {
+    return match(tokens, nuPy_KEYW_IN, "in");
+  }
+  errorMsg("op", "other", tokenbuffer_locate(tokens));
+  return false;
+}
+
+
+
+
+//
+// <expr> ::= <unary_expr> [<op> <unary_expr>]
+//
+
+static bool parser_expr(struct TokenBuffer* tokens, struct GraphBuild* graph, struct EXPR** expr)
+{
+  struct UNARY_EXPR** lhs = NULL;
+  struct UNARY_EXPR** rhs = NULL;
+  int* op = NULL;
+
+  if (graph != NULL)
+  {
+    *expr = (struct EXPR*)arena_alloc(graph->arena, sizeof(struct EXPR));
+    (*expr)->lhs = NULL;
+    (*expr)->isBinaryExpr = false;
+    (*expr)->operator = OPERATOR_NO_OP;
+    (*expr)->rhs = NULL;
+
+    lhs = &(*expr)->lhs;
+    op = &(*expr)->operator;
+    rhs = &(*expr)->rhs;
+  }
+
+  // does the unary_expr match?
+  bool result = parser_unary_expr(tokens, graph, lhs);
+
+  //make a struct to peek at the next token; does it have an op? 
+  struct Token curToken = tokenbuffer_peekToken(tokens);
+
+  if (result &&
+     (curToken.id == nuPy_PLUS || 
+      curToken.id == nuPy_MINUS || 
+      curToken.id == nuPy_ASTERISK || 
+      curToken.id == nuPy_POWER || 
+      curToken.id == nuPy_PERCENT || 
+      curToken.id == nuPy_SLASH || 
+      curToken.id == nuPy_EQUALEQUAL || 
+      curToken.id == nuPy_NOTEQUAL || 
+      curToken.id == nuPy_LT || 
+      curToken.id == nuPy_LTE || 
+      curToken.id == nuPy_GT || 
+      curToken.id == nuPy_GTE || 
+      curToken.id == nuPy_KEYW_IS || 
+      curToken.id == nuPy_KEYW_IN))
+  //if op it should also have unary expr
+  {
+    if (graph != NULL)
+      (*expr)->isBinaryExpr = true;
+
+    result = parser_op(tokens, op) && parser_unary_expr(tokens, graph, rhs);
+  }
+  //else just return true
+
+  return result;
+}
+  
+
+//
+// <body> ::= '{' EOLN <stmts> '}' EOLN
+//
+// The statements of the body are linked into *body when building
+// the program graph.
+//
+
+static bool parser_body(struct TokenBuffer* tokens, struct GraphBuild* graph, struct STMT** body)
+{
+  if (!match(tokens, nuPy_LEFT_BRACE, "{"))
+    return false;
+  if (!match(tokens, nuPy_EOLN, "EOLN"))
+    return false;
+  if (!parser_stmts(tokens, graph, body))
+    return false;
+  if (!match(tokens, nuPy_RIGHT_BRACE, "}"))
+    return false;
+  if (!match(tokens, nuPy_EOLN, "EOLN"))
+    return false;
+  return true;
+}
+
+
+//
+// <else> ::= elif <expr> ':' EOLN <body> [<else>]
+//          | else ':' EOLN <body>
+//
+static bool parser_else(struct TokenBuffer* tokens)
+{
+  //
+  // TODO: done
+  //
+
+  struct Token curToken = tokenbuffer_peekToken(tokens);
+
+  if (curToken.id == nuPy_KEYW_ELIF)
+  {
+    if (!match(tokens, nuPy_KEYW_ELIF, "ELIF"))
+      return false;
+    if (!parser_expr(tokens, NULL, NULL))
+      return false;
+    if (!match(tokens, nuPy_COLON, ":"))
+      return false;
+    if (!match(tokens, nuPy_EOLN, "EOLN"))
+      return false;
+    if(!parser_body(tokens, NULL, NULL))
+      return false;
+    struct Token nextToken = tokenbuffer_peekToken(tokens);
+    if (nextToken.id == nuPy_KEYW_ELSE || nextToken.id == nuPy_KEYW_ELIF)
+    {
+      if (!parser_else(tokens))
+        return false;
+    }
+  }
+  if (curToken.id == nuPy_KEYW_ELSE)
+  {
+    if (!match(tokens, nuPy_KEYW_ELSE, "ELSE"))
+      return false;
+    if (!match(tokens, nuPy_COLON, ":"))
+      return false;
+    if (!match(tokens, nuPy_EOLN, "EOLN"))
+      return false;
+    if (!parser_body(tokens, NULL, NULL))
+      return false; 
+  }
+  return true;
+}
+
+
+//
+// <if_then_else> ::= if <expr> ':' EOLN <body> [<else>]
+//
+// The program graph doesn't support if-then-else yet, so nothing
+// is built (see parser_stmt).
+//
+static bool parser_if_then_else(struct TokenBuffer* tokens)
+{
+  if (!match(tokens, nuPy_KEYW_IF, "if"))
+    return false;
+
+  if (!parser_expr(tokens, NULL, NULL))
+    return false;
+
+  if (!match(tokens, nuPy_COLON, ":"))
+    return false;
+
+  if (!match(tokens, nuPy_EOLN, "EOLN"))
+    return false;
+
+  if (!parser_body(tokens, NULL, NULL))
+    return false;
+
+  //
+  // is the optional <else> present?
+  //
+  struct Token curToken = tokenbuffer_peekToken(tokens);
+
+  if (curToken.id == nuPy_KEYW_ELIF || curToken.id == nuPy_KEYW_ELSE)
+  {
+    bool result = parser_else(tokens);
+    return result;
+  }
+  else
+  {
+    // <else> is optional, missing => do nothing and return success:
+    return true;
+  }
+}
+
+
+// 
+// <pass_stmt> ::= pass EOLN
+//
+static bool parser_pass_stmt(struct TokenBuffer* tokens, struct GraphBuild* graph, struct STMT** stmt)
+{
+  if (graph != NULL)
+    *stmt = new_stmt(graph, STMT_PASS, tokenbuffer_line(tokens));
+
+  if (!match(tokens, nuPy_KEYW_PASS, "pass"))
+    return false;
+
+  if (!match(tokens, nuPy_EOLN, "EOLN"))
+    return false;
+
+  return true;
+}
+
+
+// 
+// <empty_stmt> ::= EOLN
+//
+static bool parser_empty_stmt(struct TokenBuffer* tokens)
+{
+  if (!match(tokens, nuPy_EOLN, "EOLN"))
+    return false;
+
+  return true;
+}
+
+
+//
+// startOfStmt
+//
+// Returns true if the next token denotes the start of a stmt,
+// and false if not.
+//
+static bool startOfStmt(struct TokenBuffer* tokens)
+{
+  struct Token curToken = tokenbuffer_peekToken(tokens);
+
+  //
+  // TODO: this is not complete.
+  //
+
+  if (curToken.id == nuPy_KEYW_PASS ||
+      curToken.id == nuPy_EOLN ||
+      curToken.id == nuPy_KEYW_IF || 
+      curToken.id == nuPy_KEYW_WHILE ||
+      curToken.id == nuPy_ASTERISK ||
+      curToken.id == nuPy_IDENTIFIER || 
+      curToken.id == nuPy_INT_LITERAL || 
+      curToken.id == nuPy_REAL_LITERAL || 
+      curToken.id == nuPy_STR_LITERAL || 
+      curToken.id == nuPy_KEYW_TRUE || 
+      curToken.id == nuPy_KEYW_FALSE || 
+      curToken.id == nuPy_KEYW_NONE)
+      {
+    return true;
+  }
+  else {
+    return false;
+  }
+}
+
+
+//
+// <stmt> ::= <assignment>
+//          | <if_then_else>
+//          | <while_loop>
+//          | <call_stmt>
+//          | <pass_stmt>
+//          | <empty_stmt>
+//
+// When building the program graph, the statement is returned in
+// *stmt, or NULL if nothing was built (e.g. an empty statement).
+//
+static bool parser_stmt(struct TokenBuffer* tokens, struct GraphBuild* graph, struct STMT** stmt)
+{
+  //
+  // TODO: for now we just accept a program consisting of a
+  // single "pass" or "empty" statement.
+  //
+  if (!startOfStmt(tokens)) {
+    errorMsg("start of a statement", tokenbuffer_peekValue(tokens), tokenbuffer_locate(tokens));
+    return false;
+  }
+
+  //
+  // we have the start of a stmt, but which one?
+  //
+  struct Token curToken = tokenbuffer_peekToken(tokens);
+  struct Token peekNext = tokenbuffer_peek2Token(tokens);
+
+  if (curToken.id == nuPy_KEYW_PASS) {
+    bool result = parser_pass_stmt(tokens, graph, stmt);
+    return result;
+  }
+  else if (curToken.id == nuPy_EOLN) {
+    bool result = parser_empty_stmt(tokens);
+    return result;
+  }
+  else if (curToken.id == nuPy_KEYW_IF) {
+    //
+    // the graph has to be built from the tokens then, which
+    // reports that if statements are not supported yet:
+    //
+    if (graph != NULL)
+      graph->from_tokens = true;
+
+    bool result = parser_if_then_else(tokens);
+    return result;
+  }
+  else if (curToken.id == nuPy_KEYW_WHILE) {
+    bool result = parser_while_loop(tokens, graph, stmt);
+    return result;
+  }
+  else if (curToken.id == nuPy_ASTERISK && peekNext.id == nuPy_IDENTIFIER){
+    bool result = parser_assignment(tokens, graph, stmt);
+    return result;
+  }
+   else if (curToken.id == nuPy_IDENTIFIER && peekNext.id == nuPy_EQUAL){
+    bool result = parser_assignment(tokens, graph, stmt);
+    return result;
+  }
+  else if (curToken.id == nuPy_IDENTIFIER && peekNext.id == nuPy_LEFT_PAREN){
+    bool result = parser_call_stmt(tokens, graph, stmt);
+    return result;
+  }
+  else if (curToken.id == nuPy_IDENTIFIER){
+    errorMsg("assignment or function call", tokenbuffer_peekValue(tokens), tokenbuffer_locate(tokens));
+    return false;
+  }
+  
+  else {
+    tokenbuffer_finish_scan(tokens);  // the scanner's warnings first
+    printf("**INTERNAL ERROR: unknown stmt (parser_stmt)\n"); 
+    //errorMsg("assignment or function call", curValue, curToken);
+    return false;
+  }
+}
+
+
+
+//
+// <stmts> ::= <stmt> [<stmts>]
+//
+// When building the program graph, each statement built is linked
+// in at *slot, and the next one after it.
+//
+static bool parser_stmts(struct TokenBuffer* tokens, struct GraphBuild* graph, struct STMT** slot)
+{
+  //
+  // TODO: for now we just accept a program consisting of a
+  // single statement.
+  //
+  struct STMT* stmt = NULL;
+
+  if (!parser_stmt(tokens, graph, &stmt))
+    return false;
+
+  if (stmt != NULL)
+  {
+    *slot = stmt;
+    slot = next_stmt_slot(stmt);
+  }
+
+  struct Token curToken = tokenbuffer_peekToken(tokens);
+
+  if (curToken.id == nuPy_ASTERISK 
+      || curToken.id == nuPy_IDENTIFIER 
+      || curToken.id == nuPy_KEYW_IF 
+      || curToken.id == nuPy_KEYW_WHILE 
+      || curToken.id == nuPy_KEYW_PASS 
+      || curToken.id == nuPy_EOLN)
+  {
+    bool result = parser_stmts(tokens, graph, slot);
+    return result;
+  }
+
+  return true;
+}
+
+
+//
+// <program> ::= <stmts> EOS
+//
+static bool parser_program(struct TokenBuffer* tokens, struct GraphBuild* graph, struct STMT** program)
+{
+  if (!parser_stmts(tokens, graph, program))
+    return false;
+
+  if (!match(tokens, nuPy_EOS, "$"))
+    return false;
+
+  return true;
+}
+
+
+//
+//<call_stmt> ::= <function_call> EOLN
+//
+static bool parser_call_stmt(struct TokenBuffer* tokens, struct GraphBuild* graph, struct STMT** stmt)
+{
+  struct STMT_FUNCTION_CALL* call = NULL;
+
+  if (graph != NULL)
+  {
+    *stmt = new_stmt(graph, STMT_FUNCTION_CALL, tokenbuffer_line(tokens));
+    call = (*stmt)->types.function_call;
+  }
+
+  if(!parser_function_call(tokens, graph, call ? &call->function_name : NULL, call ? &call->parameter : NULL))
+    return false;
+  if(!match(tokens, nuPy_EOLN, "EOLN"))
+    return false;
+  return true;
+}
+
+
+//
+//<function_call> ::= IDENTIFIER '(' [<element>] ')'
+//
+
+static bool parser_function_call(struct TokenBuffer* tokens, struct GraphBuild* graph, char** name, struct ELEMENT** parameter)
+{
+  if (graph != NULL && tokenbuffer_peekToken(tokens).id == nuPy_IDENTIFIER)
+  {
+    *name = arena_strdup(graph->arena, tokenbuffer_peekValue(tokens));
+    *parameter = NULL;
+  }
+
+  if (!match(tokens, nuPy_IDENTIFIER, "IDENTIFIER"))
+    return false;
+  if (!match(tokens, nuPy_LEFT_PAREN, "("))
+    return false;
+  
+  struct Token curToken = tokenbuffer_peekToken(tokens);
+  if (curToken.id == nuPy_IDENTIFIER 
+      || curToken.id == nuPy_INT_LITERAL 
+      || curToken.id == nuPy_REAL_LITERAL 
+      || curToken.id == nuPy_STR_LITERAL 
+      || curToken.id == nuPy_KEYW_TRUE 
+      || curToken.id == nuPy_KEYW_FALSE 
+      || curToken.id == nuPy_KEYW_NONE)
+  {
+    if (!parser_element(tokens, graph, parameter))
+      return false;
+  }
+  if (!match(tokens, nuPy_RIGHT_PAREN, ")"))
+    return false;
+  return true;
+}
+
+//
+//<value> ::= <expr> | <function_call>
+//
+
+static bool parser_value(struct TokenBuffer* tokens, struct GraphBuild* graph, struct VALUE** value)
+{
+  struct Token curToken = tokenbuffer_peekToken(tokens);
+  struct Token peekNext = tokenbuffer_peek2Token(tokens);
+
+  if (graph != NULL)
+    *value = (struct VALUE*)arena_alloc(graph->arena, sizeof(struct VALUE));
+
+  //if identifier and left paren, then must be function call. otherwise expression
+  if (curToken.id == nuPy_IDENTIFIER && peekNext.id == nuPy_LEFT_PAREN)
+  {
+    struct FUNCTION_CALL* call = NULL;
+
+    if (graph != NULL)
+    {
+      call = (struct FUNCTION_CALL*)arena_alloc(graph->arena, sizeof(struct FUNCTION_CALL));
+      (*value)->value_type = VALUE_FUNCTION_CALL;
+      (*value)->types.function_call = call;
+    }
+
+    return parser_function_call(tokens, graph, call ? &call->function_name : NULL, call ? &call->parameter : NULL);
+  }
+    
+  //now must be expr
+  if (graph != NULL)
+    (*value)->value_type = VALUE_EXPR;
+
+  return parser_expr(tokens, graph, (graph != NULL) ? &(*value)->types.expr : NULL);
+}
+
+//
+// <while_loop> ::= while <expr> ':' EOLN <body>
+//
+// In the program graph, the last statement of the loop body loops
+// back to the while loop itself.
+//
+
+static bool parser_while_loop(struct TokenBuffer* tokens, struct GraphBuild* graph, struct STMT** stmt)
+{
+  struct STMT_WHILE_LOOP* loop = NULL;
+
+  if (!match(tokens, nuPy_KEYW_WHILE, "while"))
+    return false;
+
+  if (graph != NULL)
+  {
+    // the line of the condition, as programgraph_build has it:
+    *stmt = new_stmt(graph, STMT_WHILE_LOOP, tokenbuffer_line(tokens));
+    loop = (*stmt)->types.while_loop;
+  }
+
+  if (!parser_expr(tokens, graph, loop ? &loop->condition : NULL))
+    return false;
+
+  if (!match(tokens, nuPy_COLON, ":"))
+    return false;
+
+  if (!match(tokens, nuPy_EOLN, "EOLN"))
+    return false;
+
+  if (!parser_body(tokens, graph, loop ? &loop->loop_body : NULL))
+    return false;
+
+  if (graph == NULL)
+    return true;
+
+  if (loop->loop_body == NULL)
+  {
+    //
+    // a body of empty statements only, which programgraph_build
+    // rejects; leave that to it:
+    //
+    graph->from_tokens = true;
+    *stmt = NULL;
+    return true;
+  }
+
+  struct STMT* last = loop->loop_body;
+  while (*next_stmt_slot(last) != NULL)
+    last = *next_stmt_slot(last);
+
+  *next_stmt_slot(last) = *stmt;
+
+  return true;
+}
+
+//
+// <assignment> ::= ['*'] IDENTIFIER '=' <value> EOLN
+//
+
+static bool parser_assignment(struct TokenBuffer* tokens, struct GraphBuild* graph, struct STMT** stmt)
+{
+  struct STMT_ASSIGNMENT* assignment = NULL;
+  struct Token curToken = tokenbuffer_peekToken(tokens);
+  //first check if the assignment starts with an asterisk
+  if (curToken.id == nuPy_ASTERISK)
+  {
+    if (!match(tokens, nuPy_ASTERISK, "*"))
+      return false;
+  }
+
+  if (graph != NULL && tokenbuffer_peekToken(tokens).id == nuPy_IDENTIFIER)
+  {
+    *stmt = new_stmt(graph, STMT_ASSIGNMENT, tokenbuffer_line(tokens));
+    assignment = (*stmt)->types.assignment;
+    assignment->var_name = arena_strdup(graph->arena, tokenbuffer_peekValue(tokens));
+    assignment->isPtrDeref = (curToken.id == nuPy_ASTERISK);
+  }
+
+  if(!match(tokens, nuPy_IDENTIFIER, "IDENTIFIER"))
+    return false;
+  if(!match(tokens, nuPy_EQUAL, "="))
+    return false;
+  if(!parser_value(tokens, graph, assignment ? &assignment->rhs : NULL))
+    return false;
+  if(!match(tokens, nuPy_EOLN, "EOLN"))
+    return false;
+  return true;
+}
+
+
+//
+// scan_lines
+//
+// Scans all the tokens of the given input stream into a buffer
+// over the given (growable) source. The input is read a line at
+// a time, however long, and scanned in place; tokens never span
+// lines, so when the input is coming from the keyboard nothing
+// past the line with the $ is read, and the python can do its
+// own input from there.
+//
+static struct TokenBuffer* scan_lines(struct MappedSource* source, FILE* input)
+{
+  struct TokenBuffer* tokens = tokenbuffer_create_mapped(source);
+  struct TokenView token;
+
+  do
+  {
+    mapscanner_read_line(source, input);  // at the end => EOS below
+
+    do
+    {
+      token = mapscanner_nextToken(source);
+
+      tokenbuffer_append_view(tokens, token);
+    } while (token.id != nuPy_EOLN && token.id != nuPy_EOS);
+  } while (token.id != nuPy_EOS);
+
+  return tokens;
+}
+
+
+//
+// scan_source
+//
+// Scans all the tokens of the given memory-mapped source into a
+// buffer.
+//
+static struct TokenBuffer* scan_source(struct MappedSource* source)
+{
+  struct TokenBuffer* tokens = tokenbuffer_create_mapped(source);
+  struct TokenView token;
+
+  do
+  {
+    token = mapscanner_nextToken(source);
+
+    tokenbuffer_append_view(tokens, token);
+  } while (token.id != nuPy_EOS);
+
+  return tokens;
+}
+
+
+//
+// parse_tokens
+//
+// Parses the tokens in the buffer. With a NULL program, only the
+// syntax is checked, and if it's valid, *queue is the Token Queue.
+// Otherwise the program graph is built into *program as well, in
+// the given arena, unless it has to be built from the tokens after
+// all (then *program is NULL and *queue the Token Queue, as before).
+//
+static bool parse_tokens(struct TokenBuffer* tokens, struct ARENA* arena, struct STMT** program, struct TokenQueue** queue)
+{
+  struct GraphBuild graph;
+  graph.arena = arena;
+  graph.from_tokens = false;
+
+  *queue = NULL;
+  if (program != NULL)
+    *program = NULL;
+
+  //
+  // parsing only moves the cursor, so the tokens are all still
+  // there afterwards:
+  //
+  bool result = parser_program(tokens, (program != NULL) ? &graph : NULL, program);
+
+  if (!result)
+  {
+    if (program != NULL)
+      *program = NULL;  // what was built stays in the arena
+
+    return false;
+  }
+
+  if (program == NULL || graph.from_tokens)
+  {
+    if (program != NULL)
+      *program = NULL;
+
+    *queue = tokenbuffer_to_queue(tokens);
+  }
+
+  return true;
+}
+
+
+//
+// public functions:
+//
+
+//
+// parser_parse
+//
+// Given an input stream, uses the scanner to obtain the tokens
+// and then checks the syntax of the input against the BNF rules
+// for the subset of Python we are supporting. 
+//
+// Returns NULL if a syntax error was found; in this case 
+// an error message was output. Returns a pointer to a list
+// of tokens -- a Token Queue -- if no syntax errors were 
+// detected. This queue contains the complete input in token
+// form for further analysis.
+//
+// NOTE: it is the callers responsibility to free the resources
+// used by the Token Queue.
+//
+struct TokenQueue* parser_parse(FILE* input)
+{
+  if (input == NULL) {
+    printf("**INTERNAL ERROR: input stream is NULL (parser_parse)\n");
+    return NULL;
+  }
+
+  struct MappedSource* source = mapscanner_create();
+  struct TokenBuffer* tokens = scan_lines(source, input);
+  struct TokenQueue* queue;
+
+  parse_tokens(tokens, NULL, NULL, &queue);
+
+  tokenbuffer_destroy(tokens);
+  mapscanner_close(source);
+
+  return queue;
+}
+
+
+//
+// parser_build
+//
+// Same as parser_parse, but the program graph is built in the
+// arena while the syntax is checked.
+//
+bool parser_build(FILE* input, struct ARENA* arena, struct STMT** program, struct TokenQueue** tokens)
+{
+  if (input == NULL) {
+    printf("**INTERNAL ERROR: input stream is NULL (parser_build)\n");
+    return false;
+  }
+
+  struct MappedSource* source = mapscanner_create();
+  struct TokenBuffer* buffer = scan_lines(source, input);
+
+  bool result = parse_tokens(buffer, arena, program, tokens);
+
+  tokenbuffer_destroy(buffer);
+  mapscanner_close(source);
+
+  return result;
+}
+
+
+//
+// parser_parse_source
+//
+// Same as parser_parse, for a memory-mapped source file. The
+// tokens are views into the source until the Token Queue is
+// built, so nothing is copied unless the parse succeeds.
+//
+struct TokenQueue* parser_parse_source(struct MappedSource* source)
+{
+  if (source == NULL) {
+    printf("**INTERNAL ERROR: source is NULL (parser_parse_source)\n");
+    return NULL;
+  }
+
+  struct TokenBuffer* tokens = scan_source(source);
+  struct TokenQueue* queue;
+
+  parse_tokens(tokens, NULL, NULL, &queue);
+
+  tokenbuffer_destroy(tokens);
+
+  return queue;
+}
+
+
+//
+// parser_build_source
+//
+// Same as parser_parse_source, but the program graph is built
+// in the arena while the syntax is checked; only the names and
+// literals are copied out of the source.
+//
+bool parser_build_source(struct MappedSource* source, struct ARENA* arena, struct STMT** program, struct TokenQueue** tokens)
+{
+  if (source == NULL) {
+    printf("**INTERNAL ERROR: source is NULL (parser_build_source)\n");
+    return false;
+  }
+
+  struct TokenBuffer* buffer = scan_source(source);
+
+  bool result = parse_tokens(buffer, arena, program, tokens);
+
+  tokenbuffer_destroy(buffer);
+
+  return result;
+}
+
+
+//
+// parser_parse_pipelined
+//
+// Same as parser_parse_source, but the source is scanned on another
+// thread while it's being parsed, and the Token Queue is built by
+// that thread as it goes.
+//
+struct TokenQueue* parser_parse_pipelined(struct MappedSource* source)
+{
+  if (source == NULL) {
+    printf("**INTERNAL ERROR: source is NULL (parser_parse_pipelined)\n");
+    return NULL;
+  }
+
+  struct TokenRing* ring = tokenring_start(source, PARSER_RING_SIZE);
+  struct TokenBuffer* tokens = tokenbuffer_create_pipelined(ring);
+
+  //
+  // parse, and return tokens or NULL:
+  //
+  bool result = parser_program(tokens, NULL, NULL);
+
+  struct TokenQueue* queue = NULL;
+
+  if (result) // parse was successful
+  {
+    queue = tokenbuffer_to_queue(tokens);
+  }
+
+  tokenbuffer_destroy(tokens);
+  tokenring_destroy(ring);  // waits for the scanner, if need be
+
+  return queue;
+}
@@ -1,35 +1,91 @@
-/*parser.h*/
-
-//
-// Recursive-descent parsing functions for nuPython programming language.
-// The parser is responsible for checking if the input follows the syntax
-// ("grammar") rules of nuPython. If successful, a copy of the tokens is
-// returned so the program can be analyzed and executed.
-//
-
-#pragma once
-
-#include <stdio.h>
-#include <stdlib.h>
-#include <stdbool.h>  // true, false
-
-#include "tokenqueue.h"
-
-
-//
-// parser_parse
-//
-// Given an input stream, uses the scanner to obtain the tokens
-// and then checks the syntax of the input against the BNF rules
-// for the subset of Python we are supporting. 
-//
-// Returns NULL if a syntax error was found; in this case 
-// an error message was output. Returns a pointer to a list
-// of tokens -- a Token Queue -- if no syntax errors were 
-// detected. This queue contains the complete input in token
-// form for analysis and execution.
-//
-// NOTE: it is the callers responsibility to free the resources
-// used by the Token Queue.
-//
-struct TokenQueue* parser_parse(FILE* input);
+/*parser.h*/
+
+//
+// Recursive-descent parsing functions for nuPython programming language.
+// The parser is responsible for checking if the input follows the syntax
+// ("grammar") rules of nuPython. If successful, the tokens are
+// returned so the program can be analyzed and executed -- or the
+// program graph, built while the syntax is checked.
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+
+#include "tokenqueue.h"
+#include "mapscanner.h"
+#include "programgraph.h"
+#include "arena.h"
+
+
+//
+// parser_parse
+//
+// Given an input stream, uses the scanner to obtain the tokens
+// and then checks the syntax of the input against the BNF rules
+// for the subset of Python we are supporting. 
+//
+// Returns NULL if a syntax error was found; in this case 
+// an error message was output. Returns a pointer to a list
+// of tokens -- a Token Queue -- if no syntax errors were 
+// detected. This queue contains the complete input in token
+// form for analysis and execution.
+//
+// NOTE: it is the callers responsibility to free the resources
+// used by the Token Queue.
+//
+struct TokenQueue* parser_parse(FILE* input);
+
+//
+// parser_build
+//
+// Same as parser_parse, but instead of returning the tokens for
+// programgraph_build to build the program graph from, the graph is
+// built while the syntax is checked, in one pass over the tokens.
+// Its nodes and strings are allocated from the given arena, in the
+// order the program runs them, so a walk of the graph goes through
+// memory mostly in order.
+//
+// Returns false if a syntax error was found; an error message was
+// output. Otherwise returns true, and *program is the program
+// graph -- unless the program has a statement that the graph
+// can't be built from directly (if-then-else, which the graph
+// doesn't support yet), in which case *program is NULL and
+// *tokens is the Token Queue to call programgraph_build with.
+// Otherwise *tokens is NULL.
+//
+// NOTE: the program graph is freed by destroying the arena (see
+// arena_destroy), not with programgraph_destroy. It is the callers
+// responsibility to free the Token Queue.
+//
+bool parser_build(FILE* input, struct ARENA* arena, struct STMT** program, struct TokenQueue** tokens);
+
+//
+// parser_parse_source
+//
+// Same as parser_parse, but the tokens come from the given
+// memory-mapped source file (see mapscanner.h). The source can
+// be closed once this returns.
+//
+struct TokenQueue* parser_parse_source(struct MappedSource* source);
+
+//
+// parser_build_source
+//
+// Same as parser_build, for a memory-mapped source file.
+//
+bool parser_build_source(struct MappedSource* source, struct ARENA* arena, struct STMT** program, struct TokenQueue** tokens);
+
+//
+// parser_parse_pipelined
+//
+// Same as parser_parse_source, but the source is scanned on its own
+// thread, concurrently with parsing; tokens are handed over through
+// a ring of PARSER_RING_SIZE tokens (see tokenring.h). Peak memory
+// is lower, since the tokens are only held once, in the queue.
+//
+#define PARSER_RING_SIZE  4096
+
+struct TokenQueue* parser_parse_pipelined(struct MappedSource* source);
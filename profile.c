@@ -0,0 +1,186 @@
+/*profile.c*/
+
+//
+// Line-level execution profile for nuPython, see profile.h.
+//
+
+// clock_gettime
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+#include <time.h>
+
+#include "profile.h"
+
+
+//
+// the ticks of the profile being printed, for compare_lines (qsort
+// passes no context):
+//
+static long long* sort_ticks = NULL;
+
+
+//
+// Private functions:
+//
+
+//
+// grow
+//
+// Grows the arrays of the profile to hold the given line.
+//
+static void grow(struct PROFILE* profile, int line)
+{
+  int num_lines = 2 * profile->num_lines;
+
+  if (num_lines <= line)
+    num_lines = line + 1;
+
+  profile->hits = (long*)realloc(profile->hits, num_lines * sizeof(long));
+  profile->ticks = (long long*)realloc(profile->ticks, num_lines * sizeof(long long));
+
+  if (profile->hits == NULL || profile->ticks == NULL) {
+    printf("**INTERNAL ERROR: out of memory (profile grow)\n");
+    exit(-1);
+  }
+
+  int added = num_lines - profile->num_lines;
+
+  memset(profile->hits + profile->num_lines, 0, added * sizeof(long));
+  memset(profile->ticks + profile->num_lines, 0, added * sizeof(long long));
+
+  profile->num_lines = num_lines;
+}
+
+//
+// compare_lines
+//
+static int compare_lines(const void* a, const void* b)
+{
+  int line1 = *(const int*)a;
+  int line2 = *(const int*)b;
+
+  if (sort_ticks[line1] != sort_ticks[line2])
+    return (sort_ticks[line1] > sort_ticks[line2]) ? -1 : 1;
+
+  return line1 - line2;
+}
+
+
+//
+// Public functions:
+//
+
+//
+// profile_clock
+//
+// CLOCK_MONOTONIC, in ns.
+//
+long long profile_clock(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+
+//
+// profile_init
+//
+// Returns a new, empty profile.
+//
+struct PROFILE* profile_init(void)
+{
+  struct PROFILE* profile = (struct PROFILE*)malloc(sizeof(struct PROFILE));
+
+  profile->hits = NULL;
+  profile->ticks = NULL;
+  profile->num_lines = 0;
+
+  grow(profile, 63);
+
+  profile->start_ns = profile_clock();
+  profile->start_ticks = profile_ticks();
+
+  return profile;
+}
+
+
+//
+// profile_add
+//
+// Charges a hit, and the ticks it took, to the line.
+//
+void profile_add(struct PROFILE* profile, int line, long long ticks)
+{
+  if (line < 1)
+    return;
+
+  if (line >= profile->num_lines)
+    grow(profile, line);
+
+  profile->hits[line]++;
+  profile->ticks[line] += ticks;
+}
+
+
+//
+// profile_print
+//
+// Prints the profile, the most time first.
+//
+void profile_print(struct PROFILE* profile)
+{
+  //
+  // ns per tick, over the whole run (1 if the ticks are ns):
+  //
+  long long ticks = profile_ticks() - profile->start_ticks;
+  long long ns = profile_clock() - profile->start_ns;
+  double ns_per_tick = (ticks > 0) ? (double)ns / ticks : 0.0;
+
+  int* lines = (int*)malloc(profile->num_lines * sizeof(int));
+  int num_lines = 0;
+  long long total = 0;
+
+  for (int line = 1; line < profile->num_lines; line++) {
+    if (profile->hits[line] > 0) {
+      lines[num_lines++] = line;
+      total += profile->ticks[line];
+    }
+  }
+
+  sort_ticks = profile->ticks;
+  qsort(lines, num_lines, sizeof(int), compare_lines);
+  sort_ticks = NULL;
+
+  printf("**PROFILE**\n");
+  printf("%8s %12s %16s %8s %12s\n", "line", "hits", "ticks", "% time", "ms");
+
+  for (int i = 0; i < num_lines; i++) {
+    int line = lines[i];
+    double share = (total > 0) ? 100.0 * profile->ticks[line] / total : 0.0;
+
+    printf("%8d %12ld %16lld %8.2f %12.3f\n", line, profile->hits[line],
+      profile->ticks[line], share, profile->ticks[line] * ns_per_tick / 1e6);
+  }
+
+  printf("**END PROFILE**\n");
+
+  free(lines);
+}
+
+
+//
+// profile_destroy
+//
+// Frees the profile.
+//
+void profile_destroy(struct PROFILE* profile)
+{
+  free(profile->hits);
+  free(profile->ticks);
+  free(profile);
+}
@@ -0,0 +1,91 @@
+/*profile.h*/
+
+//
+// Line-level execution profile for nuPython (see --profile in
+// main.c). While the program runs, each source line gets a count
+// of how many times a statement on it was executed, and the time
+// that took, measured with a monotonic cycle counter: the time
+// stamp counter on x86-64, CLOCK_MONOTONIC nanoseconds elsewhere.
+// A while loop's line is charged for evaluating its condition,
+// not for its body.
+//
+// Profiling is done by a separate executor, execute_profiled (see
+// execute.h), so execute itself pays nothing for it.
+//
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define PROFILE_TSC
+#include <x86intrin.h>  // __rdtsc
+#endif
+
+
+struct PROFILE
+{
+  long*      hits;      // hits[line], statements executed
+  long long* ticks;     // ticks[line], of the counter
+  int        num_lines; // size of the arrays, the last line + 1
+
+  //
+  // where the run started, to convert ticks to time:
+  //
+  long long start_ticks;
+  long long start_ns;     // profile_clock
+};
+
+
+long long profile_clock(void);  // CLOCK_MONOTONIC, in ns
+
+//
+// profile_ticks
+//
+// The cycle counter, now.
+//
+static inline long long profile_ticks(void)
+{
+#if defined(PROFILE_TSC)
+  return (long long)__rdtsc();
+#else
+  return profile_clock();
+#endif
+}
+
+
+//
+// Public functions:
+//
+
+//
+// profile_init
+//
+// Returns a new, empty profile, and starts the clock for
+// converting ticks to time.
+//
+struct PROFILE* profile_init(void);
+
+//
+// profile_add
+//
+// Charges one hit, and the given number of ticks, to the given
+// line; lines < 1 (no line) are ignored.
+//
+void profile_add(struct PROFILE* profile, int line, long long ticks);
+
+//
+// profile_print
+//
+// Prints the profile, between **PROFILE** and **END PROFILE**:
+// one row per line that was executed, with its hits, ticks, the
+// share of the total and the time in ms, the most time first.
+//
+void profile_print(struct PROFILE* profile);
+
+//
+// profile_destroy
+//
+// Frees the profile.
+//
+void profile_destroy(struct PROFILE* profile);
@@ -0,0 +1,42 @@
+#
+# test09.py
+#
+# a loop-heavy nuPython program: nested while loops with int,
+# real and string operations
+#
+print("")
+print("TEST CASE: test09.py")
+print("")
+
+total = 0
+product = 1.0
+s = ""
+i = 0
+while i < 1000:
+{
+  j = 0
+  while j < 100:
+  {
+    total = total + j
+    j = j + 1
+  }
+  product = product * 1.001
+  i = i + 1
+}
+
+k = 0
+while k < 5:
+{
+  s = s + "ab"
+  k = k + 1
+}
+
+big = total > 4000000
+print(total)
+print(product)
+print(s)
+print(big)
+
+print("")
+print("DONE")
+print("")
@@ -12,6 +12,81 @@
 #include <assert.h>
 
 #include "ram.h"
+#include "str.h"
+#include "dtoa.h"
+
+
+//
+// Private functions:
+//
+
+//
+// ram_hash
+//
+// FNV-1a hash of the given identifier.
+//
+static unsigned int ram_hash(char* identifier)
+{
+  unsigned int hash = 2166136261u;
+
+  for (char* p = identifier; *p != '\0'; p++) {
+    hash ^= (unsigned char)*p;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+//
+// ram_index_find
+//
+// Returns the position in the hash index where the given identifier
+// lives, or the position of the empty entry where it would be
+// inserted if it's not in memory yet.
+//
+static int ram_index_find(struct RAM* memory, char* identifier, unsigned int hash)
+{
+  int mask = memory->index_capacity - 1;
+  int pos = (int)(hash & (unsigned int)mask);
+
+  while (memory->index[pos].addr != -1) {
+    if (memory->index[pos].hash == hash &&
+        strcmp(identifier, memory->cells[memory->index[pos].addr].identifier) == 0) {
+      return pos;
+    }
+    pos = (pos + 1) & mask;
+  }
+  return pos;
+}
+
+//
+// ram_index_grow
+//
+// Doubles the size of the hash index and re-inserts the existing
+// entries. Addresses are untouched, only the index moves.
+//
+static void ram_index_grow(struct RAM* memory)
+{
+  int old_capacity = memory->index_capacity;
+  struct RAM_INDEX_ENTRY* old_index = memory->index;
+
+  memory->index_capacity = old_capacity * 2;
+  memory->index = (struct RAM_INDEX_ENTRY*)malloc(memory->index_capacity * sizeof(struct RAM_INDEX_ENTRY));
+  for (int i = 0; i < memory->index_capacity; i++) {
+    memory->index[i].addr = -1;
+  }
+
+  int mask = memory->index_capacity - 1;
+  for (int i = 0; i < old_capacity; i++) {
+    if (old_index[i].addr != -1) {
+      int pos = (int)(old_index[i].hash & (unsigned int)mask);
+      while (memory->index[pos].addr != -1) {
+        pos = (pos + 1) & mask;
+      }
+      memory->index[pos] = old_index[i];
+    }
+  }
+  free(old_index);
+}
 
 
 //
@@ -36,6 +111,12 @@ struct RAM* ram_init(void)
     memory->cells[i].identifier = NULL;
     memory->cells[i].value.value_type = RAM_TYPE_NONE;
   }
+
+  memory->index_capacity = 8;
+  memory->index = (struct RAM_INDEX_ENTRY*)malloc(memory->index_capacity * sizeof(struct RAM_INDEX_ENTRY));
+  for (int i = 0; i < memory->index_capacity; i++) {
+    memory->index[i].addr = -1;
+  }
   return memory;
 }
 
@@ -52,10 +133,11 @@ void ram_destroy(struct RAM* memory)
   for (int i = 0; i < memory->num_values; i++) {
     free(memory->cells[i].identifier);
     if (memory->cells[i].value.value_type==RAM_TYPE_STR){
-      free(memory->cells[i].value.types.s);
+      str_release(memory->cells[i].value.types.s);
     }
   }
   free(memory->cells);
+  free(memory->index);
   free(memory);
   return;
 }
@@ -76,12 +158,9 @@ void ram_destroy(struct RAM* memory)
 //
 int ram_get_addr(struct RAM* memory, char* identifier)
 {
-  for (int i = 0; i < memory->num_values; i++) {
-    if (strcmp(identifier, memory->cells[i].identifier) == 0) {
-      return i;
-    }
-  }
-  return -1;
+  int pos = ram_index_find(memory, identifier, ram_hash(identifier));
+
+  return memory->index[pos].addr;  // -1 if we landed on an empty entry
 }
 
 
@@ -106,9 +185,7 @@ struct RAM_VALUE* ram_read_cell_by_addr(struct RAM* memory, int address)
     struct RAM_VALUE* to_return = (struct RAM_VALUE*)malloc(sizeof(struct RAM_VALUE));
     if (memory->cells[address].value.value_type== RAM_TYPE_STR) {
       to_return->value_type = RAM_TYPE_STR;
-      char* strcopy = (char *)malloc((strlen(memory->cells[address].value.types.s) + 1) * sizeof(char));
-      strcpy(strcopy, memory->cells[address].value.types.s);
-      to_return->types.s = strcopy;
+      to_return->types.s = str_dup(memory->cells[address].value.types.s);
     }
     else {
       *to_return = memory->cells[address].value;
@@ -144,6 +221,40 @@ struct RAM_VALUE* ram_read_cell_by_name(struct RAM* memory, char* name)
 }
 
 
+//
+// ram_peek_cell_by_addr
+//
+// Given a memory address (an integer in the range 0..N-1),
+// returns a pointer to the value stored in that memory cell,
+// without making a copy. Returns NULL if the address is not
+// valid. See ram.h for how long the pointer stays valid.
+//
+const struct RAM_VALUE* ram_peek_cell_by_addr(struct RAM* memory, int address)
+{
+  if (address < memory->num_values && address >= 0) {
+    return &memory->cells[address].value;
+  }
+  return NULL;
+}
+
+
+//
+// ram_peek_cell_by_name
+//
+// If the given name (e.g. "x") has been written to memory,
+// returns a pointer to the value stored in memory, without
+// making a copy. Returns NULL if no such name exists in memory.
+//
+const struct RAM_VALUE* ram_peek_cell_by_name(struct RAM* memory, char* name)
+{
+  int addr = ram_get_addr(memory, name);
+  if (addr != -1) {
+    return &memory->cells[addr].value;
+  }
+  return NULL;
+}
+
+
 //
 // ram_free_value
 //
@@ -153,7 +264,7 @@ struct RAM_VALUE* ram_read_cell_by_name(struct RAM* memory, char* name)
 void ram_free_value(struct RAM_VALUE* value)
 {
   if (value->value_type==RAM_TYPE_STR){
-    free(value->types.s);
+    str_release(value->types.s);
   }
   free(value);
   return;
@@ -162,48 +273,44 @@ void ram_free_value(struct RAM_VALUE* value)
 //
 // put_str_in_value
 //
-// takes a RAM_VALUE that holds a string, makes a copy of the string, and sets the value of the given cell of memory to that string
+// takes a RAM_VALUE that holds a string and sets the value of the given cell of memory to that string:
+// a copy of it, or with move, the string itself (a STR whose reference the caller gives up)
 // returns nothing
 
-void put_str_in_value(struct RAM* memory, struct RAM_VALUE value, int i) {
-  char* strcopy = (char *)malloc((strlen(value.types.s) + 1) * sizeof(char));
-  strcpy(strcopy, value.types.s);
+void put_str_in_value(struct RAM* memory, struct RAM_VALUE value, int i, bool move) {
   memory->cells[i].value.value_type = RAM_TYPE_STR;
-  memory->cells[i].value.types.s = strcopy;
+  memory->cells[i].value.types.s = move ? value.types.s : str_dup(value.types.s);
   return;
 }
 
 //
-// ram_write_cell_by_addr
+// write_cell_by_addr
 //
-// Writes the given value to the memory cell at the given 
-// address. If a value already exists at this address, that
-// value is overwritten by this new value. Returns true if 
-// the value was successfully written, false if not (which 
-// implies the memory address is invalid).
-// 
-// NOTE: if the value being written is a string, it will
-// be duplicated and stored.
-// 
-// NOTE: a variable has to be written to memory before its
-// address becomes valid. Once a variable is written to memory,
-// its address never changes.
+// Writes the value to the cell at the given address, copying a
+// string or, with move, taking it over. Returns false if the
+// address is invalid (a moved string is then still the caller's).
 //
-bool ram_write_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int address)
+static bool write_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int address, bool move)
 {
   //if the address exists
 
   //if it is a string
   if (address<memory->num_values && address>=0) {
-    if(memory->cells[address].value.value_type == RAM_TYPE_STR) {
-      free(memory->cells[address].value.types.s);
-    }
+    //
+    // save the old value and free it after the write, since the
+    // new value may be a borrowed view of the old one (x = x):
+    //
+    struct RAM_VALUE old_value = memory->cells[address].value;
+
     if (value.value_type == RAM_TYPE_STR) {
-      put_str_in_value(memory, value, address);
+      put_str_in_value(memory, value, address, move);
     }
     else {
         memory->cells[address].value = value;
     }
+    if(old_value.value_type == RAM_TYPE_STR) {
+      str_release(old_value.types.s);
+    }
     return true;
   }
 
@@ -211,6 +318,84 @@ bool ram_write_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int addr
   return false;
 }
 
+//
+// write_cell_by_name
+//
+// Writes the value to the cell with the given name, creating the
+// cell if needed, copying a string or, with move, taking it over.
+//
+static bool write_cell_by_name(struct RAM* memory, struct RAM_VALUE value, char* name, bool move)
+{
+  unsigned int hash = ram_hash(name);
+  int pos = ram_index_find(memory, name, hash);
+
+  if (memory->index[pos].addr != -1) {
+    //
+    // already in memory, overwrite in place:
+    //
+    return write_cell_by_addr(memory, value, memory->index[pos].addr, move);
+  }
+
+  //resize if not big enough
+  if (memory->capacity == memory->num_values) {
+    int new_capacity = memory->capacity*2; 
+    struct RAM_CELL* new_array = (struct RAM_CELL*)malloc(new_capacity * sizeof(struct RAM_CELL));
+    for (int i = 0; i < memory->capacity; i++) {
+      new_array[i] = memory->cells[i];
+    }
+    for (int i = memory->capacity; i < new_capacity; i++) {
+      new_array[i].identifier = NULL;
+      new_array[i].value.value_type = RAM_TYPE_NONE;
+    }
+    
+    free(memory->cells);
+    memory->cells = new_array;
+    memory->capacity = new_capacity;
+  }
+  //write cell by name
+  int addr = memory->num_values;
+  memory->cells[addr].identifier = (char*)malloc(sizeof(char)*(strlen(name)+1));
+  strcpy(memory->cells[addr].identifier, name);
+  if (value.value_type == RAM_TYPE_STR) {
+    put_str_in_value(memory, value, addr, move);
+  }
+  else {
+    memory->cells[addr].value = value;
+  }
+  memory->num_values++;
+
+  //
+  // add to the index, keeping the load factor at most 1/2:
+  //
+  memory->index[pos].hash = hash;
+  memory->index[pos].addr = addr;
+  if (memory->num_values * 2 > memory->index_capacity) {
+    ram_index_grow(memory);
+  }
+  return true;
+}
+
+//
+// ram_write_cell_by_addr
+//
+// Writes the given value to the memory cell at the given 
+// address. If a value already exists at this address, that
+// value is overwritten by this new value. Returns true if 
+// the value was successfully written, false if not (which 
+// implies the memory address is invalid).
+// 
+// NOTE: if the value being written is a string, it will
+// be duplicated and stored.
+// 
+// NOTE: a variable has to be written to memory before its
+// address becomes valid. Once a variable is written to memory,
+// its address never changes.
+//
+bool ram_write_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int address)
+{
+  return write_cell_by_addr(memory, value, address, false);
+}
+
 
 //
 // ram_write_cell_by_name
@@ -227,56 +412,51 @@ bool ram_write_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int addr
 // address becomes valid. Once a variable is written to memory,
 // its address never changes.
 //
+bool ram_write_cell_by_name(struct RAM* memory, struct RAM_VALUE value, char* name)
+{
+  return write_cell_by_name(memory, value, name, false);
+}
+
 
+//
+// ram_move_cell_by_addr
+//
+// Same as ram_write_cell_by_addr, except that a string is not
+// duplicated: memory takes over the caller's reference to it.
+//
+bool ram_move_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int address)
+{
+  return write_cell_by_addr(memory, value, address, true);
+}
 
 
-bool ram_write_cell_by_name(struct RAM* memory, struct RAM_VALUE value, char* name)
+//
+// ram_move_cell_by_name
+//
+// Same as ram_write_cell_by_name, except that a string is not
+// duplicated: memory takes over the caller's reference to it.
+//
+bool ram_move_cell_by_name(struct RAM* memory, struct RAM_VALUE value, char* name)
 {
-  bool existed = false;
-  for (int i = 0; i < memory->num_values; i++) {
-    if (strcmp(name, memory->cells[i].identifier) == 0) {
-      // if orginal value was string, must free
-      if(memory->cells[i].value.value_type == RAM_TYPE_STR) {
-        free(memory->cells[i].value.types.s);
-      }
-      if (value.value_type == RAM_TYPE_STR) {
-        put_str_in_value(memory, value, i);
-      }
-      else {
-        memory->cells[i].value = value;
-      }
-      existed = true;
-    }
-  }
-  if (!existed) {
-    //resize if not big enough
-    if (memory->capacity == memory->num_values) {
-      int new_capacity = memory->capacity*2; 
-      struct RAM_CELL* new_array = (struct RAM_CELL*)malloc(new_capacity * sizeof(struct RAM_CELL));
-      for (int i = 0; i < memory->capacity; i++) {
-        new_array[i] = memory->cells[i];
-      }
-      for (int i = memory->capacity; i < new_capacity; i++) {
-        new_array[i].identifier = NULL;
-        new_array[i].value.value_type = RAM_TYPE_NONE;
-      }
-      
-      free(memory->cells);
-      memory->cells = new_array;
-      memory->capacity = new_capacity;
-    }
-    //write cell by name
-    //memory->cells[memory->num_values].identifier = name;
-    memory->cells[memory->num_values].identifier = (char*)malloc(sizeof(char)*(strlen(name)+1));
-    strcpy(memory->cells[memory->num_values].identifier, name);
-    if (value.value_type == RAM_TYPE_STR) {
-      put_str_in_value(memory, value, memory->num_values);
-    }
-    else {
-      memory->cells[memory->num_values].value = value;
-    }
-    memory->num_values++;
+  return write_cell_by_name(memory, value, name, true);
+}
+
+
+//
+// ram_append_str_by_addr
+//
+// Appends the given string to the string stored at the given
+// address, in place unless the stored string is shared. Returns
+// false if the address is invalid or doesn't hold a string.
+//
+bool ram_append_str_by_addr(struct RAM* memory, const char* s, int address)
+{
+  if (address >= memory->num_values || address < 0 ||
+      memory->cells[address].value.value_type != RAM_TYPE_STR) {
+    return false;
   }
+
+  memory->cells[address].value.types.s = str_append(memory->cells[address].value.types.s, s);
   return true;
 }
 
@@ -302,9 +482,13 @@ void ram_print(struct RAM* memory)
         case RAM_TYPE_INT:
           printf("int, %d", memory->cells[i].value.types.i);
           break;
-        case RAM_TYPE_REAL:
-          printf("real, %lf", memory->cells[i].value.types.d);
+        case RAM_TYPE_REAL: {
+          char digits[DTOA_BUFFER_SIZE];
+
+          dtoa_format(memory->cells[i].value.types.d, digits);
+          printf("real, %s", digits);
           break;
+        }
         case RAM_TYPE_STR:
           printf("str, '%s'", memory->cells[i].value.types.s);
           break;
@@ -36,7 +36,7 @@ struct RAM_VALUE
   {
     int    i; // INT, PTR, BOOLEAN
     double d; // REAL
-    char*  s; // STR 
+    char*  s; // STR, in a memory cell always a STR of str.h
   } types;
 };
 
@@ -46,11 +46,26 @@ struct RAM_CELL
   struct RAM_VALUE value;
 };
 
+//
+// Hash index over the cell identifiers, so that lookups by name
+// don't have to scan every cell. Open addressing with linear
+// probing; each entry stores the full hash so most mismatches are
+// rejected without a strcmp. An entry with addr == -1 is empty.
+//
+struct RAM_INDEX_ENTRY
+{
+  unsigned int hash;  // hash of cells[addr].identifier
+  int addr;           // address of the cell, -1 => empty entry
+};
+
 struct RAM
 {
   struct RAM_CELL* cells;  // array of memory cells
   int num_values;  // # of values currently stored in memory
   int capacity;    // total # of cells available in memory
+
+  struct RAM_INDEX_ENTRY* index;  // hash index: identifier => address
+  int index_capacity;             // # of entries, always a power of 2
 };
 
 
@@ -121,6 +136,34 @@ struct RAM_VALUE* ram_read_cell_by_addr(struct RAM* memory, int address);
 //
 struct RAM_VALUE* ram_read_cell_by_name(struct RAM* memory, char* identifier);
 
+//
+// ram_peek_cell_by_addr
+//
+// Given a memory address (an integer in the range 0..N-1),
+// returns a pointer to the value stored in that memory cell.
+// Returns NULL if the address is not valid. Unlike the read
+// functions above, nothing is copied: this is a borrowed view
+// of the value, strings included, and costs O(1) regardless of
+// the length of a string.
+//
+// NOTE: the caller must not modify or free the value. The
+// pointer stays valid until the next write to that cell, or
+// until a new variable is written to memory (which may grow
+// the memory and move the cells), whichever comes first. Use
+// ram_read_cell_by_addr if you need a value that lives longer.
+//
+const struct RAM_VALUE* ram_peek_cell_by_addr(struct RAM* memory, int address);
+
+//
+// ram_peek_cell_by_name
+//
+// If the given identifier (e.g. "x") has been written to
+// memory, returns a pointer to the value stored in memory,
+// without making a copy. Returns NULL if no such identifier
+// exists in memory. Same rules as ram_peek_cell_by_addr.
+//
+const struct RAM_VALUE* ram_peek_cell_by_name(struct RAM* memory, char* identifier);
+
 //
 // ram_free_value
 //
@@ -164,6 +207,41 @@ bool ram_write_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int addr
 //
 bool ram_write_cell_by_name(struct RAM* memory, struct RAM_VALUE value, char* identifier);
 
+//
+// ram_move_cell_by_addr
+//
+// Same as ram_write_cell_by_addr, except that if the value being
+// written is a string, it must be a STR (see str.h) holding a
+// reference that the caller gives to memory: the string itself is
+// stored, not a copy. If false is returned, the reference is still
+// the caller's.
+//
+bool ram_move_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int address);
+
+//
+// ram_move_cell_by_name
+//
+// Same as ram_write_cell_by_name, except that a string is stored
+// without being duplicated, as for ram_move_cell_by_addr.
+//
+bool ram_move_cell_by_name(struct RAM* memory, struct RAM_VALUE value, char* identifier);
+
+//
+// ram_append_str_by_addr
+//
+// Appends the given string to the string stored at the given
+// address, as in x = x + s. If memory holds the only reference
+// to the stored string, it grows in place, so appending takes
+// time proportional to the length of s, not of x (amortized).
+// Returns true if successful, false if the address is not valid
+// or the value stored there is not a string. s may be the stored
+// string itself.
+//
+// NOTE: the stored string may move, so pointers to it from
+// ram_peek_cell_by_addr or _by_name are no longer valid.
+//
+bool ram_append_str_by_addr(struct RAM* memory, const char* s, int address);
+
 //
 // ram_print
 //
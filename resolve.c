@@ -0,0 +1,255 @@
+/*resolve.c*/
+
+//
+// Symbol resolution for nuPython: maps every identifier in the
+// program graph to a fixed slot, see resolve.h.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+#include <assert.h>
+
+#include "programgraph.h"
+#include "ram.h"
+#include "values.h"
+#include "nodemap.h"
+#include "resolve.h"
+
+
+//
+// Private functions:
+//
+
+//
+// slot_for_name
+//
+// Returns the slot for the given name, adding a new symbol if
+// this is the first time the name is seen. The names are kept
+// in a private RAM, whose hash index hands out addresses in
+// order of first write --- exactly the slot numbering we want.
+//
+static int slot_for_name(struct SYMTAB* symtab, char* name)
+{
+  int slot = ram_get_addr(symtab->names, name);
+
+  if (slot != -1)
+    return slot;
+
+  struct RAM_VALUE none;
+  none.value_type = RAM_TYPE_NONE;
+
+  ram_write_cell_by_name(symtab->names, none, name);
+  slot = symtab->num_symbols;
+  assert(slot == symtab->names->num_values - 1);
+
+  if (symtab->num_symbols == symtab->capacity) {
+    symtab->capacity *= 2;
+    symtab->symbols = (struct SYMBOL*)realloc(symtab->symbols, symtab->capacity * sizeof(struct SYMBOL));
+  }
+
+  symtab->symbols[slot].name = symtab->names->cells[slot].identifier;
+  symtab->symbols[slot].addr = -1;
+  symtab->num_symbols++;
+
+  return slot;
+}
+
+//
+// add_ref
+//
+// Records that the given graph node names the given variable.
+//
+static void add_ref(struct SYMTAB* symtab, void* node, char* name)
+{
+  nodemap_put(symtab->refs, node, slot_for_name(symtab, name));
+}
+
+//
+// add_constant
+//
+// Parses the literal held by the given element and records it as
+// a constant. Returns false if the literal is out of range.
+//
+static bool add_constant(struct SYMTAB* symtab, struct ELEMENT* element, int line)
+{
+  struct RAM_VALUE value;
+
+  if (!parse_literal(element, &value)) {
+    printf("**SEMANTIC ERROR: %s literal '%s' is out of range (line %d)\n",
+      element->element_type == ELEMENT_INT_LITERAL ? "int" : "real", element->element_value, line);
+    return false;
+  }
+
+  if (value.value_type == RAM_TYPE_NONE)
+    return true;
+
+  if (symtab->num_constants == symtab->const_capacity) {
+    symtab->const_capacity *= 2;
+    symtab->constants = (struct RAM_VALUE*)realloc(symtab->constants, symtab->const_capacity * sizeof(struct RAM_VALUE));
+  }
+
+  nodemap_put(symtab->refs, element, symtab->num_constants);
+
+  symtab->constants[symtab->num_constants] = value;
+  symtab->num_constants++;
+
+  return true;
+}
+
+static bool resolve_element(struct SYMTAB* symtab, struct ELEMENT* element, int line)
+{
+  if (element == NULL)
+    return true;
+
+  if (element->element_type == ELEMENT_IDENTIFIER) {
+    add_ref(symtab, element, element->element_value);
+    return true;
+  }
+
+  return add_constant(symtab, element, line);
+}
+
+static bool resolve_expr(struct SYMTAB* symtab, struct EXPR* expr, int line)
+{
+  bool valid = resolve_element(symtab, expr->lhs->element, line);
+
+  if (expr->isBinaryExpr) {
+    valid = resolve_element(symtab, expr->rhs->element, line) && valid;
+  }
+  return valid;
+}
+
+//
+// resolve_stmts
+//
+// Resolves the chain of statements starting at stmt, stopping at
+// the end of the program (NULL) or when the chain loops back to
+// the given while loop header (the end of a loop body). Returns
+// false if a literal is out of range, after resolving everything
+// else so that all such literals are reported.
+//
+static bool resolve_stmts(struct SYMTAB* symtab, struct STMT* stmt, struct STMT* loop_header)
+{
+  bool valid = true;
+
+  while (stmt != NULL && stmt != loop_header) {
+
+    if (stmt->stmt_type == STMT_ASSIGNMENT) {
+      struct STMT_ASSIGNMENT* assign = stmt->types.assignment;
+
+      add_ref(symtab, stmt, assign->var_name);
+
+      if (assign->rhs->value_type == VALUE_EXPR) {
+        valid = resolve_expr(symtab, assign->rhs->types.expr, stmt->line) && valid;
+      }
+      else {
+        valid = resolve_element(symtab, assign->rhs->types.function_call->parameter, stmt->line) && valid;
+      }
+
+      stmt = assign->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_FUNCTION_CALL) {
+      valid = resolve_element(symtab, stmt->types.function_call->parameter, stmt->line) && valid;
+
+      stmt = stmt->types.function_call->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+      valid = resolve_expr(symtab, stmt->types.while_loop->condition, stmt->line) && valid;
+      valid = resolve_stmts(symtab, stmt->types.while_loop->loop_body, stmt) && valid;
+
+      stmt = stmt->types.while_loop->next_stmt;
+    }
+    else {
+      assert(stmt->stmt_type == STMT_PASS);
+
+      stmt = stmt->types.pass->next_stmt;
+    }
+  }
+
+  return valid;
+}
+
+
+//
+// Public functions:
+//
+
+//
+// resolve_program
+//
+// Walks the given program graph and assigns a slot to every
+// distinct identifier, and parses every literal. Returns the
+// resulting symbol table, or NULL if a literal is out of range.
+//
+struct SYMTAB* resolve_program(struct STMT* program)
+{
+  struct SYMTAB* symtab = (struct SYMTAB*)malloc(sizeof(struct SYMTAB));
+
+  symtab->capacity = 4;
+  symtab->num_symbols = 0;
+  symtab->symbols = (struct SYMBOL*)malloc(symtab->capacity * sizeof(struct SYMBOL));
+
+  symtab->refs = nodemap_init();
+
+  symtab->names = ram_init();
+
+  symtab->const_capacity = 16;
+  symtab->num_constants = 0;
+  symtab->constants = (struct RAM_VALUE*)malloc(symtab->const_capacity * sizeof(struct RAM_VALUE));
+
+  if (!resolve_stmts(symtab, program, NULL)) {
+    resolve_destroy(symtab);
+    return NULL;
+  }
+
+  return symtab;
+}
+
+
+//
+// resolve_slot
+//
+// Returns the slot of the identifier named by the given graph
+// node, or -1 if the node does not name a variable.
+//
+int resolve_slot(struct SYMTAB* symtab, void* node)
+{
+  return nodemap_get(symtab->refs, node);
+}
+
+
+//
+// resolve_constant
+//
+// Returns the value of the literal held by the given element,
+// or NULL if the element is not a literal.
+//
+const struct RAM_VALUE* resolve_constant(struct SYMTAB* symtab, struct ELEMENT* element)
+{
+  if (element->element_type == ELEMENT_IDENTIFIER)
+    return NULL;
+
+  int constant = nodemap_get(symtab->refs, element);
+
+  if (constant == -1)
+    return NULL;
+
+  return &symtab->constants[constant];
+}
+
+
+//
+// resolve_destroy
+//
+// Frees the memory associated with the symbol table.
+//
+void resolve_destroy(struct SYMTAB* symtab)
+{
+  ram_destroy(symtab->names);
+  free(symtab->constants);
+  free(symtab->symbols);
+  nodemap_destroy(symtab->refs);
+  free(symtab);
+}
@@ -0,0 +1,97 @@
+/*resolve.h*/
+
+//
+// Symbol resolution for nuPython. After the program graph is
+// built, every identifier in the graph is resolved to a symbol,
+// i.e. a fixed slot number shared by all uses of the same name.
+// The executor then caches the RAM address of each slot the
+// first time it is written, so variables are read and written
+// by address instead of by name.
+//
+// Literals are resolved at the same time: each literal in the
+// graph is parsed once into a constant, so evaluating a literal
+// is a load instead of a call to atoi() or atof().
+//
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+
+#include "programgraph.h"
+#include "ram.h"
+#include "nodemap.h"
+
+
+struct SYMBOL
+{
+  char* name;  // variable name (owned by the symbol table)
+  int   addr;  // RAM address, -1 until the variable is first written
+};
+
+struct SYMTAB
+{
+  struct SYMBOL* symbols;  // array of symbols, indexed by slot
+  int num_symbols;
+  int capacity;
+
+  //
+  // references: an identifier ELEMENT or an assignment STMT =>
+  // the slot of the symbol it names, a literal ELEMENT => the
+  // index of its constant
+  //
+  struct NODE_MAP* refs;
+
+  struct RAM* names;        // name => slot, owns the symbol names
+
+  struct RAM_VALUE* constants;  // parsed literals, strings point into the graph
+  int num_constants;
+  int const_capacity;
+};
+
+
+//
+// Public functions:
+//
+
+//
+// resolve_program
+//
+// Walks the given program graph and assigns a slot to every
+// distinct identifier: assignment targets, identifiers in
+// expressions, and identifiers passed to function calls.
+// Every literal is parsed into a constant. Returns the resulting
+// symbol table; all addresses start out as -1 (not yet written).
+//
+// Returns NULL if an int or real literal is out of range (an
+// error message is output for each such literal).
+//
+// NOTE: the addresses cached in the symbol table belong to
+// one RAM, so use a symbol table with one memory only.
+//
+struct SYMTAB* resolve_program(struct STMT* program);
+
+//
+// resolve_slot
+//
+// Returns the slot of the identifier named by the given graph
+// node (an ELEMENT or an assignment STMT), or -1 if the node
+// does not name a variable.
+//
+int resolve_slot(struct SYMTAB* symtab, void* node);
+
+//
+// resolve_constant
+//
+// Returns the value of the literal held by the given ELEMENT,
+// or NULL if the element is not a literal (e.g. None). The
+// value is owned by the symbol table, and a string value by
+// the program graph.
+//
+const struct RAM_VALUE* resolve_constant(struct SYMTAB* symtab, struct ELEMENT* element);
+
+//
+// resolve_destroy
+//
+// Frees the memory associated with the symbol table.
+//
+void resolve_destroy(struct SYMTAB* symtab);
@@ -0,0 +1,253 @@
+/*sampler.c*/
+
+//
+// Sampling profiler for nuPython, see sampler.h.
+//
+
+// sigaction, setitimer
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+#include <signal.h>
+#include <sys/time.h>  // setitimer
+
+#include "programgraph.h"
+#include "sampler.h"
+
+
+//
+// the sampler started, for the signal handler:
+//
+static struct SAMPLER* active = NULL;
+
+
+//
+// Private functions:
+//
+
+//
+// take_sample
+//
+// The SIGPROF handler: counts a sample for the line being executed.
+//
+static void take_sample(int signum)
+{
+  struct SAMPLER* sampler = active;
+
+  if (sampler == NULL)
+    return;
+
+  int line = sampler->line;
+
+  if (line < 0 || line >= sampler->num_lines)
+    line = 0;
+
+  sampler->samples[line]++;
+}
+
+//
+// grow
+//
+// Grows the arrays of the sampler to hold the given line.
+//
+static void grow(struct SAMPLER* sampler, int line)
+{
+  int num_lines = 2 * sampler->num_lines;
+
+  if (num_lines <= line)
+    num_lines = line + 1;
+
+  sampler->samples = (long*)realloc(sampler->samples, num_lines * sizeof(long));
+  sampler->loop = (int*)realloc(sampler->loop, num_lines * sizeof(int));
+  sampler->is_loop = (bool*)realloc(sampler->is_loop, num_lines * sizeof(bool));
+
+  if (sampler->samples == NULL || sampler->loop == NULL || sampler->is_loop == NULL) {
+    printf("**INTERNAL ERROR: out of memory (sampler grow)\n");
+    exit(-1);
+  }
+
+  int added = num_lines - sampler->num_lines;
+
+  memset(sampler->samples + sampler->num_lines, 0, added * sizeof(long));
+  memset(sampler->loop + sampler->num_lines, -1, added * sizeof(int));  // no statement
+  memset(sampler->is_loop + sampler->num_lines, 0, added * sizeof(bool));
+
+  sampler->num_lines = num_lines;
+}
+
+//
+// note_line
+//
+// Notes the statement on the given line, in the given loop (the
+// loop's line, 0 if none); the first statement on a line wins.
+//
+static void note_line(struct SAMPLER* sampler, int line, int loop, bool is_loop)
+{
+  if (line < 1)
+    return;
+
+  if (line >= sampler->num_lines)
+    grow(sampler, line);
+
+  if (sampler->loop[line] < 0) {
+    sampler->loop[line] = loop;
+    sampler->is_loop[line] = is_loop;
+  }
+}
+
+//
+// note_stmts
+//
+// Notes the lines of the chain of statements starting at stmt, in
+// the given loop, stopping at the end of the program (NULL) or when
+// the chain loops back to the given while loop header.
+//
+static void note_stmts(struct SAMPLER* sampler, struct STMT* stmt, struct STMT* loop_header, int loop)
+{
+  while (stmt != NULL && stmt != loop_header) {
+    if (stmt->stmt_type == STMT_ASSIGNMENT) {
+      note_line(sampler, stmt->line, loop, false);
+      stmt = stmt->types.assignment->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_FUNCTION_CALL) {
+      note_line(sampler, stmt->line, loop, false);
+      stmt = stmt->types.function_call->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+      note_line(sampler, stmt->line, loop, true);
+      note_stmts(sampler, stmt->types.while_loop->loop_body, stmt, stmt->line);
+      stmt = stmt->types.while_loop->next_stmt;
+    }
+    else {
+      note_line(sampler, stmt->line, loop, false);
+      stmt = stmt->types.pass->next_stmt;
+    }
+  }
+}
+
+//
+// print_frames
+//
+// Outputs the frames of the given line, outermost first.
+//
+static void print_frames(struct SAMPLER* sampler, int line, FILE* output)
+{
+  if (sampler->loop[line] > 0 && sampler->loop[line] != line) {
+    print_frames(sampler, sampler->loop[line], output);
+    fputc(';', output);
+  }
+  else
+    fputs("<module>;", output);
+
+  fprintf(output, "%s:%d", sampler->is_loop[line] ? "while" : "line", line);
+}
+
+
+//
+// Public functions:
+//
+
+//
+// sampler_init
+//
+// Returns a new sampler for the program.
+//
+struct SAMPLER* sampler_init(struct STMT* program, int hz)
+{
+  struct SAMPLER* sampler = (struct SAMPLER*)malloc(sizeof(struct SAMPLER));
+
+  sampler->line = 0;
+  sampler->samples = NULL;
+  sampler->loop = NULL;
+  sampler->is_loop = NULL;
+  sampler->num_lines = 0;
+  sampler->hz = hz;
+
+  grow(sampler, 63);  // line 0 is for no line
+  note_stmts(sampler, program, NULL, 0);
+
+  return sampler;
+}
+
+
+//
+// sampler_start
+//
+// Starts taking samples.
+//
+void sampler_start(struct SAMPLER* sampler)
+{
+  struct sigaction action;
+
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = take_sample;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+
+  active = sampler;
+  sigaction(SIGPROF, &action, &sampler->previous);
+
+  struct itimerval timer;
+
+  timer.it_interval.tv_sec = 0;
+  timer.it_interval.tv_usec = (sampler->hz > 1) ? 1000000 / sampler->hz : 999999;
+  timer.it_value = timer.it_interval;
+
+  setitimer(ITIMER_PROF, &timer, NULL);
+}
+
+
+//
+// sampler_stop
+//
+// Stops taking samples.
+//
+void sampler_stop(struct SAMPLER* sampler)
+{
+  struct itimerval timer;
+
+  memset(&timer, 0, sizeof(timer));
+  setitimer(ITIMER_PROF, &timer, NULL);
+
+  sigaction(SIGPROF, &sampler->previous, NULL);
+  active = NULL;
+}
+
+
+//
+// sampler_print
+//
+// Outputs the samples as folded stacks.
+//
+void sampler_print(struct SAMPLER* sampler, FILE* output)
+{
+  if (sampler->samples[0] > 0)
+    fprintf(output, "<module> %ld\n", sampler->samples[0]);
+
+  for (int line = 1; line < sampler->num_lines; line++) {
+    if (sampler->samples[line] == 0 || sampler->loop[line] < 0)
+      continue;
+
+    print_frames(sampler, line, output);
+    fprintf(output, " %ld\n", sampler->samples[line]);
+  }
+
+  fflush(output);
+}
+
+
+//
+// sampler_destroy
+//
+// Frees the sampler.
+//
+void sampler_destroy(struct SAMPLER* sampler)
+{
+  free(sampler->samples);
+  free(sampler->loop);
+  free(sampler->is_loop);
+  free(sampler);
+}
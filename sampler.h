@@ -0,0 +1,89 @@
+/*sampler.h*/
+
+//
+// Sampling profiler for nuPython (see --sample in main.c). While
+// the program runs, the executor publishes the line of the statement
+// it's executing (see execute_sampled in execute.h), and a SIGPROF
+// timer interrupts it the given number of times per second of CPU
+// time to count a sample for that line. Unlike profile.h, nothing is
+// measured per statement, so tight loops run at full speed.
+//
+// The samples are output as folded stacks, one line per source line
+// sampled, which flame graph tools (e.g. flamegraph.pl) read as is:
+//
+//   <module>;while:3;line:5 812
+//
+// where the frames are the while loops around the line, outermost
+// first, and a loop's own samples (evaluating its condition) are
+// the loop's frame alone. Samples taken before the first statement
+// are <module>'s. The kernel delivers SIGPROF at most once per
+// scheduler tick, so rates above CONFIG_HZ (typically 250 or 1000)
+// give fewer samples than asked for.
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stdbool.h>  // true, false
+#include <signal.h>   // sig_atomic_t
+
+#include "programgraph.h"
+
+
+#define SAMPLER_DEFAULT_HZ  997  // prime, so it doesn't beat with loops
+
+struct SAMPLER
+{
+  volatile sig_atomic_t line;  // being executed, 0 if none
+
+  long* samples;    // samples[line]
+  int*  loop;       // loop[line], the line of the enclosing loop, 0 if none
+  bool* is_loop;    // is_loop[line], a while loop starts there
+  int   num_lines;  // size of the arrays, the last line + 1
+
+  int   hz;         // samples per second of CPU time
+  struct sigaction previous;  // handler, while sampling
+};
+
+
+//
+// Public functions:
+//
+
+//
+// sampler_init
+//
+// Returns a new sampler for the given program, which takes the
+// given number of samples per second (of CPU time) once started.
+//
+struct SAMPLER* sampler_init(struct STMT* program, int hz);
+
+//
+// sampler_start
+//
+// Installs the SIGPROF handler and starts the timer. One sampler
+// at a time can be started.
+//
+void sampler_start(struct SAMPLER* sampler);
+
+//
+// sampler_stop
+//
+// Stops the timer, and restores the previous SIGPROF handler.
+//
+void sampler_stop(struct SAMPLER* sampler);
+
+//
+// sampler_print
+//
+// Outputs the samples as folded stacks to the given file, in the
+// order of the lines; lines without samples are left out.
+//
+void sampler_print(struct SAMPLER* sampler, FILE* output);
+
+//
+// sampler_destroy
+//
+// Frees the sampler.
+//
+void sampler_destroy(struct SAMPLER* sampler);
@@ -0,0 +1,382 @@
+/*stats.c*/
+
+//
+// Run statistics for nuPython, see stats.h.
+//
+
+// clock_gettime, getrusage
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>  // getrusage
+
+#include "programgraph.h"
+#include "stats.h"
+
+
+//
+// the allocator, as counted by the wrappers below; the scanner
+// thread allocates too (see tokenring.h), so the counts are atomic:
+//
+static long num_allocs = 0;
+static long num_bytes = 0;
+static long num_frees = 0;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* p, size_t size);
+void* __real_aligned_alloc(size_t alignment, size_t size);
+void  __real_free(void* p);
+
+
+//
+// Allocator wrappers, see stats.h:
+//
+
+static void count_alloc(size_t size)
+{
+  __atomic_fetch_add(&num_allocs, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&num_bytes, (long)size, __ATOMIC_RELAXED);
+}
+
+void* __wrap_malloc(size_t size)
+{
+  count_alloc(size);
+  return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size)
+{
+  count_alloc(count * size);
+  return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* p, size_t size)
+{
+  count_alloc(size);
+  return __real_realloc(p, size);
+}
+
+void* __wrap_aligned_alloc(size_t alignment, size_t size)
+{
+  count_alloc(size);
+  return __real_aligned_alloc(alignment, size);
+}
+
+void __wrap_free(void* p)
+{
+  if (p != NULL)
+    __atomic_fetch_add(&num_frees, 1, __ATOMIC_RELAXED);
+
+  __real_free(p);
+}
+
+
+//
+// Private functions:
+//
+
+//
+// wall_seconds
+//
+static double wall_seconds(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+//
+// cpu_seconds
+//
+// User + system time of the process (all threads) so far.
+//
+static double cpu_seconds(void)
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+         usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+//
+// reset_peak_rss
+//
+// Resets the process' peak RSS to its current RSS, so the next
+// peak_rss is the peak since now. Linux only; elsewhere (or if it
+// fails) peak_rss is the peak since the process started.
+//
+static void reset_peak_rss(void)
+{
+  FILE* clear_refs = fopen("/proc/self/clear_refs", "w");
+
+  if (clear_refs != NULL) {
+    fputs("5", clear_refs);
+    fclose(clear_refs);
+  }
+}
+
+//
+// peak_rss
+//
+// The process' peak RSS in KB, see reset_peak_rss.
+//
+static long peak_rss(void)
+{
+  FILE* status = fopen("/proc/self/status", "r");
+  long kb = -1;
+
+  if (status != NULL) {
+    char line[256];
+
+    while (fgets(line, sizeof(line), status) != NULL) {
+      if (strncmp(line, "VmHWM:", 6) == 0) {
+        kb = atol(line + 6);
+        break;
+      }
+    }
+    fclose(status);
+  }
+
+  if (kb < 0) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    kb = usage.ru_maxrss;
+  }
+
+  return kb;
+}
+
+//
+// count_element
+//
+static long count_element(struct ELEMENT* element)
+{
+  return (element != NULL) ? 1 : 0;
+}
+
+//
+// count_expr
+//
+// The expression, its unary expressions and their elements.
+//
+static long count_expr(struct EXPR* expr)
+{
+  long count = 1 + 1 + count_element(expr->lhs->element);
+
+  if (expr->isBinaryExpr)
+    count += 1 + count_element(expr->rhs->element);
+
+  return count;
+}
+
+//
+// count_stmts
+//
+// Counts the nodes of the chain of statements starting at stmt,
+// stopping at the end of the program (NULL) or when the chain
+// loops back to the given while loop header.
+//
+static long count_stmts(struct STMT* stmt, struct STMT* loop_header)
+{
+  long count = 0;
+
+  while (stmt != NULL && stmt != loop_header) {
+    count += 2;  // the STMT, and its type-specific struct
+
+    if (stmt->stmt_type == STMT_ASSIGNMENT) {
+      struct VALUE* rhs = stmt->types.assignment->rhs;
+
+      count++;
+      if (rhs->value_type == VALUE_EXPR)
+        count += count_expr(rhs->types.expr);
+      else
+        count += 1 + count_element(rhs->types.function_call->parameter);
+
+      stmt = stmt->types.assignment->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_FUNCTION_CALL) {
+      count += count_element(stmt->types.function_call->parameter);
+
+      stmt = stmt->types.function_call->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+      count += count_expr(stmt->types.while_loop->condition);
+      count += count_stmts(stmt->types.while_loop->loop_body, stmt);
+
+      stmt = stmt->types.while_loop->next_stmt;
+    }
+    else {
+      stmt = stmt->types.pass->next_stmt;
+    }
+  }
+
+  return count;
+}
+
+//
+// print_count
+//
+// Prints the JSON value of a count, null if it isn't known.
+//
+static void print_count(const char* name, long count, const char* separator)
+{
+  if (count < 0)
+    printf("\"%s\": null%s", name, separator);
+  else
+    printf("\"%s\": %ld%s", name, count, separator);
+}
+
+
+//
+// Public functions:
+//
+
+//
+// stats_init
+//
+// Returns new, empty statistics.
+//
+struct STATS* stats_init(void)
+{
+  struct STATS* stats = (struct STATS*)malloc(sizeof(struct STATS));
+
+  stats->num_phases = 0;
+
+  stats->tokens = -1;
+  stats->nodes = -1;
+  stats->statements = -1;
+  stats->cells = -1;
+
+  return stats;
+}
+
+
+//
+// stats_begin
+//
+// Notes where the phase starts.
+//
+void stats_begin(struct STATS* stats, const char* name)
+{
+  if (stats == NULL)
+    return;
+
+  if (stats->num_phases == STATS_MAX_PHASES) {
+    printf("**INTERNAL ERROR: too many phases (stats_begin)\n");
+    exit(-1);
+  }
+
+  stats->phases[stats->num_phases].name = name;
+
+  reset_peak_rss();
+
+  stats->start_allocs = __atomic_load_n(&num_allocs, __ATOMIC_RELAXED);
+  stats->start_bytes = __atomic_load_n(&num_bytes, __ATOMIC_RELAXED);
+  stats->start_frees = __atomic_load_n(&num_frees, __ATOMIC_RELAXED);
+  stats->start_cpu = cpu_seconds();
+  stats->start_wall = wall_seconds();
+}
+
+
+//
+// stats_end
+//
+// Records the phase, from where it started to now.
+//
+void stats_end(struct STATS* stats)
+{
+  if (stats == NULL)
+    return;
+
+  double wall = wall_seconds();
+  double cpu = cpu_seconds();
+
+  struct STATS_PHASE* phase = &stats->phases[stats->num_phases];
+
+  phase->wall = wall - stats->start_wall;
+  phase->cpu = cpu - stats->start_cpu;
+  phase->allocs = __atomic_load_n(&num_allocs, __ATOMIC_RELAXED) - stats->start_allocs;
+  phase->bytes = __atomic_load_n(&num_bytes, __ATOMIC_RELAXED) - stats->start_bytes;
+  phase->frees = __atomic_load_n(&num_frees, __ATOMIC_RELAXED) - stats->start_frees;
+  phase->peak_rss = peak_rss();
+
+  stats->num_phases++;
+}
+
+
+//
+// stats_count_nodes
+//
+// Counts the nodes of the program graph.
+//
+long stats_count_nodes(struct STMT* program)
+{
+  return count_stmts(program, NULL);
+}
+
+
+//
+// stats_print
+//
+// Prints the statistics, as a table or as JSON.
+//
+void stats_print(struct STATS* stats, bool json)
+{
+  if (json) {
+    printf("{\"phases\": [");
+
+    for (int i = 0; i < stats->num_phases; i++) {
+      struct STATS_PHASE* phase = &stats->phases[i];
+
+      printf("%s{\"name\": \"%s\", \"wall_ms\": %.3f, \"cpu_ms\": %.3f, \"allocs\": %ld, \"bytes\": %ld, \"frees\": %ld, \"peak_rss_kb\": %ld}",
+        (i > 0) ? ", " : "", phase->name, phase->wall * 1e3, phase->cpu * 1e3,
+        phase->allocs, phase->bytes, phase->frees, phase->peak_rss);
+    }
+
+    printf("], ");
+    print_count("tokens", stats->tokens, ", ");
+    print_count("graph_nodes", stats->nodes, ", ");
+    print_count("statements", stats->statements, ", ");
+    print_count("ram_cells", stats->cells, "}\n");
+    return;
+  }
+
+  printf("**STATS**\n");
+  printf("%-10s %10s %10s %10s %12s %10s %12s\n", "phase", "wall ms", "cpu ms", "allocs", "bytes", "frees", "peak RSS KB");
+
+  for (int i = 0; i < stats->num_phases; i++) {
+    struct STATS_PHASE* phase = &stats->phases[i];
+
+    printf("%-10s %10.3f %10.3f %10ld %12ld %10ld %12ld\n", phase->name,
+      phase->wall * 1e3, phase->cpu * 1e3, phase->allocs, phase->bytes, phase->frees, phase->peak_rss);
+  }
+
+  const char* names[] = { "Tokens", "Graph nodes", "Statements executed", "RAM cells" };
+  long counts[] = { stats->tokens, stats->nodes, stats->statements, stats->cells };
+
+  for (int i = 0; i < 4; i++) {
+    if (counts[i] < 0)
+      printf("%s: n/a\n", names[i]);
+    else
+      printf("%s: %ld\n", names[i], counts[i]);
+  }
+
+  printf("**END STATS**\n");
+}
+
+
+//
+// stats_destroy
+//
+// Frees the statistics.
+//
+void stats_destroy(struct STATS* stats)
+{
+  free(stats);
+}
@@ -0,0 +1,124 @@
+/*stats.h*/
+
+//
+// Run statistics for nuPython (see --stats in main.c). A run is
+// split into phases -- parse, build, ..., execute, destroy -- and
+// for each phase the wall time, the CPU time, the number of calls
+// to malloc (calloc, realloc, aligned_alloc) and free along with
+// the bytes asked for, and the peak RSS are recorded. A few counts
+// about the program are recorded for the run as a whole.
+//
+// Allocations are counted by wrapping the allocator at link time:
+// link with
+//
+//   -Wl,--wrap=malloc -Wl,--wrap=calloc -Wl,--wrap=realloc
+//   -Wl,--wrap=aligned_alloc -Wl,--wrap=free
+//
+// (see the makefile), which routes the calls made by the program's
+// own code, and the object files linked with it, through this
+// module. Allocations made inside the C library (e.g. by fopen)
+// are not counted.
+//
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+
+#include "programgraph.h"
+
+
+#define STATS_MAX_PHASES  16
+
+struct STATS_PHASE
+{
+  const char* name;
+  double wall;        // seconds
+  double cpu;         // seconds, user + system
+  long   allocs;      // # of malloc, calloc, realloc, aligned_alloc
+  long   bytes;       // bytes those asked for
+  long   frees;       // # of free (of non-NULL pointers)
+  long   peak_rss;    // KB, the most resident during the phase
+};
+
+struct STATS
+{
+  struct STATS_PHASE phases[STATS_MAX_PHASES];
+  int num_phases;
+
+  //
+  // counts for the run, -1 if not known:
+  //
+  long tokens;        // scanned
+  long nodes;         // in the program graph, as built
+  long statements;    // executed (a loop's condition, each time)
+  long cells;         // in RAM at the end
+
+  //
+  // where the phase in progress started:
+  //
+  double start_wall;
+  double start_cpu;
+  long   start_allocs;
+  long   start_bytes;
+  long   start_frees;
+};
+
+
+//
+// Public functions:
+//
+
+//
+// stats_init
+//
+// Returns new, empty statistics.
+//
+struct STATS* stats_init(void);
+
+//
+// stats_begin
+//
+// Starts a phase with the given name (a string that outlives the
+// statistics), which lasts until stats_end. Phases don't nest.
+// With NULL statistics (not measuring), does nothing.
+//
+void stats_begin(struct STATS* stats, const char* name);
+
+//
+// stats_end
+//
+// Ends the phase in progress, and records it. With NULL
+// statistics, does nothing.
+//
+void stats_end(struct STATS* stats);
+
+//
+// stats_count_nodes
+//
+// Returns the number of nodes in the given program graph: its
+// statements, their type-specific structs, and the values,
+// expressions, function calls and elements below them.
+//
+long stats_count_nodes(struct STMT* program);
+
+//
+// stats_print
+//
+// Prints the statistics, as a table between **STATS** and
+// **END STATS**, or as a single line of JSON:
+//
+//   {"phases": [{"name": "parse", "wall_ms": ..., "cpu_ms": ...,
+//     "allocs": ..., "bytes": ..., "frees": ..., "peak_rss_kb": ...},
+//     ...], "tokens": ..., "graph_nodes": ..., "statements": ...,
+//     "ram_cells": ...}
+//
+// with null for a count that isn't known.
+//
+void stats_print(struct STATS* stats, bool json);
+
+//
+// stats_destroy
+//
+// Frees the statistics.
+//
+void stats_destroy(struct STATS* stats);
@@ -0,0 +1,209 @@
+/*str.c*/
+
+//
+// Strings of nuPython values, see str.h.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>   // offsetof
+#include <string.h>
+
+#include "str.h"
+
+
+#define STR_MIN_GROWTH  16  // chars, the least a buffer grows by
+
+
+//
+// Private functions:
+//
+
+//
+// header
+//
+// Returns the STR whose chars s points to.
+//
+static inline struct STR* header(const char* s)
+{
+  return (struct STR*)(s - offsetof(struct STR, chars));
+}
+
+//
+// allocate
+//
+// Returns a new STR, with one reference, with room for the given
+// number of chars; the chars are not set.
+//
+static struct STR* allocate(long capacity)
+{
+  struct STR* str = (struct STR*)malloc(sizeof(struct STR) + (capacity + 1) * sizeof(char));
+
+  if (str == NULL) {
+    printf("**INTERNAL ERROR: out of memory (str allocate)\n");
+    exit(-1);
+  }
+
+  str->refs = 1;
+  str->length = 0;
+  str->capacity = capacity;
+
+  return str;
+}
+
+
+//
+// Public functions:
+//
+
+//
+// str_new
+//
+// Returns a new STR holding the first length chars of s.
+//
+char* str_new(const char* s, long length)
+{
+  struct STR* str = allocate(length);
+
+  memcpy(str->chars, s, length);
+  str->chars[length] = '\0';
+  str->length = length;
+
+  return str->chars;
+}
+
+
+//
+// str_dup
+//
+// Returns a new STR holding a copy of s.
+//
+char* str_dup(const char* s)
+{
+  return str_new(s, strlen(s));
+}
+
+
+//
+// str_concat
+//
+// Returns a new STR holding lhs followed by rhs.
+//
+char* str_concat(const char* lhs, const char* rhs)
+{
+  long len1 = strlen(lhs);
+  long len2 = strlen(rhs);
+  struct STR* str = allocate(len1 + len2);
+
+  memcpy(str->chars, lhs, len1);
+  memcpy(str->chars + len1, rhs, len2 + 1);
+  str->length = len1 + len2;
+
+  return str->chars;
+}
+
+
+//
+// str_append
+//
+// Appends more to s, in place if s isn't shared; the buffer at
+// least doubles when it grows, so appends take amortized O(1) time
+// per char.
+//
+char* str_append(char* s, const char* more)
+{
+  struct STR* str = header(s);
+  long added = strlen(more);
+  long length = str->length + added;
+
+  if (str->refs > 1) {
+    //
+    // shared: copy, leaving room to grow, and let go of s:
+    //
+    long capacity = 2 * length;
+    struct STR* copy = allocate((capacity < STR_MIN_GROWTH) ? STR_MIN_GROWTH : capacity);
+
+    memcpy(copy->chars, str->chars, str->length);
+    memcpy(copy->chars + str->length, more, added + 1);
+    copy->length = length;
+
+    str->refs--;  // not the last reference, others hold it
+    return copy->chars;
+  }
+
+  if (length > str->capacity) {
+    long capacity = 2 * str->capacity;
+
+    if (capacity < length)
+      capacity = length;
+    if (capacity < str->capacity + STR_MIN_GROWTH)
+      capacity = str->capacity + STR_MIN_GROWTH;
+
+    //
+    // more may point into the buffer, which realloc may move:
+    //
+    long offset = -1;
+
+    if (more >= str->chars && more <= str->chars + str->length)
+      offset = more - str->chars;
+
+    str = (struct STR*)realloc(str, sizeof(struct STR) + (capacity + 1) * sizeof(char));
+
+    if (str == NULL) {
+      printf("**INTERNAL ERROR: out of memory (str_append)\n");
+      exit(-1);
+    }
+
+    str->capacity = capacity;
+
+    if (offset >= 0)
+      more = str->chars + offset;
+  }
+
+  //
+  // the chars added never overlap the chars they come from, which
+  // are at most the old length long:
+  //
+  memcpy(str->chars + str->length, more, added);
+  str->chars[length] = '\0';
+  str->length = length;
+
+  return str->chars;
+}
+
+
+//
+// str_share
+//
+// Adds a reference to s.
+//
+char* str_share(char* s)
+{
+  header(s)->refs++;
+  return s;
+}
+
+
+//
+// str_release
+//
+// Gives up a reference to s, freeing it with the last one.
+//
+void str_release(char* s)
+{
+  struct STR* str = header(s);
+
+  if (--str->refs == 0)
+    free(str);
+}
+
+
+//
+// str_length
+//
+// Returns the length of s.
+//
+long str_length(const char* s)
+{
+  return header(s)->length;
+}
@@ -0,0 +1,91 @@
+/*str.h*/
+
+//
+// Strings of nuPython values. A string stored in memory (see ram.h)
+// or owned by a temporary value (see values.h) is a STR: a buffer
+// that knows its length and capacity and how many references it
+// has. A STR is passed around as a pointer to its chars, so it reads
+// as an ordinary C string everywhere; only the code that creates,
+// shares, grows or frees strings has to know about the header.
+//
+// Assigning one string variable to another shares the STR rather
+// than copying it. Appending to a STR with a single reference, as in
+// s = s + t, happens in place, and the buffer grows by doubling, so
+// building a string piece by piece takes time proportional to its
+// final length rather than to the square of it. A STR that is shared
+// is copied before it's appended to, so sharing is never visible.
+//
+
+#pragma once
+
+
+struct STR
+{
+  int  refs;      // memory cells and temporaries holding it
+  long length;    // chars, not counting the '\0'
+  long capacity;  // chars that fit, not counting the '\0'
+  char chars[];   // '\0' terminated
+};
+
+
+//
+// Public functions:
+//
+
+//
+// str_new
+//
+// Returns a new STR, with one reference, holding the first length
+// chars of s.
+//
+char* str_new(const char* s, long length);
+
+//
+// str_dup
+//
+// Returns a new STR, with one reference, holding a copy of the
+// given C string.
+//
+char* str_dup(const char* s);
+
+//
+// str_concat
+//
+// Returns a new STR, with one reference, holding lhs followed by
+// rhs (C strings, STRs or not).
+//
+char* str_concat(const char* lhs, const char* rhs);
+
+//
+// str_append
+//
+// Appends the C string more to the STR s, giving up the caller's
+// reference to s, and returns the STR now holding the result, with
+// that reference. If s has no other reference, the chars are added
+// in place (growing the buffer if needed, which may move it);
+// otherwise s is left alone and a new STR is returned. more may be
+// (part of) s itself.
+//
+char* str_append(char* s, const char* more);
+
+//
+// str_share
+//
+// Adds a reference to the STR s, and returns s.
+//
+char* str_share(char* s);
+
+//
+// str_release
+//
+// Gives up a reference to the STR s, freeing it when it was the
+// last one.
+//
+void str_release(char* s);
+
+//
+// str_length
+//
+// Returns the length of the STR s, without counting.
+//
+long str_length(const char* s);
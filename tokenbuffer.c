@@ -0,0 +1,403 @@
+/*tokenbuffer.c*/
+
+//
+// Token Buffer for nuPython, see tokenbuffer.h.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "token.h"
+#include "tokenqueue.h"
+#include "mapscanner.h"
+#include "tokenring.h"
+#include "tokenbuffer.h"
+
+
+//
+// Private functions:
+//
+
+//
+// scanned_all
+//
+// Returns true if the buffer has the last token, EOS.
+//
+static bool scanned_all(struct TokenBuffer* tokens)
+{
+  return tokens->num_tokens > 0 && tokens->tokens[tokens->num_tokens - 1].id == nuPy_EOS;
+}
+
+//
+// token_at
+//
+// Returns the index of the token i positions after the cursor,
+// never past the last token. A pipelined buffer pops tokens from
+// the ring until it has that one (or EOS), unless the scan has
+// been finished.
+//
+static int token_at(struct TokenBuffer* tokens, int i)
+{
+  if (tokens->ring != NULL && tokens->ring->running) {
+    while (tokens->cursor + i >= tokens->num_tokens && !scanned_all(tokens))
+      tokenbuffer_append_view(tokens, tokenring_pop(tokens->ring));
+  }
+
+  assert(tokens->num_tokens > 0);
+
+  int index = tokens->cursor + i;
+
+  if (index >= tokens->num_tokens)
+    index = tokens->num_tokens - 1;
+
+  return index;
+}
+
+//
+// create_buffer
+//
+// Returns a new, empty token buffer with an arena of the given
+// size (0 => no arena).
+//
+static struct TokenBuffer* create_buffer(int text_capacity)
+{
+  struct TokenBuffer* tokens = (struct TokenBuffer*)malloc(sizeof(struct TokenBuffer));
+
+  tokens->capacity = 256;
+  tokens->num_tokens = 0;
+  tokens->tokens = (struct Token*)malloc(tokens->capacity * sizeof(struct Token));
+  tokens->offsets = (int*)malloc(tokens->capacity * sizeof(int));
+  tokens->lengths = (int*)malloc(tokens->capacity * sizeof(int));
+
+  tokens->text_capacity = text_capacity;
+  tokens->text_len = 0;
+  tokens->text = (text_capacity > 0) ? (char*)malloc(text_capacity * sizeof(char)) : NULL;
+
+  tokens->source = NULL;
+  tokens->ring = NULL;
+
+  tokens->value_capacity = 0;
+  tokens->value = NULL;
+
+  tokens->cursor = 0;
+
+  return tokens;
+}
+
+//
+// grow_tokens
+//
+// Makes room for one more token, doubling the arrays when full. A
+// pipelined buffer never looks behind the cursor, so it drops the
+// tokens before the cursor instead.
+//
+static void grow_tokens(struct TokenBuffer* tokens)
+{
+  if (tokens->num_tokens < tokens->capacity)
+    return;
+
+  if (tokens->ring != NULL && tokens->cursor > 0) {
+    int keep = tokens->num_tokens - tokens->cursor;
+
+    memmove(tokens->tokens, tokens->tokens + tokens->cursor, keep * sizeof(struct Token));
+    memmove(tokens->offsets, tokens->offsets + tokens->cursor, keep * sizeof(int));
+    memmove(tokens->lengths, tokens->lengths + tokens->cursor, keep * sizeof(int));
+
+    tokens->num_tokens = keep;
+    tokens->cursor = 0;
+    return;
+  }
+
+  tokens->capacity *= 2;
+  tokens->tokens = (struct Token*)realloc(tokens->tokens, tokens->capacity * sizeof(struct Token));
+  tokens->offsets = (int*)realloc(tokens->offsets, tokens->capacity * sizeof(int));
+  tokens->lengths = (int*)realloc(tokens->lengths, tokens->capacity * sizeof(int));
+}
+
+//
+// token_value
+//
+// Returns the value of the i-th token as a string. Values in a
+// mapped source are not '\0'-terminated, so they are copied to
+// tokens->value first. (The source text is not cached, since a
+// source read from a stream may move as it grows.)
+//
+static char* token_value(struct TokenBuffer* tokens, int i)
+{
+  if (tokens->source == NULL)
+    return tokens->text + tokens->offsets[i];
+
+  if (tokens->tokens[i].id == nuPy_EOLN)
+    return "EOLN";
+  if (tokens->tokens[i].id == nuPy_EOS)
+    return "$";
+
+  int length = tokens->lengths[i];
+
+  if (length + 1 > tokens->value_capacity) {
+    tokens->value_capacity = (length + 1) * 2;
+    tokens->value = (char*)realloc(tokens->value, tokens->value_capacity * sizeof(char));
+  }
+
+  memcpy(tokens->value, tokens->source->text + tokens->offsets[i], length);
+  tokens->value[length] = '\0';
+
+  return tokens->value;
+}
+
+//
+// token_located
+//
+// Returns the i-th token with its line and column, computing them
+// if it is a token of a mapped source.
+//
+static struct Token token_located(struct TokenBuffer* tokens, int i)
+{
+  struct Token token = tokens->tokens[i];
+
+  if (tokens->source != NULL) {
+    //
+    // a string literal starts at the quote, before its value:
+    //
+    int start = tokens->offsets[i] - (token.id == nuPy_STR_LITERAL ? 1 : 0);
+
+    mapscanner_position(tokens->source, start, &token.line, &token.col);
+  }
+
+  return token;
+}
+
+
+//
+// Public functions:
+//
+
+//
+// tokenbuffer_create
+//
+// Returns a new, empty token buffer.
+//
+struct TokenBuffer* tokenbuffer_create(void)
+{
+  return create_buffer(4096);
+}
+
+
+//
+// tokenbuffer_create_mapped
+//
+// Returns a new, empty token buffer for tokens of the given
+// memory-mapped source.
+//
+struct TokenBuffer* tokenbuffer_create_mapped(struct MappedSource* source)
+{
+  struct TokenBuffer* tokens = create_buffer(0);
+
+  tokens->source = source;
+
+  return tokens;
+}
+
+
+//
+// tokenbuffer_create_pipelined
+//
+// Returns a new token buffer that pops the tokens of a mapped
+// source from the given ring as the parser needs them.
+//
+struct TokenBuffer* tokenbuffer_create_pipelined(struct TokenRing* ring)
+{
+  struct TokenBuffer* tokens = create_buffer(0);
+
+  tokens->source = ring->source;
+  tokens->ring = ring;
+
+  return tokens;
+}
+
+
+//
+// tokenbuffer_destroy
+//
+// Frees the memory associated with the token buffer.
+//
+void tokenbuffer_destroy(struct TokenBuffer* tokens)
+{
+  free(tokens->tokens);
+  free(tokens->offsets);
+  free(tokens->lengths);
+  if (tokens->source == NULL)
+    free(tokens->text);
+  free(tokens->value);
+  free(tokens);
+}
+
+
+//
+// tokenbuffer_append
+//
+// Adds the given token, and a copy of its value, to the end of
+// the buffer. Both the token arrays and the arena double when full.
+//
+void tokenbuffer_append(struct TokenBuffer* tokens, struct Token token, char* value)
+{
+  assert(tokens->source == NULL);
+
+  grow_tokens(tokens);
+
+  int len = (int)strlen(value) + 1;  // including '\0'
+
+  while (tokens->text_len + len > tokens->text_capacity) {
+    tokens->text_capacity *= 2;
+    tokens->text = (char*)realloc(tokens->text, tokens->text_capacity * sizeof(char));
+  }
+
+  memcpy(tokens->text + tokens->text_len, value, len);
+
+  tokens->tokens[tokens->num_tokens] = token;
+  tokens->offsets[tokens->num_tokens] = tokens->text_len;
+  tokens->lengths[tokens->num_tokens] = len - 1;
+  tokens->num_tokens++;
+  tokens->text_len += len;
+}
+
+
+//
+// tokenbuffer_append_view
+//
+// Adds the given token of the mapped source to the end of the
+// buffer; its line and column are left 0 until needed.
+//
+void tokenbuffer_append_view(struct TokenBuffer* tokens, struct TokenView view)
+{
+  assert(tokens->source != NULL);
+
+  grow_tokens(tokens);
+
+  struct Token token;
+  token.id = view.id;
+  token.line = 0;
+  token.col = 0;
+
+  tokens->tokens[tokens->num_tokens] = token;
+  tokens->offsets[tokens->num_tokens] = view.offset;
+  tokens->lengths[tokens->num_tokens] = view.length;
+  tokens->num_tokens++;
+}
+
+
+//
+// tokenbuffer_peekToken
+//
+// Returns the token at the cursor.
+//
+struct Token tokenbuffer_peekToken(struct TokenBuffer* tokens)
+{
+  return tokens->tokens[token_at(tokens, 0)];
+}
+
+
+//
+// tokenbuffer_peekValue
+//
+// Returns the value of the token at the cursor.
+//
+char* tokenbuffer_peekValue(struct TokenBuffer* tokens)
+{
+  return token_value(tokens, token_at(tokens, 0));
+}
+
+
+//
+// tokenbuffer_peek2Token
+//
+// Returns the token after the one at the cursor.
+//
+struct Token tokenbuffer_peek2Token(struct TokenBuffer* tokens)
+{
+  return tokens->tokens[token_at(tokens, 1)];
+}
+
+
+//
+// tokenbuffer_locate
+//
+// Returns the token at the cursor, with its line and column.
+//
+struct Token tokenbuffer_locate(struct TokenBuffer* tokens)
+{
+  int index = token_at(tokens, 0);
+
+  //
+  // a located token is for an error message, which must come after
+  // the scanner's warnings; and then the source's line count is
+  // no longer the scanner thread's:
+  //
+  tokenbuffer_finish_scan(tokens);
+
+  return token_located(tokens, index);
+}
+
+
+//
+// tokenbuffer_line
+//
+// Returns the line of the token at the cursor.
+//
+int tokenbuffer_line(struct TokenBuffer* tokens)
+{
+  assert(tokens->ring == NULL);
+
+  return token_located(tokens, token_at(tokens, 0)).line;
+}
+
+
+//
+// tokenbuffer_finish_scan
+//
+// Waits for the scanner of a pipelined buffer to finish the input.
+//
+void tokenbuffer_finish_scan(struct TokenBuffer* tokens)
+{
+  if (tokens->ring != NULL)
+    tokenring_stop(tokens->ring);
+}
+
+
+//
+// tokenbuffer_advance
+//
+// Moves the cursor to the next token.
+//
+void tokenbuffer_advance(struct TokenBuffer* tokens)
+{
+  //
+  // a pipelined buffer may not have popped the next token yet:
+  //
+  if (tokens->cursor < tokens->num_tokens - 1 || (tokens->ring != NULL && !scanned_all(tokens)))
+    tokens->cursor++;
+}
+
+
+//
+// tokenbuffer_to_queue
+//
+// Returns the tokens as a new Token Queue. The tokens are located
+// in order, so each line is only counted once. The scanner of a
+// pipelined buffer has built the queue already.
+//
+struct TokenQueue* tokenbuffer_to_queue(struct TokenBuffer* tokens)
+{
+  if (tokens->ring != NULL)
+    return tokenring_take_queue(tokens->ring);  // built by the scanner
+
+  struct TokenQueue* queue = tokenqueue_create();
+
+  for (int i = 0; i < tokens->num_tokens; i++) {
+    tokenqueue_enqueue(queue, token_located(tokens, i), token_value(tokens, i));
+  }
+
+  return queue;
+}
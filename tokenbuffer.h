@@ -0,0 +1,163 @@
+/*tokenbuffer.h*/
+
+//
+// Token Buffer for nuPython. Holds the whole token stream in one
+// growable array, with the text of every token in a single shared
+// string arena, instead of a malloc'd node and string per token.
+// The parser reads it through a cursor, so reading the tokens
+// doesn't consume them.
+//
+// A buffer created over a memory-mapped source (see mapscanner.h)
+// has no arena: the token values are views into the source text,
+// and line and column numbers are only computed when asked for.
+// A pipelined buffer (see tokenring.h) pops the tokens from the
+// scanner thread as the parser needs them, and only keeps the ones
+// from the cursor on.
+//
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+
+#include "token.h"
+#include "tokenqueue.h"
+#include "mapscanner.h"
+#include "tokenring.h"
+
+
+struct TokenBuffer
+{
+  struct Token* tokens;
+  int*  offsets;       // offsets[i] => value of tokens[i] in text
+  int*  lengths;       // ... and its length
+  int   num_tokens;
+  int   capacity;
+
+  char* text;          // the arena, '\0'-terminated values (unused for a source)
+  int   text_len;
+  int   text_capacity;
+
+  struct MappedSource* source;  // non-NULL => values are in source->text
+  struct TokenRing* ring;       // non-NULL => tokens are popped from here
+
+  char* value;         // '\0'-terminated copy of a value in the source
+  int   value_capacity;
+
+  int   cursor;        // index of the next token to read
+};
+
+
+//
+// Public functions:
+//
+
+//
+// tokenbuffer_create
+//
+// Returns a new, empty token buffer.
+//
+struct TokenBuffer* tokenbuffer_create(void);
+
+//
+// tokenbuffer_create_mapped
+//
+// Returns a new, empty token buffer for tokens of the given
+// memory-mapped source, see tokenbuffer_append_view. The source
+// must stay open while the buffer is in use.
+//
+struct TokenBuffer* tokenbuffer_create_mapped(struct MappedSource* source);
+
+//
+// tokenbuffer_create_pipelined
+//
+// Returns a new token buffer for tokens popped from the given ring
+// as they are needed. Once the cursor has moved past a token, it is
+// dropped. The ring must outlive the buffer.
+//
+struct TokenBuffer* tokenbuffer_create_pipelined(struct TokenRing* ring);
+
+//
+// tokenbuffer_destroy
+//
+// Frees the memory associated with the token buffer.
+//
+void tokenbuffer_destroy(struct TokenBuffer* tokens);
+
+//
+// tokenbuffer_append
+//
+// Adds the given token, and a copy of its value, to the end of
+// the buffer.
+//
+void tokenbuffer_append(struct TokenBuffer* tokens, struct Token token, char* value);
+
+//
+// tokenbuffer_append_view
+//
+// Adds the given token of the mapped source to the end of the
+// buffer. Nothing is copied.
+//
+void tokenbuffer_append_view(struct TokenBuffer* tokens, struct TokenView view);
+
+//
+// tokenbuffer_peekToken, tokenbuffer_peekValue
+//
+// Returns the token at the cursor, or its value. The value stays
+// valid until the next call to tokenbuffer_peekValue. Once the
+// cursor has reached the last token (EOS), it stays there.
+//
+// The line and column of a token of a mapped source are 0, see
+// tokenbuffer_locate.
+//
+struct Token tokenbuffer_peekToken(struct TokenBuffer* tokens);
+char* tokenbuffer_peekValue(struct TokenBuffer* tokens);
+
+//
+// tokenbuffer_peek2Token
+//
+// Returns the token after the one at the cursor.
+//
+struct Token tokenbuffer_peek2Token(struct TokenBuffer* tokens);
+
+//
+// tokenbuffer_locate
+//
+// Returns the token at the cursor, with its line and column.
+//
+struct Token tokenbuffer_locate(struct TokenBuffer* tokens);
+
+//
+// tokenbuffer_line
+//
+// Returns the line number of the token at the cursor. Unlike
+// tokenbuffer_locate, this is not only for error messages, but
+// it is not for a pipelined buffer (its lines are counted by the
+// scanner thread).
+//
+int tokenbuffer_line(struct TokenBuffer* tokens);
+
+//
+// tokenbuffer_finish_scan
+//
+// Waits until the scanner of a pipelined buffer has scanned all of
+// the input, so that what it prints (warnings) comes before what the
+// parser prints. Tokens can't be read afterwards, except the one at
+// the cursor. Does nothing for other buffers.
+//
+void tokenbuffer_finish_scan(struct TokenBuffer* tokens);
+
+//
+// tokenbuffer_advance
+//
+// Moves the cursor to the next token.
+//
+void tokenbuffer_advance(struct TokenBuffer* tokens);
+
+//
+// tokenbuffer_to_queue
+//
+// Returns the tokens as a new Token Queue, for the modules that
+// take one (the program graph). The caller frees the queue. For
+// a pipelined buffer, all the tokens must have been read.
+//
+struct TokenQueue* tokenbuffer_to_queue(struct TokenBuffer* tokens);
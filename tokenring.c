@@ -0,0 +1,362 @@
+/*tokenring.c*/
+
+//
+// Token Ring for nuPython, see tokenring.h.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "token.h"
+#include "tokenqueue.h"
+#include "mapscanner.h"
+#include "tokenring.h"
+
+
+//
+// how many times a waiting thread looks at the other thread's count
+// before going to sleep, and how many tokens a thread pushes (pops)
+// before publishing its count:
+//
+#define SPINS  100
+#define BATCH  64
+
+
+//
+// Private functions:
+//
+
+//
+// finished
+//
+// Returns true once the scanner has published EOS, or the parser
+// has stopped.
+//
+static bool finished(struct TokenRing* ring)
+{
+  return __atomic_load_n(&ring->scanned, __ATOMIC_SEQ_CST) || __atomic_load_n(&ring->stopped, __ATOMIC_SEQ_CST);
+}
+
+//
+// publish
+//
+// Publishes one of the counts, and wakes the other thread if it's
+// sleeping until the count gets this far (or until the end).
+//
+static void publish(struct TokenRing* ring, unsigned int* count, unsigned int value)
+{
+  __atomic_store_n(count, value, __ATOMIC_RELEASE);
+
+  //
+  // the count must be stored before sleepers is loaded, see wait_for:
+  //
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+  if (__atomic_load_n(&ring->sleepers, __ATOMIC_ACQUIRE) > 0 &&
+      ((int)(value - __atomic_load_n(&ring->wake_at, __ATOMIC_RELAXED)) >= 0 || finished(ring)))
+  {
+    pthread_mutex_lock(&ring->lock);
+    pthread_cond_broadcast(&ring->wake);
+    pthread_mutex_unlock(&ring->lock);
+  }
+}
+
+//
+// wait_for
+//
+// Waits until the other thread's count is at least needed past the
+// one last seen, or either thread is finished, and returns the count.
+// Spins for a while first, then sleeps. A sleeper counts itself
+// before looking at the count one last time, and a publisher stores
+// the count before looking for sleepers, so one of them always sees
+// the other.
+//
+static unsigned int wait_for(struct TokenRing* ring, unsigned int* count, unsigned int seen, unsigned int needed)
+{
+  unsigned int now;
+
+  for (int spins = 0; spins < SPINS; spins++) {
+    now = __atomic_load_n(count, __ATOMIC_ACQUIRE);
+
+    if (now - seen >= needed || finished(ring))
+      return now;
+
+#if defined(__GNUC__) && defined(__x86_64__)
+    __builtin_ia32_pause();
+#endif
+  }
+
+  pthread_mutex_lock(&ring->lock);
+  __atomic_store_n(&ring->wake_at, seen + needed, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&ring->sleepers, 1, __ATOMIC_SEQ_CST);
+
+  while ((now = __atomic_load_n(count, __ATOMIC_SEQ_CST)) - seen < needed && !finished(ring))
+  {
+    pthread_cond_wait(&ring->wake, &ring->lock);
+  }
+
+  __atomic_sub_fetch(&ring->sleepers, 1, __ATOMIC_SEQ_CST);
+  pthread_mutex_unlock(&ring->lock);
+
+  return now;
+}
+
+//
+// push
+//
+// Pushes the view into the ring, waiting while the ring is full.
+// Returns false, without pushing, once the parser has stopped.
+//
+static bool push(struct TokenRing* ring, struct TokenView view)
+{
+  if (__atomic_load_n(&ring->stopped, __ATOMIC_RELAXED))
+    return false;
+
+  while (ring->next_tail - ring->head_seen == ring->capacity) {
+    //
+    // full; the parser may be waiting for what we haven't
+    // published yet:
+    //
+    publish(ring, &ring->tail, ring->next_tail);
+
+    //
+    // ... then wait for room for many tokens, not just one, so a
+    // single CPU isn't switched back and forth for every few:
+    //
+    ring->head_seen = wait_for(ring, &ring->head, ring->head_seen, ring->capacity / 2);
+
+    if (__atomic_load_n(&ring->stopped, __ATOMIC_RELAXED))
+      return false;
+  }
+
+  ring->views[ring->next_tail & (ring->capacity - 1)] = view;
+  ring->next_tail++;
+
+  if (view.id == nuPy_EOS) {
+    //
+    // the last count first, so the parser has it once it sees that
+    // the scan is finished:
+    //
+    __atomic_store_n(&ring->tail, ring->next_tail, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->scanned, 1, __ATOMIC_SEQ_CST);
+  }
+
+  if (ring->next_tail - ring->tail == BATCH || view.id == nuPy_EOS)
+    publish(ring, &ring->tail, ring->next_tail);
+
+  return true;
+}
+
+//
+// enqueue
+//
+// Adds the token of the given view to the queue, with its line and
+// column and a '\0'-terminated copy of its value (in *value, which
+// grows as needed).
+//
+static void enqueue(struct TokenRing* ring, struct TokenView view, char** value, int* value_capacity)
+{
+  struct Token token;
+  token.id = view.id;
+
+  //
+  // a string literal starts at the quote, before its value:
+  //
+  int start = view.offset - (view.id == nuPy_STR_LITERAL ? 1 : 0);
+
+  mapscanner_position(ring->source, start, &token.line, &token.col);
+
+  if (view.id == nuPy_EOLN) {
+    tokenqueue_enqueue(ring->queue, token, "EOLN");
+    return;
+  }
+  if (view.id == nuPy_EOS) {
+    tokenqueue_enqueue(ring->queue, token, "$");
+    return;
+  }
+
+  if (view.length + 1 > *value_capacity) {
+    *value_capacity = (view.length + 1) * 2;
+    *value = (char*)realloc(*value, *value_capacity * sizeof(char));
+  }
+
+  memcpy(*value, ring->source->text + view.offset, view.length);
+  (*value)[view.length] = '\0';
+
+  tokenqueue_enqueue(ring->queue, token, *value);
+}
+
+//
+// scan
+//
+// The scanner thread: scans the whole input, adding every token to
+// the queue and pushing it into the ring. Once the parser stops
+// early (a syntax error), the queue is of no use, so the rest of
+// the input is only scanned, for the scanner's warnings.
+//
+static void* scan(void* arg)
+{
+  struct TokenRing* ring = (struct TokenRing*)arg;
+  struct TokenView view;
+  bool pushing = true;
+
+  char* value = NULL;
+  int value_capacity = 0;
+
+  do
+  {
+    view = mapscanner_nextToken(ring->source);
+
+    if (pushing) {
+      enqueue(ring, view, &value, &value_capacity);
+
+      pushing = push(ring, view);
+    }
+  } while (view.id != nuPy_EOS);
+
+  free(value);
+
+  return NULL;
+}
+
+
+//
+// Public functions:
+//
+
+//
+// tokenring_start
+//
+// Creates the ring and starts the scanner thread.
+//
+struct TokenRing* tokenring_start(struct MappedSource* source, int capacity)
+{
+  struct TokenRing* ring = (struct TokenRing*)aligned_alloc(64, sizeof(struct TokenRing));
+
+  ring->capacity = 1;
+  while (ring->capacity < (unsigned int)capacity)
+    ring->capacity *= 2;
+
+  ring->views = (struct TokenView*)malloc(ring->capacity * sizeof(struct TokenView));
+
+  ring->source = source;
+  ring->queue = tokenqueue_create();
+
+  pthread_mutex_init(&ring->lock, NULL);
+  pthread_cond_init(&ring->wake, NULL);
+  ring->sleepers = 0;
+  ring->wake_at = 0;
+
+  ring->tail = 0;
+  ring->next_tail = 0;
+  ring->head_seen = 0;
+  ring->head = 0;
+  ring->next_head = 0;
+  ring->tail_seen = 0;
+  ring->stopped = 0;
+  ring->scanned = 0;
+
+  ring->running = (pthread_create(&ring->thread, NULL, scan, ring) == 0);
+
+  if (!ring->running) {
+    //
+    // no thread, scan the whole input now; the ring must hold
+    // all of it (there's at most one token per character, +EOS):
+    //
+    free(ring->views);
+    ring->capacity = 1;
+    while (ring->capacity < (unsigned int)source->size + 1)
+      ring->capacity *= 2;
+    ring->views = (struct TokenView*)malloc(ring->capacity * sizeof(struct TokenView));
+
+    scan(ring);
+  }
+
+  return ring;
+}
+
+
+//
+// tokenring_pop
+//
+// Pops the next view, waiting while the ring is empty.
+//
+struct TokenView tokenring_pop(struct TokenRing* ring)
+{
+  while (ring->next_head == ring->tail_seen) {
+    //
+    // empty; the scanner may be waiting for room we haven't
+    // published yet. Then wait for many tokens, or the last:
+    //
+    publish(ring, &ring->head, ring->next_head);
+
+    ring->tail_seen = wait_for(ring, &ring->tail, ring->tail_seen, ring->capacity / 2);
+  }
+
+  struct TokenView view = ring->views[ring->next_head & (ring->capacity - 1)];
+  ring->next_head++;
+
+  if (ring->next_head - ring->head == BATCH)
+    publish(ring, &ring->head, ring->next_head);
+
+  return view;
+}
+
+
+//
+// tokenring_stop
+//
+// Stops the pushes, wakes the scanner if it's waiting for room, and
+// joins the scanner thread.
+//
+void tokenring_stop(struct TokenRing* ring)
+{
+  if (!ring->running)
+    return;
+
+  __atomic_store_n(&ring->stopped, 1, __ATOMIC_SEQ_CST);
+
+  pthread_mutex_lock(&ring->lock);
+  pthread_cond_broadcast(&ring->wake);
+  pthread_mutex_unlock(&ring->lock);
+
+  pthread_join(ring->thread, NULL);
+  ring->running = false;
+}
+
+
+//
+// tokenring_take_queue
+//
+// Returns the queue, once the whole input has been scanned.
+//
+struct TokenQueue* tokenring_take_queue(struct TokenRing* ring)
+{
+  tokenring_stop(ring);
+
+  struct TokenQueue* queue = ring->queue;
+  ring->queue = NULL;
+
+  return queue;
+}
+
+
+//
+// tokenring_destroy
+//
+// Frees the ring, and the queue if it's still here.
+//
+void tokenring_destroy(struct TokenRing* ring)
+{
+  tokenring_stop(ring);
+
+  if (ring->queue != NULL)
+    tokenqueue_destroy(ring->queue);
+
+  pthread_mutex_destroy(&ring->lock);
+  pthread_cond_destroy(&ring->wake);
+
+  free(ring->views);
+  free(ring);
+}
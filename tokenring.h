@@ -0,0 +1,106 @@
+/*tokenring.h*/
+
+//
+// Token Ring for nuPython. Runs the memory-mapped scanner on its
+// own thread, so that scanning overlaps parsing: the scanner thread
+// pushes each token into a bounded single-producer/single-consumer
+// ring, which the parser pops from (see tokenbuffer_create_pipelined).
+// The scanner thread also builds the Token Queue as it goes, so the
+// whole token stream is only ever held once, in the queue.
+//
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+#include <pthread.h>
+
+#include "tokenqueue.h"
+#include "mapscanner.h"
+
+
+struct TokenRing
+{
+  struct TokenView* views;     // capacity slots
+  unsigned int capacity;       // a power of 2
+
+  struct MappedSource* source;
+  struct TokenQueue* queue;    // built by the scanner thread
+  pthread_t thread;
+  bool running;                // the thread hasn't been joined yet
+
+  //
+  // a thread that finds the ring full (empty) spins for a while,
+  // then sleeps until the other thread publishes a count of at
+  // least wake_at:
+  //
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  int sleepers;
+  unsigned int wake_at;
+
+  //
+  // tail and head count the pushes and pops, so tail - head views
+  // are in the ring. Each thread publishes its count every few
+  // tokens (and before it waits), and keeps the other's count as
+  // last seen, so the threads rarely touch each other's cache line:
+  //
+  __attribute__((aligned(64)))
+  unsigned int tail;           // scanner: pushes published
+  unsigned int next_tail;      //   pushes done
+  unsigned int head_seen;
+  int scanned;                 //   EOS was pushed
+
+  __attribute__((aligned(64)))
+  unsigned int head;           // parser: pops published
+  unsigned int next_head;      //   pops done
+  unsigned int tail_seen;
+  int stopped;                 //   no more pops, stop pushing
+};
+
+
+//
+// Public functions:
+//
+
+//
+// tokenring_start
+//
+// Starts scanning the given source on a new thread, into a ring of
+// the given capacity (rounded up to a power of 2). The source must
+// stay open until the ring is destroyed.
+//
+struct TokenRing* tokenring_start(struct MappedSource* source, int capacity);
+
+//
+// tokenring_pop
+//
+// Returns the next token, waiting for the scanner if need be. The
+// last token is nuPy_EOS; don't pop past it.
+//
+struct TokenView tokenring_pop(struct TokenRing* ring);
+
+//
+// tokenring_stop
+//
+// Tells the scanner that no more tokens will be popped, and waits
+// until it has scanned the rest of the input (so anything it prints,
+// such as warnings, has been printed).
+//
+void tokenring_stop(struct TokenRing* ring);
+
+//
+// tokenring_take_queue
+//
+// Stops the ring, and returns the Token Queue of the whole input;
+// the queue is only complete if every token, up to nuPy_EOS, was
+// popped. The caller frees the queue.
+//
+struct TokenQueue* tokenring_take_queue(struct TokenRing* ring);
+
+//
+// tokenring_destroy
+//
+// Stops the ring and frees it, along with the queue unless it was
+// taken.
+//
+void tokenring_destroy(struct TokenRing* ring);
@@ -0,0 +1,714 @@
+/*values.c*/
+
+//
+// Operations on nuPython values, shared by the tree-walking
+// executor (execute.c) and the bytecode VM (vm.c) so that both
+// compute exactly the same results and report the same errors.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <limits.h>   // INT_MAX, INT_MIN
+#include <errno.h>
+
+#include "programgraph.h"  // enum OPERATORS
+#include "ram.h"
+#include "str.h"
+#include "output.h"
+#include "values.h"
+
+
+//
+// release_value
+//
+// Gives up the string owned by the given temporary, if any.
+//
+void release_value(struct TEMP_VALUE* temp)
+{
+  if (temp->owns_str) {
+    str_release(temp->value.types.s);
+    temp->owns_str = false;
+  }
+}
+
+
+//
+// int_power
+//
+// Computes base ** exponent exactly, by squaring. Returns false if
+// the result doesn't fit in an int (0 ** a negative number, which is
+// infinite, included).
+//
+bool int_power(int base, int exponent, int* result)
+{
+  //
+  // the cheap cases first: ** 0, 1 and 2, and 2 **
+  //
+  if (exponent == 0) {
+    *result = 1;
+    return true;
+  }
+  if (exponent == 1) {
+    *result = base;
+    return true;
+  }
+  if (exponent == 2) {
+    long long square = (long long)base * base;
+
+    *result = (int)square;
+    return square <= INT_MAX;
+  }
+  if (base == 2 && exponent > 0) {
+    *result = (exponent < 31) ? (1 << exponent) : 0;
+    return exponent < 31;
+  }
+
+  //
+  // a base of 0, 1 or -1 stays small whatever the exponent:
+  //
+  if (base == 0) {
+    *result = 0;
+    return exponent > 0;
+  }
+  if (base == 1 || base == -1) {
+    *result = (base == -1 && (exponent & 1) != 0) ? -1 : 1;
+    return true;
+  }
+
+  //
+  // otherwise, a negative exponent gives a fraction, truncated to 0
+  // (as (int)pow did):
+  //
+  if (exponent < 0) {
+    *result = 0;
+    return true;
+  }
+
+  //
+  // square and multiply, in 64 bits so an int can't overflow: while
+  // the square is needed it's at most 2^31, else the result can't
+  // fit anyway:
+  //
+  long long power = 1;
+  long long square = base;
+
+  for (;;) {
+    if ((exponent & 1) != 0) {
+      power *= square;
+
+      if (power > INT_MAX || power < INT_MIN)
+        return false;
+    }
+
+    exponent >>= 1;
+    if (exponent == 0)
+      break;
+
+    square *= square;
+
+    if (square > (long long)INT_MAX + 1)
+      return false;
+  }
+
+  *result = (int)power;
+  return true;
+}
+
+
+//
+// real_power
+//
+// Computes base ** exponent, giving exactly what pow gives, without
+// calling pow when the exponent is 0 or 1. Other integer powers are
+// left to pow: glibc's is as fast as squaring, and x*x and 1/x are
+// rounded differently than pow, now and then.
+//
+double real_power(double base, double exponent)
+{
+  if (exponent == 0.0)
+    return 1.0;
+  if (exponent == 1.0)
+    return base;
+
+  return pow(base, exponent);
+}
+
+
+// execute_int_int_binary
+// takes in two ints and an operator, stores the RAM_VALUE in the caller's result
+// will store as RAM_TYPE_BOOLEAN for relational operators and RAM_TYPE_INT for other operators
+// returns error for unrecognizable operators
+
+static void execute_int_int_binary(int lhs, int operator, int rhs, struct RAM_VALUE* result) {
+    switch (operator)
+  {
+  case OPERATOR_PLUS:
+    result->value_type = RAM_TYPE_INT;
+    result->types.i = lhs + rhs;
+    break;
+
+  case OPERATOR_MINUS:
+    result->value_type = RAM_TYPE_INT;
+    result->types.i = lhs - rhs;
+    break;
+
+  case OPERATOR_ASTERISK:
+    result->value_type = RAM_TYPE_INT;
+    result->types.i = lhs * rhs;
+    break;
+
+  case OPERATOR_POWER:
+    result->value_type = RAM_TYPE_INT;
+    int_power(lhs, rhs, &result->types.i);  // checked by the caller
+    break;
+
+  case OPERATOR_MOD:
+    result->value_type = RAM_TYPE_INT;
+    result->types.i = lhs % rhs;
+    break;
+
+  case OPERATOR_DIV:
+    result->value_type = RAM_TYPE_INT;
+    result->types.i = lhs / rhs;
+    break;
+  case OPERATOR_EQUAL:
+    result->value_type = RAM_TYPE_BOOLEAN;
+    if (lhs == rhs) {
+      result->types.i = 1;
+    } else {
+      result->types.i = 0;
+    }
+    break;
+  case OPERATOR_NOT_EQUAL:
+    result->value_type = RAM_TYPE_BOOLEAN;
+    if (lhs != rhs) {
+      result->types.i = 1;
+    } else {
+      result->types.i = 0;
+    }
+    break;
+  case OPERATOR_LT:
+    result->value_type = RAM_TYPE_BOOLEAN;
+    if (lhs < rhs) {
+      result->types.i = 1;
+    } else {
+      result->types.i = 0;
+    }
+    break;
+  case OPERATOR_LTE:
+    result->value_type = RAM_TYPE_BOOLEAN;
+    if (lhs <= rhs) {
+      result->types.i = 1;
+    } else {
+      result->types.i = 0;
+    }
+    break;
+  case OPERATOR_GT:
+    result->value_type = RAM_TYPE_BOOLEAN;
+    if (lhs > rhs) {
+      result->types.i = 1;
+    } else {
+      result->types.i = 0;
+    }
+    break;
+  case OPERATOR_GTE:
+    result->value_type = RAM_TYPE_BOOLEAN;
+    if (lhs >= rhs) {
+      result->types.i = 1;
+    } else {
+      result->types.i = 0;
+    }
+    break;
+  default:
+    //
+    // did we miss something?
+    //
+    printf("**INTERNAL ERROR: unexpected operator (%d) in execute_binary_expr\n", operator);
+    assert(false);
+  }
+}
+
+// execute_real_real_binary
+// takes in two doubles and an operator, stores the RAM_VALUE in the caller's result
+// will store as RAM_TYPE_BOOLEAN for relational operators and RAM_TYPE_REAL for other operators
+// returns error for unrecognizable operators
+
+static void execute_real_real_binary(double lhs, int operator, double rhs, struct RAM_VALUE* result) {
+    //printf("executing real real: %lf, %lf\n", lhs, rhs); DELETE LATER
+    switch (operator)
+  {
+  case OPERATOR_PLUS:
+    result->value_type = RAM_TYPE_REAL;
+    result->types.d = lhs + rhs;
+    //printf("computed result: %lf\n", result);  DELETE LATER
+    break;
+
+  case OPERATOR_MINUS:
+    result->value_type = RAM_TYPE_REAL;
+    result->types.d = lhs - rhs;
+    break;
+
+  case OPERATOR_ASTERISK:
+    result->value_type = RAM_TYPE_REAL;
+    result->types.d = lhs * rhs;
+    break;
+
+  case OPERATOR_POWER:
+    result->value_type = RAM_TYPE_REAL;
+    result->types.d = real_power(lhs, rhs);
+    break;
+
+  case OPERATOR_MOD:
+    result->value_type = RAM_TYPE_REAL;
+    result->types.d = fmod(lhs, rhs);
+    break;
+
+  case OPERATOR_DIV:
+    result->value_type = RAM_TYPE_REAL;
+    result->types.d = lhs / rhs;
+    break;
+
+  case OPERATOR_EQUAL:
+    result->value_type = RAM_TYPE_BOOLEAN;
+    if (lhs == rhs) {
+      result->types.i = 1;
+    } else {
+      result->types.i = 0;
+    }
+    break;
+
+  case OPERATOR_NOT_EQUAL:
+    result->value_type = RAM_TYPE_BOOLEAN;
+    if (lhs != rhs) {
+      result->types.i = 1;
+    } else {
+      result->types.i = 0;
+    }
+    break;
+  case OPERATOR_LT:
+    result->value_type = RAM_TYPE_BOOLEAN;
+    if (lhs < rhs) {
+      result->types.i = 1;
+    } else {
+      result->types.i = 0;
+    }
+    break;
+  case OPERATOR_LTE:
+    result->value_type = RAM_TYPE_BOOLEAN;
+    if (lhs <= rhs) {
+      result->types.i = 1;
+    } else {
+      result->types.i = 0;
+    }
+    break;
+  case OPERATOR_GT:
+    result->value_type = RAM_TYPE_BOOLEAN;
+    if (lhs > rhs) {
+      result->types.i = 1;
+    } else {
+      result->types.i = 0;
+    }
+    break;
+  case OPERATOR_GTE:
+    result->value_type = RAM_TYPE_BOOLEAN;
+    if (lhs >= rhs) {
+      result->types.i = 1;
+    } else {
+      result->types.i = 0;
+    }
+    break;
+
+  default:
+    //
+    // did we miss something?
+    //
+    printf("**INTERNAL ERROR: unexpected operator (%d) in execute_binary_expr\n", operator);
+    assert(false);
+  }
+}
+
+
+// execute_str_str_binary
+// takes in two strings and an operator, stores a RAM_VALUE of type RAM_TYPE_BOOLEAN in the caller's result
+// value will be true if the binary expression using a relational operator and 2 strings is true, false if not
+// returns error for unrecognizable operators
+
+static void execute_str_str_binary (char* s1, int operator, char* s2, struct RAM_VALUE* result){
+  result->value_type = RAM_TYPE_BOOLEAN;
+
+  switch(operator) {
+    case OPERATOR_EQUAL:
+      if (strcmp(s1,s2) == 0) {
+        result->types.i = 1;
+      } else {
+        result->types.i = 0;
+      }
+      break;
+    case OPERATOR_NOT_EQUAL:
+      if (strcmp(s1,s2) != 0) {
+        result->types.i = 1;
+      } else {
+        result->types.i = 0;
+      }
+      break;
+    case OPERATOR_LT:
+      if (strcmp(s1,s2) < 0) {
+        result->types.i = 1;
+      } else {
+        result->types.i = 0;
+      }
+      break;
+    case OPERATOR_LTE:
+      if (strcmp(s1,s2) <= 0) {
+        result->types.i = 1;
+      } else {
+        result->types.i = 0;
+      }
+      break;
+    case OPERATOR_GT:
+      if (strcmp(s1,s2) > 0) {
+        result->types.i = 1;
+      } else {
+        result->types.i = 0;
+      }
+      break;
+    case OPERATOR_GTE:
+      if (strcmp(s1,s2) >= 0) {
+        result->types.i = 1;
+      } else {
+        result->types.i = 0;
+      }
+      break;
+
+    default:
+      printf("**INTERNAL ERROR: unexpected operator (%d) in execute_binary_expr with 2 strings\n", operator);
+      assert(false);
+  }
+}
+
+//is rel_op
+// is rel_op takes operator and returns boolean: true if it is a relational operator, false otherwise
+bool is_rel_op (int operator) {
+  switch (operator) {
+    case OPERATOR_EQUAL:
+      return true;
+      break;
+    case OPERATOR_NOT_EQUAL:
+      return true;
+      break;
+    case OPERATOR_LT:
+      return true;
+      break;
+    case OPERATOR_LTE:
+      return true;
+      break;
+    case OPERATOR_GT:
+      return true;
+      break;
+    case OPERATOR_GTE:
+      return true;
+      break;
+    default:
+      return false; 
+  }
+}
+
+
+
+//
+// execute_binary_expression
+//
+// Given two values (both RAM_VALUE) and an operator (int value), performs the operation
+// if working with one real and one int, convert the int to real so both are real
+// run helper functions str_str, int_int_ and real_real for the different scenarios
+// stores the result in the caller's temp and returns true if successful, false if not.
+// the result only owns a string for str + str, which builds a new string
+//
+
+bool execute_binary_expression(struct RAM_VALUE* lhs, int operator, struct RAM_VALUE* rhs, struct TEMP_VALUE* result, int line)
+{
+  assert(operator != OPERATOR_NO_OP);
+  result->owns_str = false;
+  
+  if (lhs->value_type == RAM_TYPE_INT && rhs->value_type == RAM_TYPE_INT) {
+    if (rhs->types.i == 0 && operator == OPERATOR_DIV) {
+      printf("ZeroDivisionError: division by zero\n");
+      return false;
+    }
+    if (operator == OPERATOR_POWER) {
+      int power;
+
+      if (lhs->types.i == 0 && rhs->types.i < 0) {
+        printf("ZeroDivisionError: 0 cannot be raised to a negative power\n");
+        return false;
+      }
+      if (!int_power(lhs->types.i, rhs->types.i, &power)) {
+        printf("**SEMANTIC ERROR: int result of ** is out of range (line %d)\n", line);
+        return false;
+      }
+    }
+    execute_int_int_binary(lhs->types.i, operator, rhs->types.i, &result->value);
+    return true;
+  }
+
+  else if ((lhs->value_type == RAM_TYPE_REAL && rhs->value_type == RAM_TYPE_REAL) || (lhs->value_type == RAM_TYPE_REAL && rhs->value_type == RAM_TYPE_INT) || (lhs->value_type == RAM_TYPE_INT && rhs->value_type == RAM_TYPE_REAL)) {
+    double new_left;
+    double new_right;
+    if (lhs->value_type == RAM_TYPE_INT) {
+      new_left = (double)lhs->types.i;
+    } else {
+      new_left = lhs->types.d;
+    }
+    if (rhs->value_type == RAM_TYPE_INT) {
+      new_right = (double)rhs->types.i;
+    } else {
+      new_right = rhs->types.d;
+    }
+    if (new_right == 0.0 && operator == OPERATOR_DIV) {
+      printf("ZeroDivisionError: division by zero\n");
+      return false;
+    }
+    execute_real_real_binary(new_left, operator, new_right, &result->value);
+    return true;
+  }
+
+  else if (lhs->value_type == RAM_TYPE_STR && rhs->value_type == RAM_TYPE_STR && operator == OPERATOR_PLUS) {
+    result->value.value_type = RAM_TYPE_STR;
+    result->value.types.s = str_concat(lhs->types.s, rhs->types.s);
+    result->owns_str = true;
+    return true;
+  }
+
+  else if (lhs->value_type == RAM_TYPE_STR && rhs->value_type == RAM_TYPE_STR && is_rel_op(operator)) {
+    execute_str_str_binary(lhs->types.s, operator, rhs->types.s, &result->value);
+    return true;
+  }
+
+  else {
+    printf("**SEMANTIC ERROR: invalid operand types (line %d)\n", line);
+    return false;
+  }
+}
+
+
+//
+// parse_literal
+//
+// Parses the literal held by the given element into *value. Returns
+// false if an int or real literal is out of range. Overflow of a real
+// is an error, underflow just rounds to 0.0.
+//
+bool parse_literal(struct ELEMENT* element, struct RAM_VALUE* value)
+{
+  char* literal = element->element_value;
+
+  switch (element->element_type) {
+    case ELEMENT_INT_LITERAL: {
+      errno = 0;
+      long i = strtol(literal, NULL, 10);
+      if (errno == ERANGE || i > INT_MAX || i < INT_MIN)
+        return false;
+      value->value_type = RAM_TYPE_INT;
+      value->types.i = (int)i;
+      return true;
+    }
+    case ELEMENT_REAL_LITERAL: {
+      errno = 0;
+      double d = strtod(literal, NULL);
+      if (errno == ERANGE && (d == HUGE_VAL || d == -HUGE_VAL))
+        return false;
+      value->value_type = RAM_TYPE_REAL;
+      value->types.d = d;
+      return true;
+    }
+    case ELEMENT_STR_LITERAL:
+      value->value_type = RAM_TYPE_STR;
+      value->types.s = literal;
+      return true;
+    case ELEMENT_TRUE:
+      value->value_type = RAM_TYPE_BOOLEAN;
+      value->types.i = 1;
+      return true;
+    case ELEMENT_FALSE:
+      value->value_type = RAM_TYPE_BOOLEAN;
+      value->types.i = 0;
+      return true;
+    default:
+      value->value_type = RAM_TYPE_NONE;
+      return true;
+  }
+}
+
+
+//is_zero
+//takes in a string and returns true if the value is equal to 0 (comprised completely of 0s and up to one decimal point)
+//returns false if not
+
+bool is_zero(char* input_num) {
+  int num_dec = 0;
+  for (int i = 0; i<strlen(input_num); i++) {
+    if (input_num[i] != '0' && input_num[i] != '.'){
+      return false;
+    }
+    if (input_num[i] == '.') {
+      num_dec++;
+    }
+    if (num_dec > 1) {
+      printf("More than one decimal point");
+      return false;
+    }
+  }
+  return true;
+}
+
+
+//
+// execute_int_conversion
+//
+// int(s): converts the given string to an int, stored in the caller's
+// result. Returns false if the string is not a valid int.
+//
+bool execute_int_conversion(char* s, struct RAM_VALUE* result)
+{
+  result->value_type = RAM_TYPE_INT;
+  result->types.i = atoi(s); //didn't check if this works
+  //if result->types.i == 0, check if the string is equal to 0, if not, return false
+  return !(result->types.i == 0 && !(is_zero(s)));
+}
+
+
+//
+// execute_real_conversion
+//
+// float(s): converts the given string to a real, stored in the caller's
+// result. Returns false if the string is not a valid real.
+//
+bool execute_real_conversion(char* s, struct RAM_VALUE* result)
+{
+  result->value_type = RAM_TYPE_REAL;
+  result->types.d = atof(s); //didn't check if this works
+  return !(result->types.d == 0.0 && !(is_zero(s)));
+}
+
+
+//
+// print_value
+//
+// Prints the given value followed by a newline, as print(value)
+// does. Returns true if successful, false if the value can't be
+// printed (an error message was output).
+//
+bool print_value(const struct RAM_VALUE* to_print)
+{
+  bool success = true;
+
+  switch (to_print->value_type) {
+    case RAM_TYPE_INT:
+      output_int(to_print->types.i);
+      output_newline();
+      break;
+    case RAM_TYPE_REAL:
+      output_real(to_print->types.d);
+      output_newline();
+      break;
+    case RAM_TYPE_STR:
+      output_str(to_print->types.s);
+      output_newline();
+      break;
+    case RAM_TYPE_BOOLEAN: 
+      if (to_print->types.i == 0) {
+        output_str("False\n");
+      } else if (to_print->types.i == 1){
+        output_str("True\n");
+      } else {
+        printf("Neither false nor true?\n");
+        success = false;
+      }
+      break;
+    default:
+      printf("Not int, real, string, or boolean\n");
+      success = false;
+  }
+
+  return success;
+}
+
+
+//
+// input_line_init
+//
+// Initializes an input line buffer, with no spill buffer yet.
+//
+void input_line_init(struct INPUT_LINE* line)
+{
+  line->small[0] = '\0';
+  line->spill = NULL;
+  line->spill_capacity = 0;
+}
+
+
+//
+// input_line_destroy
+//
+// Frees the spill buffer, if any.
+//
+void input_line_destroy(struct INPUT_LINE* line)
+{
+  free(line->spill);
+  line->spill = NULL;
+  line->spill_capacity = 0;
+}
+
+
+//
+// read_input_line
+//
+// Reads a line into the small buffer; if it doesn't fit, copies
+// what was read to the spill buffer and reads the rest of the line
+// there, doubling the spill buffer as needed.
+//
+char* read_input_line(struct INPUT_LINE* line, FILE* input)
+{
+  if (fgets(line->small, INPUT_LINE_SMALL, input) == NULL) {
+    line->small[0] = '\0';  // end of the stream
+    return line->small;
+  }
+
+  int len = (int)strlen(line->small);
+
+  if (len < INPUT_LINE_SMALL - 1 || line->small[len - 1] == '\n') {
+    //
+    // the whole line fit, delete EOL chars:
+    //
+    line->small[strcspn(line->small, "\r\n")] = '\0';
+    return line->small;
+  }
+
+  //
+  // spill:
+  //
+  if (line->spill_capacity < 2 * INPUT_LINE_SMALL) {
+    line->spill_capacity = 2 * INPUT_LINE_SMALL;
+    line->spill = (char*)realloc(line->spill, line->spill_capacity * sizeof(char));
+  }
+  memcpy(line->spill, line->small, len + 1);
+
+  while (line->spill[len - 1] != '\n') {
+    if (line->spill_capacity - len < INPUT_LINE_SMALL) {
+      line->spill_capacity *= 2;
+      line->spill = (char*)realloc(line->spill, line->spill_capacity * sizeof(char));
+    }
+
+    if (fgets(line->spill + len, line->spill_capacity - len, input) == NULL)
+      break;  // last line, no EOL
+
+    len += (int)strlen(line->spill + len);
+  }
+
+  line->spill[strcspn(line->spill, "\r\n")] = '\0';
+  return line->spill;
+}
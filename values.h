@@ -0,0 +1,157 @@
+/*values.h*/
+
+//
+// Operations on nuPython values, shared by the tree-walking
+// executor and the bytecode VM.
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stdbool.h>  // true, false
+
+#include "programgraph.h"
+#include "ram.h"
+
+
+//
+// Intermediate values:
+//
+// Values computed while evaluating an expression live on the
+// stack of the caller, never on the heap. The only part of a
+// value that can own heap memory is a string, so ownership is
+// made explicit: if owns_str is true, value.types.s is a STR (see
+// str.h) that this temporary holds a reference to, which must be
+// given up with release_value() or handed to memory with
+// ram_move_cell_by_addr/_by_name; otherwise the string is
+// borrowed (from the program graph, from RAM, see
+// ram_peek_cell_by_addr, or from an input line) and must not be
+// freed. Borrowed values must be used before the next write to
+// memory.
+//
+struct TEMP_VALUE
+{
+  struct RAM_VALUE value;
+  bool owns_str;
+};
+
+//
+// Input lines:
+//
+// input() reads a whole line, however long. A line that fits in
+// the small buffer needs no allocation; a longer one spills into
+// a heap buffer that grows as needed, and is kept for later lines.
+//
+#define INPUT_LINE_SMALL  256
+
+struct INPUT_LINE
+{
+  char  small[INPUT_LINE_SMALL];
+  char* spill;          // NULL until a line doesn't fit in small
+  int   spill_capacity;
+};
+
+
+//
+// Public functions:
+//
+
+//
+// release_value
+//
+// Gives up the string owned by the given temporary, if any.
+//
+void release_value(struct TEMP_VALUE* temp);
+
+//
+// is_rel_op
+//
+// Returns true if the operator (enum OPERATORS) is a relational
+// operator such as == or <, false otherwise.
+//
+bool is_rel_op(int operator);
+
+//
+// int_power
+//
+// Computes base ** exponent exactly, storing it in *result; a
+// negative exponent gives the fraction truncated toward 0. Returns
+// false if the result doesn't fit in an int, or is infinite
+// (0 ** a negative exponent).
+//
+bool int_power(int base, int exponent, int* result);
+
+//
+// real_power
+//
+// Computes base ** exponent, giving exactly what pow(base,
+// exponent) gives, but without calling pow for exponents 0 and 1.
+//
+double real_power(double base, double exponent);
+
+//
+// execute_binary_expression
+//
+// Given two values and an operator (enum OPERATORS), performs the
+// operation and stores the result in the caller's temp. An int and
+// a real are computed as two reals. Returns true if successful; if
+// not, an error message that mentions the given line number is
+// output and false is returned. The result only owns a string for
+// str + str, which builds a new string.
+//
+bool execute_binary_expression(struct RAM_VALUE* lhs, int operator, struct RAM_VALUE* rhs, struct TEMP_VALUE* result, int line);
+
+//
+// parse_literal
+//
+// Parses the literal held by the given element into *value; a
+// string is borrowed from the element. An element that holds no
+// literal (an identifier, None) gives RAM_TYPE_NONE. Returns false
+// if an int literal doesn't fit in an int or a real literal
+// overflows a double; no error message is output.
+//
+bool parse_literal(struct ELEMENT* element, struct RAM_VALUE* value);
+
+//
+// is_zero
+//
+// Returns true if the given string is a zero (only 0s and at most
+// one decimal point), false if not.
+//
+bool is_zero(char* input_num);
+
+//
+// execute_int_conversion, execute_real_conversion
+//
+// int(s) and float(s): convert the given string, storing the int or
+// real in the caller's result. Return false if the string is not a
+// valid number; no error message is output.
+//
+bool execute_int_conversion(char* s, struct RAM_VALUE* result);
+bool execute_real_conversion(char* s, struct RAM_VALUE* result);
+
+//
+// print_value
+//
+// Prints the given value followed by a newline, as print(value)
+// does. Returns true if successful, false if the value can't be
+// printed (an error message was output).
+//
+bool print_value(const struct RAM_VALUE* to_print);
+
+//
+// input_line_init, input_line_destroy
+//
+// Initializes an input line buffer / frees its spill buffer.
+//
+void input_line_init(struct INPUT_LINE* line);
+void input_line_destroy(struct INPUT_LINE* line);
+
+//
+// read_input_line
+//
+// Reads the next line of the given stream into the buffer and
+// returns it, without the end-of-line characters ("" at the end
+// of the stream). The line stays valid until the next read.
+//
+char* read_input_line(struct INPUT_LINE* line, FILE* input);
@@ -0,0 +1,383 @@
+/*vm.c*/
+
+//
+// Virtual machine that executes nuPython bytecode: a loop over a
+// dense instruction array with a single accumulator, instead of a
+// walk over the pointer-linked program graph.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+#include <assert.h>
+
+#include "programgraph.h"  // enum OPERATORS
+#include "bytecode.h"
+#include "ram.h"
+#include "str.h"
+#include "values.h"
+#include "output.h"
+#include "infer.h"
+#include "vm.h"
+
+
+//
+// Dispatch. With GCC or Clang the VM uses threaded dispatch: every
+// handler ends with a jump straight to the handler of the next
+// instruction, through a table of label addresses (computed goto),
+// instead of going back to the top of a switch. The generic BINARY
+// is then dispatched once more, on the operator and the pair of
+// operand types, so common cases such as int + int, real < real and
+// str == str each get a handler with no checks left to do. Where
+// type inference proved the operand types, the compiler emits the
+// specialized opcode (e.g. OP_INT_ADD) that goes to that handler
+// directly.
+//
+// Other compilers get the same handlers as cases of a switch;
+// compile with -DVM_SWITCH_DISPATCH to get that version with GCC
+// too (see bench.c).
+//
+#if defined(__GNUC__) && !defined(VM_SWITCH_DISPATCH)
+#define VM_THREADED_DISPATCH
+#endif
+
+#define NUM_OPERATORS  (OPERATOR_NO_OP + 1)
+#define NUM_RAM_TYPES  (RAM_TYPE_NONE + 1)
+
+#define BINARY_KEY(operator, lhs_type, rhs_type) \
+  (((operator) * NUM_RAM_TYPES + (lhs_type)) * NUM_RAM_TYPES + (rhs_type))
+
+#define NUM_BINARY_KEYS  (NUM_OPERATORS * NUM_RAM_TYPES * NUM_RAM_TYPES)
+
+#ifdef VM_THREADED_DISPATCH
+#define TARGET(opcode)  TARGET_##opcode:
+#define DISPATCH()      do { instr = &code[pc]; goto *opcode_targets[instr->opcode]; } while (0)
+#define BINARY_TARGET(type, name, operator)  BINARY_##type##_##name:
+#else
+#define TARGET(opcode)  case opcode:
+#define DISPATCH()      continue
+#define BINARY_TARGET(type, name, operator) \
+  case BINARY_KEY(operator, type##_OPERAND_TYPE, type##_OPERAND_TYPE): BINARY_##type##_##name:
+#endif
+
+//
+// The handlers for the specialized binary operations, see
+// SPECIALIZED_BINARIES in infer.h. Anything else (mixed int/real,
+// /, %, **, str + str, errors) goes to execute_binary_expression.
+//
+#define INT_APPLY(op)   (lhs.types.i op rhs.types.i)
+#define REAL_APPLY(op)  (lhs.types.d op rhs.types.d)
+#define STR_APPLY(op)   (strcmp(lhs.types.s, rhs.types.s) op 0)
+
+#define BINARY_HANDLER(type, name, operator, op, result_type) \
+  BINARY_TARGET(type, name, operator) \
+    acc.value.value_type = result_type; \
+    if (result_type == RAM_TYPE_REAL) \
+      acc.value.types.d = type##_APPLY(op); \
+    else \
+      acc.value.types.i = type##_APPLY(op); \
+    acc.owns_str = false; \
+    pc++; \
+    DISPATCH();
+
+//
+// The specialized opcodes: type inference has proven the operand
+// types, and that variables are defined, so the operands are just
+// loaded and the handler above is run directly.
+//
+#define PROVEN_OPERAND(operand) \
+  (OPERAND_IS_CONST(operand) ? bytecode->constants[OPERAND_CONST_INDEX(operand)] : memory->cells[addrs[operand]].value)
+
+#define SPECIALIZED_HANDLER(type, name, operator, op, result_type) \
+    TARGET(OP_##type##_##name) \
+      lhs = PROVEN_OPERAND(instr->lhs); \
+      rhs = PROVEN_OPERAND(instr->rhs); \
+      goto BINARY_##type##_##name;
+
+
+//
+// Private functions:
+//
+
+//
+// fetch_operand
+//
+// Stores the value of the given operand (a variable slot or a
+// constant) in *value. Values are borrowed, strings are never
+// copied. Returns false if the operand is a variable that has
+// not been written yet (an error message is output).
+//
+static inline bool fetch_operand(struct BYTECODE* bytecode, struct RAM* memory, int* addrs, int operand, int line, struct RAM_VALUE* value)
+{
+  if (OPERAND_IS_CONST(operand)) {
+    *value = bytecode->constants[OPERAND_CONST_INDEX(operand)];
+    return true;
+  }
+
+  //
+  // same as ram_peek_cell_by_addr, inlined since this is the most
+  // frequent thing the VM does:
+  //
+  int addr = addrs[operand];
+  if (addr == -1) {
+    printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", bytecode->names[operand], line);
+    return false;
+  }
+
+  *value = memory->cells[addr].value;
+  return true;
+}
+
+
+//
+// Public functions:
+//
+
+//
+// vm_execute
+//
+// Given nuPython bytecode and a memory, executes the bytecode.
+// If a semantic error occurs (e.g. type error), an error message
+// is output, execution stops, and the function returns. Returns
+// the number of statements executed: each statement's code ends
+// with a STORE, PRINT, PRINT_NEWLINE or (a loop's condition)
+// JUMP_IF_TRUE, and those are counted.
+//
+long vm_execute(struct BYTECODE* bytecode, struct RAM* memory)
+{
+  struct INSTR* code = bytecode->code;
+  int* lines = bytecode->lines;
+
+  struct INSTR* instr;     // the instruction being executed
+  struct TEMP_VALUE acc;   // the accumulator
+  struct RAM_VALUE lhs, rhs;
+  int pc = 0;              // index of the instruction to execute
+  long executed = 0;       // statements
+  struct INPUT_LINE line;  // input() buffer, the accumulator may borrow it
+
+  acc.owns_str = false;
+  input_line_init(&line);
+
+  //
+  // RAM address of each slot, -1 until the variable is first
+  // written; from then on the address never changes:
+  //
+  int* addrs = (int*)malloc((bytecode->num_names + 1) * sizeof(int));
+  for (int i = 0; i < bytecode->num_names; i++) {
+    addrs[i] = -1;
+  }
+
+#ifdef VM_THREADED_DISPATCH
+  static void* opcode_targets[NUM_OPCODES] = {
+    [OP_LOAD]          = &&TARGET_OP_LOAD,
+    [OP_BINARY]        = &&TARGET_OP_BINARY,
+    [OP_STORE]         = &&TARGET_OP_STORE,
+    [OP_PRINT]         = &&TARGET_OP_PRINT,
+    [OP_PRINT_NEWLINE] = &&TARGET_OP_PRINT_NEWLINE,
+    [OP_INPUT]         = &&TARGET_OP_INPUT,
+    [OP_INT]           = &&TARGET_OP_INT,
+    [OP_FLOAT]         = &&TARGET_OP_FLOAT,
+    [OP_JUMP]          = &&TARGET_OP_JUMP,
+    [OP_JUMP_IF_TRUE]  = &&TARGET_OP_JUMP_IF_TRUE,
+    [OP_BAD_CALL]      = &&TARGET_OP_BAD_CALL,
+    [OP_STOP]          = &&TARGET_OP_STOP,
+    [OP_HALT]          = &&TARGET_OP_HALT,
+#define SPECIALIZED_TARGET(type, name, operator, op, result_type) [OP_##type##_##name] = &&TARGET_OP_##type##_##name,
+    SPECIALIZED_BINARIES(SPECIALIZED_TARGET)
+#undef SPECIALIZED_TARGET
+  };
+
+  //
+  // (operator, lhs type, rhs type) => handler, built on first use:
+  //
+  static void* binary_targets[NUM_BINARY_KEYS];
+  static bool binary_targets_built = false;
+
+  if (!binary_targets_built) {
+    for (int k = 0; k < NUM_BINARY_KEYS; k++) {
+      binary_targets[k] = &&binary_generic;
+    }
+
+#define REGISTER_BINARY(type, name, operator, op, result_type) \
+    binary_targets[BINARY_KEY(operator, type##_OPERAND_TYPE, type##_OPERAND_TYPE)] = &&BINARY_##type##_##name;
+
+    SPECIALIZED_BINARIES(REGISTER_BINARY)
+
+#undef REGISTER_BINARY
+
+    binary_targets_built = true;
+  }
+
+  DISPATCH();
+#else
+  for (;;) {
+    instr = &code[pc];
+
+    switch (instr->opcode) {
+#endif
+
+    TARGET(OP_LOAD)
+      if (!fetch_operand(bytecode, memory, addrs, instr->lhs, lines[pc], &acc.value))
+        goto done;
+      //
+      // a string from memory is shared, so storing it doesn't copy
+      // it; a constant is borrowed:
+      //
+      acc.owns_str = (acc.value.value_type == RAM_TYPE_STR && !OPERAND_IS_CONST(instr->lhs));
+      if (acc.owns_str)
+        str_share(acc.value.types.s);
+      pc++;
+      DISPATCH();
+
+    TARGET(OP_BINARY)
+      if (!fetch_operand(bytecode, memory, addrs, instr->lhs, lines[pc], &lhs))
+        goto done;
+      if (!fetch_operand(bytecode, memory, addrs, instr->rhs, lines[pc], &rhs))
+        goto done;
+
+#ifdef VM_THREADED_DISPATCH
+      goto *binary_targets[BINARY_KEY(instr->arg, lhs.value_type, rhs.value_type)];
+#else
+      switch (BINARY_KEY(instr->arg, lhs.value_type, rhs.value_type)) {
+#endif
+
+      SPECIALIZED_BINARIES(BINARY_HANDLER)
+
+#ifdef VM_THREADED_DISPATCH
+    binary_generic:
+#else
+      default:
+        break;
+      }
+#endif
+      //
+      // x = x + y with strings, a BINARY followed by a STORE to its
+      // lhs: append to x in memory, without copying it, and skip
+      // the STORE:
+      //
+      if (instr->arg == OPERATOR_PLUS && lhs.value_type == RAM_TYPE_STR && rhs.value_type == RAM_TYPE_STR &&
+          code[pc + 1].opcode == OP_STORE && code[pc + 1].arg == instr->lhs && !OPERAND_IS_CONST(instr->lhs)) {
+        ram_append_str_by_addr(memory, rhs.types.s, addrs[instr->lhs]);
+        executed++;
+        pc += 2;
+        DISPATCH();
+      }
+      if (!execute_binary_expression(&lhs, instr->arg, &rhs, &acc, lines[pc]))
+        goto done;
+      pc++;
+      DISPATCH();
+
+    SPECIALIZED_BINARIES(SPECIALIZED_HANDLER)
+
+    TARGET(OP_STORE)
+      if (addrs[instr->arg] != -1 && acc.value.value_type != RAM_TYPE_STR &&
+          memory->cells[addrs[instr->arg]].value.value_type != RAM_TYPE_STR) {
+        //
+        // nothing to copy or free, overwrite in place:
+        //
+        memory->cells[addrs[instr->arg]].value = acc.value;
+      }
+      else if (addrs[instr->arg] != -1) {
+        if (acc.owns_str)
+          ram_move_cell_by_addr(memory, acc.value, addrs[instr->arg]);  // memory has it now
+        else
+          ram_write_cell_by_addr(memory, acc.value, addrs[instr->arg]);
+        acc.owns_str = false;
+      }
+      else {
+        //
+        // first write, the variable gets its address now:
+        //
+        if (acc.owns_str)
+          ram_move_cell_by_name(memory, acc.value, bytecode->names[instr->arg]);
+        else
+          ram_write_cell_by_name(memory, acc.value, bytecode->names[instr->arg]);
+        acc.owns_str = false;
+        addrs[instr->arg] = ram_get_addr(memory, bytecode->names[instr->arg]);
+      }
+      executed++;
+      pc++;
+      DISPATCH();
+
+    TARGET(OP_PRINT)
+      if (!fetch_operand(bytecode, memory, addrs, instr->lhs, lines[pc], &lhs))
+        goto done;
+      if (!print_value(&lhs))
+        goto done;
+      executed++;
+      pc++;
+      DISPATCH();
+
+    TARGET(OP_PRINT_NEWLINE)
+      output_newline();
+      executed++;
+      pc++;
+      DISPATCH();
+
+    TARGET(OP_INPUT)
+      output_str(bytecode->constants[instr->arg].types.s);
+      output_flush();  // the prompt, before waiting for input
+
+      acc.value.value_type = RAM_TYPE_STR;
+      acc.value.types.s = read_input_line(&line, stdin);
+      acc.owns_str = false;
+      pc++;
+      DISPATCH();
+
+    TARGET(OP_INT)
+    TARGET(OP_FLOAT)
+      if (!fetch_operand(bytecode, memory, addrs, instr->lhs, lines[pc], &lhs))
+        goto done;
+
+      if (lhs.value_type != RAM_TYPE_STR ||
+          (instr->opcode == OP_INT && !execute_int_conversion(lhs.types.s, &acc.value)) ||
+          (instr->opcode == OP_FLOAT && !execute_real_conversion(lhs.types.s, &acc.value))) {
+        printf("**SEMANTIC ERROR: invalid string for %s() (line %d)\n", instr->opcode == OP_INT ? "int" : "float", lines[pc]);
+        goto done;
+      }
+      acc.owns_str = false;
+      pc++;
+      DISPATCH();
+
+    TARGET(OP_JUMP)
+      pc = instr->arg;
+      DISPATCH();
+
+    TARGET(OP_JUMP_IF_TRUE)
+      if (acc.value.types.i == 1)
+        pc = instr->arg;
+      else
+        pc++;
+      release_value(&acc);
+      executed++;
+      DISPATCH();
+
+    TARGET(OP_BAD_CALL)
+      printf("ERROR: invalid function call (line %d\n)", lines[pc]);
+      goto done;
+
+    TARGET(OP_STOP)
+    TARGET(OP_HALT)
+      goto done;
+
+#ifndef VM_THREADED_DISPATCH
+    default:
+      printf("**INTERNAL ERROR: unknown opcode (%d) in vm_execute\n", instr->opcode);
+      assert(false);
+      goto done;
+    }
+  }
+#endif
+
+done:
+  //
+  // if we stopped on an error, the accumulator may own a string:
+  //
+  release_value(&acc);
+  input_line_destroy(&line);
+
+  free(addrs);
+
+  return executed;
+}
@@ -0,0 +1,27 @@
+/*vm.h*/
+
+//
+// Virtual machine that executes nuPython bytecode, see bytecode.h.
+//
+
+#pragma once
+
+#include "bytecode.h"
+#include "ram.h"
+
+
+//
+// Public functions:
+//
+
+//
+// vm_execute
+//
+// Given nuPython bytecode and a memory, executes the bytecode.
+// Behaves exactly like execute() on the program graph the
+// bytecode was compiled from: if a semantic error occurs (e.g.
+// type error), an error message is output, execution stops,
+// and the function returns. Returns the number of statements
+// executed, counted as execute() counts them.
+//
+long vm_execute(struct BYTECODE* bytecode, struct RAM* memory);